@@ -89,7 +89,8 @@ extern void my_hpic_error_handler ( int errcode, const char *file,
 	// map property flags
 	int maptype,running_flag;
 	int pixel,pixelordering,polarisation;
-	int map_nside,Npixels,pixmin,pixmax,dpix,Nsideo; 
+	int map_nside,pixmin,pixmax,dpix,Nsideo; 
+	long long Npixels;
 	
 	// application flags
 	int colormap_flag,linlog_flag;
@@ -108,6 +109,12 @@ extern void my_hpic_error_handler ( int errcode, const char *file,
 
 - (void)setTIFF:(NSData *)someData;
 - (void)readFromFile;
+- (void)loadMaps:(NSValue *)jobvalue;
+- (void)loadStarted:(NSValue *)jobvalue;
+- (void)installMaps:(NSValue *)jobvalue;
+- (void)showLoadFailure:(NSValue *)jobvalue;
+- (void)showMaps:(BOOL)preview;
+- (void)freeMaps;
 - (void)GUI_error_handler:(int)errcode;
 
 // IB actions
@@ -134,7 +141,7 @@ extern void my_hpic_error_handler ( int errcode, const char *file,
 
 
 // accessor methods
-- (int)Npixels;
+- (long long)Npixels;
 - (int)maptype;
 - (int)pixelordering;
 - (int)polarisation;
@@ -149,7 +156,7 @@ extern void my_hpic_error_handler ( int errcode, const char *file,
 - (void)setStokesflag:(int)flag;
 
 // accessor methods
-- (void)setNpixels:(int)pixnum;
+- (void)setNpixels:(long long)pixnum;
 - (void)setwidgetmax:(NSString *)text;
 - (void)setwidgetmin:(NSString *)text;
 - (void)setProgressText:(NSString *)text;
@@ -24,7 +24,9 @@
 *                                                                            *
 *****************************************************************************/
 
+#import <pthread.h>
 #import "AppController.h"
+#import "CMBfitsmap.h"
 
 
 /**********************************************************************/
@@ -46,6 +48,126 @@ void my_hpic_error_handler (int errcode, const char *file,
 }
 
 
+/**********************************************************************/
+/*                      background map loading                        */
+/**********************************************************************/
+
+//maps are read on a background thread, so the interface stays live. Large
+//maps are first shown degraded to PREVIEW_NSIDE, then replaced by the full
+//resolution maps. Opening another file cancels the load.
+#define PREVIEW_NSIDE 128
+
+typedef struct
+{
+	unsigned long serial;
+	char *filename;
+	size_t nside, nmaps;
+	int order, coord, type;
+	hpic_fltarr *maps, *preview;
+	//the pixels of a cut sky map, whose maps are then only headers
+	sparsemap *cut;
+	//the degraded levels of maps, built on the load thread
+	mappyramid pyramid[3];
+	//why the load failed: a status line, and the hpic error if there was one
+	int failed;
+	const char *failure;
+	char hpicerror[HPIC_STRNL];
+} mapload;
+
+//serial number of the current load. A load with any other serial has been
+//cancelled, and its maps are thrown away rather than installed
+static volatile unsigned long loadserial = 0;
+
+//neither cfitsio nor hpic is thread safe, and hpic reports errors through
+//the globals HPIC_ERROR_FLAG and hpic_errorstr. Every call a load makes to
+//read, allocate or convert maps is made holding this lock, so one load
+//waits for a cancelled one to finish its read, and the error flag is
+//cleared and copied into the job under it (see mapload_lock/unlock)
+static pthread_mutex_t hpiclock = PTHREAD_MUTEX_INITIALIZER;
+
+static void mapload_lock(void)
+{
+	pthread_mutex_lock(&hpiclock);
+	HPIC_ERROR_FLAG = FALSE;
+}
+
+//records any hpic error raised since mapload_lock in the job
+static void mapload_unlock(mapload *job)
+{
+	if (HPIC_ERROR_FLAG && !job->failed)
+	{
+		job->failed = 1;
+		strncpy(job->hpicerror,hpic_errorstr,HPIC_STRNL-1);
+	}
+	pthread_mutex_unlock(&hpiclock);
+}
+
+static int mapload_cancelled(const mapload *job)
+{
+	return job->serial != loadserial;
+}
+
+//free a map array together with the maps in it
+static void free_maparray(hpic_fltarr *maps)
+{
+	size_t i;
+
+	if (!maps) return;
+	for (i=0; i<hpic_fltarr_n_get(maps); i++)
+	{
+		if (hpic_fltarr_get(maps,i)) hpic_float_free(hpic_fltarr_get(maps,i));
+	}
+	hpic_fltarr_free(maps);
+}
+
+static void mapload_free(mapload *job)
+{
+	int i;
+
+	mapload_lock();
+	free_maparray(job->maps);
+	free_maparray(job->preview);
+	for (i=0; i<3; i++) pyramid_free(&job->pyramid[i]);
+	if (job->cut)
+	{
+		sparse_free(job->cut);
+		free(job->cut);
+	}
+	mapload_unlock(job);
+	free(job->filename);
+	free(job);
+}
+
+//check whether the file of a job is a HEALPix FITS file, and find its params;
+//returns 0 with the job failed if it is not one CMBview can show
+static int mapload_test(mapload *job)
+{
+	int FITSflag;
+
+	mapload_lock();
+	FITSflag = hpic_fits_map_test(job->filename,&job->nside,&job->order,
+								  &job->coord,&job->type,&job->nmaps);
+	mapload_unlock(job);
+
+	if (!FITSflag || job->failed)
+	{
+		job->failed = 1;
+		job->failure = "Does not seem to be a valid HEALPix FITS file";
+	}
+	else if (job->nmaps>4)
+	{
+		job->failed = 1;
+		job->failure = "FITS file contains more than 4 maps, not currently supported";
+	}
+	else if (job->nmaps<1)
+	{
+		job->failed = 1;
+		job->failure = "found strange value for number of maps";
+	}
+	return !job->failed;
+}
+
+
 @implementation AppController
 
 - (void)GUI_error_handler:(int)errcode
@@ -136,6 +258,7 @@ void my_hpic_error_handler (int errcode, const char *file,
 	hpic_Umap = NULL;
 	hpic_Nmap = NULL;
 	hpic_maps = NULL;
+	cutmap = NULL;
 	
 	HPIC_ERROR_FLAG = FALSE;
 	hpic_set_error_handler(&my_hpic_error_handler);
@@ -167,6 +290,11 @@ void my_hpic_error_handler (int errcode, const char *file,
 	[defaultValues setObject:[NSNumber numberWithInt:exportimagesize_init]
 					  forKey:CMBview_exportimagesizekey];	
 	
+	//adaptive antialiasing levels for render mode and export, 0 (off) to 3
+	int antialias_init = 0;
+	[defaultValues setObject:[NSNumber numberWithInt:antialias_init]
+					  forKey:CMBview_antialiaskey];
+	
 	float mousesensitivity_init = 0.2;
 	[defaultValues setObject:[NSNumber numberWithFloat:mousesensitivity_init]
 					  forKey:CMBview_mousesensitivitykey];
@@ -186,6 +314,27 @@ void my_hpic_error_handler (int errcode, const char *file,
 	[defaultValues setObject:[NSNumber numberWithInt:texelinterpolation_init]
 					  forKey:CMBview_texinterpolatekey];
 	
+	//keep texel->pixel lookup tables in ~/Library/Caches
+	BOOL pixtablecacheFlag = NO;
+	[defaultValues setObject:[NSNumber numberWithBool:pixtablecacheFlag]
+					  forKey:CMBview_pixtablecachekey];
+	
+	//memory for colored face textures kept between maps, in MB
+	int texcache_init = 256;
+	[defaultValues setObject:[NSNumber numberWithInt:texcache_init]
+					  forKey:CMBview_texcachekey];
+	
+	//memory for ray-traced views kept for reuse, in MB
+	int rendercache_init = 128;
+	[defaultValues setObject:[NSNumber numberWithInt:rendercache_init]
+					  forKey:CMBview_rendercachekey];
+	
+	//memory for virtual cube map tiles finer than the face textures, in MB;
+	//0 turns them off
+	int vtex_init = 256;
+	[defaultValues setObject:[NSNumber numberWithInt:vtex_init]
+					  forKey:CMBview_vtexkey];
+	
 	//colormaps 
 	current_colormap_ptr = &mycolormaps[hsv];
 	
@@ -281,6 +430,11 @@ void my_hpic_error_handler (int errcode, const char *file,
 	int stokesgrid_init = 100;
 	[defaultValues setObject:[NSNumber numberWithInt:stokesgrid_init]
 					  forKey:CMBview_stokesgridkey];
+	
+	//equal-area (HEALPix binned) Stokes vectors instead of a viewport grid
+	BOOL stokesequalarea_init = NO;
+	[defaultValues setObject:[NSNumber numberWithBool:stokesequalarea_init]
+					  forKey:CMBview_stokesequalareakey];
 
 	float stokesopacity_init = 1.0;
 	R = 1.0; G = 1.0; B = 1.0; A = 1.0;
@@ -395,9 +549,8 @@ void my_hpic_error_handler (int errcode, const char *file,
 		{
 			render_mode = 3;			
 			
-			//TO DO: if the last mode was render mode, then we needn't
-			// regenerate texture since viewpoint hasn't changed.
-			// (and similarly if we change from presentation mode to render mode).
+			//(if the viewpoint hasn't changed since render mode, the traced
+			// data comes from the render cache and is only recolored)
 			
 			[myCMBdata genTextures_render];
 			[myOpenGLview display];
@@ -928,6 +1081,9 @@ void my_hpic_error_handler (int errcode, const char *file,
 		{
 			
 			[myCMBdata genTextures_render_forexport];
+			
+			//(no TIFF if the export could not be made)
+			if (!myTIFF) return;
 	
 			NSSavePanel *sp = [NSSavePanel savePanel];
 			[sp setRequiredFileType:@"tiff"];	
@@ -1007,381 +1163,495 @@ void my_hpic_error_handler (int errcode, const char *file,
 		}
 }
 
+/*
+   start checking and reading the file on a background thread. Anything already
+   displayed stays up (and usable) until the new maps arrive in installMaps:
+*/
 - (void)readFromFile
 {
-	int FITSflag,pol,order,coord,type;
-	char *inFITSfilename, creator[200], extname[200];
-	NSString *pixelcount;
-	hpic_keys *keys;
-	size_t mapnum, npix, pixnum, nside, nmaps;
-	
+	mapload *job;
+
 	[openfiletimer invalidate];
 	[openfiletimer release];
-		
-	inFITSfilename = (char*)[myFITSfile UTF8String];
+
+	//opening a file cancels any load still in progress
+	loadserial++;
 
 	[self stopProgressBar:NO];
 	[self setProgressText:@"querying file..."];
 	[progressView setDoubleValue:0.0];
-	HPIC_ERROR_FLAG = FALSE;
-				
-	//call hpic function to check whether file is valid FITS, and extract params
-	FITSflag = hpic_fits_map_test(inFITSfilename,&nside,&order,&coord,&type,&nmaps);
-	
-	if (FITSflag && !HPIC_ERROR_FLAG) 
+
+	job = (mapload *)calloc(1,sizeof(mapload));
+	if (job) job->filename = strdup([myFITSfile UTF8String]);
+	if (!job || !job->filename)
 	{
-			
-		[self setProgressText:@"this is a valid HEALPix FITS file, reading data..."];
-		[self setMap_nside:nside];
-		[self setPixelordering:order];
-		
-		if ([self maptype]!=0) 
-		{
-			//free T map
-			if (hpic_Tmap != NULL) 
-			{
-				hpic_float_free(hpic_Tmap);
-				hpic_Tmap = NULL;
-			}
-			
-			//free Q map
-			if (hpic_Qmap != NULL)
-			{
-				hpic_float_free(hpic_Qmap);
-				hpic_Qmap = NULL;
-			}
-			
-			//free U map
-			if (hpic_Umap != NULL)
-			{
-				hpic_float_free(hpic_Umap);
-				hpic_Umap = NULL;
-			}
-			
-			//free N map
-			if (hpic_Nmap != NULL) 
-			{
-				hpic_float_free(hpic_Nmap);
-				hpic_Nmap = NULL;
-			}
-			
-			//free map container structure
-			if (hpic_maps != NULL)
-			{
-				hpic_fltarr_free(hpic_maps);
-				hpic_maps = NULL;
-			}
-		}
-				 
-		keys = hpic_keys_alloc();
-					
-		if (nmaps==3) 
-		{						
-			hpic_Tmap = hpic_float_alloc(nside,order,coord,HPIC_STND);
-			hpic_Qmap = hpic_float_alloc(nside,order,coord,HPIC_STND);
-			hpic_Umap = hpic_float_alloc(nside,order,coord,HPIC_STND);
-			hpic_maps = hpic_fltarr_alloc(3);
-			
-			hpic_fltarr_set(hpic_maps,0,hpic_Tmap);
-			hpic_fltarr_set(hpic_maps,1,hpic_Qmap);
-			hpic_fltarr_set(hpic_maps,2,hpic_Umap);	
-			
-			if (type == HPIC_FITS_FULL) 
-			{
-				hpic_fits_full_read(inFITSfilename,creator,extname,hpic_maps,keys);								
-			}
-			else 
-			{
-				[self setProgressText:@"this is a cut sky map... OK"];
-				cuterrs = hpic_float_alloc(nside,order,coord,HPIC_AUTO);
-				cutpix = hpic_int_alloc(nside,order,coord,HPIC_AUTO);
-				cuthits = hpic_int_alloc(nside,order,coord,HPIC_AUTO);				
-				hpic_fits_cut_read(inFITSfilename,creator,extname,cutpix,cuthits,cuterrs,hpic_maps,keys);
-			}	
-			
-			//TO DO: implement a drawer which displays FITS keys
-			npix = hpic_float_npix_get(hpic_Tmap);																
-			[self setNpixels:(int)npix];
-			pol=1;
-		}
-		
-		else if (nmaps==2) 
-		{
-			//TO DO: note that currently, even though there are only 2 maps
-			//in the FITS file, I set up a garbage U map (thus wasting memory) 
-			//to simplify the code in CMBdata. I should change this eventually.
-			hpic_Tmap = hpic_float_alloc(nside,order,coord,HPIC_STND);
-			hpic_Qmap = hpic_float_alloc(nside,order,coord,HPIC_STND);
-			hpic_Umap = hpic_float_alloc(nside,order,coord,HPIC_STND);
-			hpic_maps = hpic_fltarr_alloc(3);
-			
-			hpic_fltarr_set(hpic_maps,0,hpic_Tmap);
-			hpic_fltarr_set(hpic_maps,1,hpic_Qmap);
-			hpic_fltarr_set(hpic_maps,2,hpic_Umap);			
-			
-			if (type == HPIC_FITS_FULL) 
-			{
-				hpic_fits_full_read(inFITSfilename,creator,extname,hpic_maps,keys);								
-			}
-			else 
-			{
-				[self setProgressText:@"this is a cut sky map... OK"];
-				cuterrs = hpic_float_alloc(nside,order,coord,HPIC_AUTO);
-				cutpix = hpic_int_alloc(nside,order,coord,HPIC_AUTO);
-				cuthits = hpic_int_alloc(nside,order,coord,HPIC_AUTO);				
-				hpic_fits_cut_read(inFITSfilename,creator,extname,cutpix,cuthits,cuterrs,hpic_maps,keys);
-			}			
-			
-			npix = hpic_float_npix_get(hpic_Tmap);					
-			[self setNpixels:(int)npix];
-			pol=2;
+		free(job);
+		[self setProgressText:@""];
+		NSRunAlertPanel(@"Out of memory",@"There is not enough memory to open %@.",@"OK",nil,nil,myFITSfile);
+		return;
+	}
+	job->serial = loadserial;
 
-		}
-		
-		else if (nmaps==1) 
-		{
-			hpic_Tmap = hpic_float_alloc(nside,order,coord,HPIC_STND);
-			hpic_Qmap = NULL;
-			hpic_Umap = NULL;
-			hpic_maps = hpic_fltarr_alloc(1);
-			hpic_fltarr_set(hpic_maps,0,hpic_Tmap);			
-			if (type == HPIC_FITS_FULL)
-			{
-				hpic_fits_full_read(inFITSfilename,creator,extname,hpic_maps,keys);								
-			}
-			else 
-			{
-				//currently the facility for reading and displaying cut sky maps is
-				//not well tested, but at least the code will (well, should) not crash...
-				
-				[self setProgressText:@"this is a cut sky map... OK"];
-				cuterrs = hpic_float_alloc(nside,order,coord,HPIC_AUTO);
-				cutpix = hpic_int_alloc(nside,order,coord,HPIC_AUTO);
-				cuthits = hpic_int_alloc(nside,order,coord,HPIC_AUTO);				
-				hpic_fits_cut_read(inFITSfilename,creator,extname,cutpix,cuthits,cuterrs,hpic_maps,keys);
-			}						
-			npix = hpic_float_npix_get(hpic_Tmap);					
-			[self setNpixels:(int)npix];
-			pol=0;
-		}		
-		
-		else if (nmaps==4)
-		{
-			//added to handle the 4-map (T,Q,U,N) files provided in the WMAP 4-year data release. 
-			//Unfortunately cannot view N map without major changes to GUI, so for now I just 
-			//set things up so the 4 maps are read, and the N map immediately freed.
-			
-			hpic_Tmap = hpic_float_alloc(nside,order,coord,HPIC_STND);
-			hpic_Qmap = hpic_float_alloc(nside,order,coord,HPIC_STND);
-			hpic_Umap = hpic_float_alloc(nside,order,coord,HPIC_STND);
-			hpic_Nmap = hpic_float_alloc(nside,order,coord,HPIC_STND);
-			
-			hpic_maps = hpic_fltarr_alloc(4);
-			
-			hpic_fltarr_set(hpic_maps,0,hpic_Tmap);
-			hpic_fltarr_set(hpic_maps,1,hpic_Qmap);
-			hpic_fltarr_set(hpic_maps,2,hpic_Umap);	
-			hpic_fltarr_set(hpic_maps,3,hpic_Nmap);	
+	[NSThread detachNewThreadSelector:@selector(loadMaps:)
+							 toTarget:self
+						   withObject:[NSValue valueWithPointer:job]];
+}
 
-			if (type == HPIC_FITS_FULL)
-			{
-				hpic_fits_full_read(inFITSfilename,creator,extname,hpic_maps,keys);								
-			}
-			else 
-			{
-				[self setProgressText:@"this is a cut sky map... OK"];
-				cuterrs = hpic_float_alloc(nside,order,coord,HPIC_AUTO);
-				cutpix = hpic_int_alloc(nside,order,coord,HPIC_AUTO);
-				cuthits = hpic_int_alloc(nside,order,coord,HPIC_AUTO);				
-				hpic_fits_cut_read(inFITSfilename,creator,extname,cutpix,cuthits,cuterrs,hpic_maps,keys);
-			}			
-			npix = hpic_float_npix_get(hpic_Tmap);																
-			[self setNpixels:(int)npix];
-			pol=1;
-			
-			hpic_float_free(hpic_Nmap);
-			hpic_Nmap = NULL;
-			
-		}
-		
-		else if (nmaps>4)
-		{
-			[self setProgressText:@"FITS file contains more than 4 maps, not currently supported"];
-			FITSflag=0;
-		}
-		else 
-		{
-			[self setProgressText:@"found strange value for number of maps"];
-			FITSflag=0;
-		}
-		
-		[self setPolarisation:pol];
+/*
+   body of the load thread. The maps are read into the job, never into the
+   hpic_ globals, which belong to the main thread. Results go back through
+   installMaps: on the main thread: first a degraded preview for large maps,
+   then the maps themselves (or why there are none).
+*/
+- (void)loadMaps:(NSValue *)jobvalue
+{
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	mapload *job = (mapload *)[jobvalue pointerValue];
+	char creator[200], extname[200];
+	hpic_keys *keys;
+	hpic_float *map;
+	size_t i, nread;
 
-		hpic_keys_free(keys);
+	if (!mapload_test(job) || mapload_cancelled(job))
+	{
+		[self performSelectorOnMainThread:@selector(installMaps:)
+							   withObject:jobvalue
+							waitUntilDone:YES];
+		mapload_free(job);
+		[pool release];
+		return;
 	}
-	
-	else 
+	[self performSelectorOnMainThread:@selector(loadStarted:)
+						   withObject:jobvalue
+						waitUntilDone:YES];
+
+	//the 2-map (T,N) case gets a garbage U map too, to simplify the code in
+	//CMBdata (this wastes memory, and should change eventually). The N map of
+	//the 4-map (T,Q,U,N) files is read and immediately freed, as it cannot be
+	//viewed without major changes to the GUI.
+	nread = job->nmaps==2 ? 3 : job->nmaps;
+	mapload_lock();
+	//(a newer file may have been opened while an older load held the lock)
+	if (mapload_cancelled(job))
 	{
-		[self setProgressText:@"Does not seem to be a valid HEALPix FITS file"];
+		mapload_unlock(job);
+		mapload_free(job);
+		[pool release];
+		return;
 	}
-	
-	if (FITSflag && !HPIC_ERROR_FLAG) 
-	{	
-		//OK, file is kosher and data has been read, now we can display stuff		
-		[FITSfilename setStringValue:[myFITSfile lastPathComponent]];
-		[FITSfilename display];
-		
-		if (pol==0) 
-		{
-			pixelcount = [[NSString alloc] initWithFormat:
-				@"%d pixels (T only)",[self Npixels]];
-		}
-		
-		else if (pol==1)
-		{
-			pixelcount = [[NSString alloc] initWithFormat:
-				@"%d pixels (T,Q,U)",[self Npixels]];
-		}
-		
-		else if (pol==2)
-		{
-			pixelcount = [[NSString alloc] initWithFormat:
-				@"%d pixels (T,N only)",[self Npixels]];
-		}
-		
-		[self setPixelnumText:pixelcount];
-		
-		//show T map first				
-		[self setMaptype:1];
-		[self stopProgressBar:NO];
-		
-		//make sure to reset all color range information on loading the new map
-		[myLittleOpenGLview reinitializeHistograms];
-		
-		//enable text editing of the histogram range values
-		[widget_max setEditable:YES];
-		[widget_min setEditable:YES];
-		
-		//switch to interactive mode
-		render_mode = 1;
-		[myCMBdata genTextures_interactive];
-		
-		[self setProgressText:@""];
-		[self setProgressIndicator:0.0];
-		[self enable_zoom_slider];
-		
-		id theCell_interactive = [render_mode_matrix cellWithTag:1];
-		id theCell_render = [render_mode_matrix cellWithTag:2];
-		id theCell_presentation = [render_mode_matrix cellWithTag:3];				
-		[theCell_render setEnabled:YES];
-		[theCell_interactive setEnabled:NO];
-		[theCell_presentation setEnabled:YES];
-		[render_mode_matrix selectCellWithTag:1];
-		
-		//do not show Stokes vectors initially
-		[self setStokesflag:0];
-		
-		//enable the GUI buttons according to the available data
-		[Tmapbutton setEnabled:(BOOL)YES];
-		[Tmapbutton setState:NSOnState];	
-		
-		[Qmapbutton setState:NSOffState];
-		[Umapbutton setState:NSOffState];
-		[Pmapbutton setState:NSOffState];
-		
-		[showStokesbutton setEnabled:(BOOL)NO];
-		[showStokesbutton setState:NSOffState];
-		
-		[color_matrix setEnabled:(BOOL)YES];
-		[linlog_matrix setEnabled:(BOOL)YES];
-		[updatebutton setEnabled:(BOOL)YES];
-		
-		if (pol==0) //T only
-		{
-			[Qmapbutton setEnabled:(BOOL)NO];
-			[Umapbutton setEnabled:(BOOL)NO];
-			[Pmapbutton setEnabled:(BOOL)NO];
-			[genStokesbutton setEnabled:(BOOL)NO];
-			[Stokesslider setEnabled:(BOOL)NO];
-			[self setStokesflag:0];			
-		} 				
-		else if (pol==1) //T, Q, U
+	job->maps = hpic_fltarr_alloc(nread);
+	for (i=0; i<nread; i++)
+	{
+		//(an empty tree map has no pixels, it just carries the nside etc.)
+		map = hpic_float_alloc(job->nside,job->order,job->coord,
+							   job->type == HPIC_FITS_FULL ? HPIC_STND : HPIC_TREE);
+		hpic_fltarr_set(job->maps,i,map);
+	}
+
+	keys = hpic_keys_alloc();
+	if (job->type == HPIC_FITS_FULL)
+	{
+		//mapped straight from the file where possible, cfitsio otherwise
+		if (!fitsmap_read(job->filename,job->maps))
 		{
-			[Qmapbutton setTitle:@"Q"];
-			[Qmapbutton setEnabled:(BOOL)YES];
-			[Umapbutton setEnabled:(BOOL)YES];
-			[Pmapbutton setEnabled:(BOOL)YES];
-			[genStokesbutton setEnabled:(BOOL)YES];
-			[Stokesslider setEnabled:(BOOL)YES];					
+			hpic_fits_full_read(job->filename,creator,extname,job->maps,keys);
 		}
-		else if (pol==2) //T, N
+	}
+	else
+	{
+		//a cut sky map stays a list of its observed pixels, and is looked up
+		//through the pyramid, never scattered into full sky maps. Like the
+		//read's own errors, running out of memory here fails the job
+		job->cut = (sparsemap *)malloc(sizeof(sparsemap));
+		if (!job->cut) hpic_error(HPIC_ERR_ALLOC,__FILE__,__LINE__,"cannot allocate cut sky map");
+		else sparse_read(job->cut,job->filename,job->nside,job->order,nread<3 ? (int)nread : 3);
+	}
+	//TO DO: implement a drawer which displays FITS keys
+	hpic_keys_free(keys);
+
+	if (job->nmaps==4)
+	{
+		hpic_float_free(hpic_fltarr_get(job->maps,3));
+		hpic_fltarr_set(job->maps,3,NULL);
+	}
+	mapload_unlock(job);
+
+	//put a degraded copy up first, so something appears while the full
+	//resolution cube-maps are generated (a cut sky pyramid is quick to make,
+	//so those maps go straight up)
+	if (!job->failed && !mapload_cancelled(job) && job->nside>=4*PREVIEW_NSIDE &&
+		job->type == HPIC_FITS_FULL)
+	{
+		mapload_lock();
+		job->preview = hpic_fltarr_alloc(hpic_fltarr_n_get(job->maps));
+		for (i=0; i<hpic_fltarr_n_get(job->maps); i++)
 		{
-			[Qmapbutton setTitle:@"N"];
-			[Qmapbutton setEnabled:(BOOL)YES];
-			[Umapbutton setEnabled:(BOOL)NO];
-			[Pmapbutton setEnabled:(BOOL)NO];
-			[genStokesbutton setEnabled:(BOOL)NO];
-			[Stokesslider setEnabled:(BOOL)NO];
+			map = hpic_fltarr_get(job->maps,i);
+			if (map) hpic_fltarr_set(job->preview,i,hpic_conv_float_xgrade(map,PREVIEW_NSIDE));
 		}
-		
-		//reset pixel info box.
-		
-		//angles
-		NSString *Theta_pixelinfo_text;
-		NSString *Phi_pixelinfo_text;
-		Theta_pixelinfo_text = [[NSString alloc] initWithFormat:@"Th:"];
-		Phi_pixelinfo_text = [[NSString alloc] initWithFormat:@"Ph:"];
-		[self setPixinfoText_theta:Theta_pixelinfo_text];
-		[self setPixinfoText_phi:Phi_pixelinfo_text];				
-		
-		//N
-		NSString *N_pixelinfo_text;
-		N_pixelinfo_text = [[NSString alloc] initWithFormat:@"n:"];
-		[self setPixinfoText_N:N_pixelinfo_text];
-		[N_pixelinfo_text release];
-		
-		//T
-		NSString *T_pixelinfo_text;
-		T_pixelinfo_text = [[NSString alloc] initWithFormat:@"T:"];
-		[self setPixinfoText_T:T_pixelinfo_text];
-		[T_pixelinfo_text release];
-		
-		//Q
-		NSString *Q_pixelinfo_text;
-		if (pol==1 || pol==0) 
+		mapload_unlock(job);
+		if (!job->failed && !mapload_cancelled(job))
 		{
-			Q_pixelinfo_text = [[NSString alloc] initWithFormat:@"Q:"];
+			[self performSelectorOnMainThread:@selector(installMaps:)
+								   withObject:jobvalue
+								waitUntilDone:YES];
 		}
-		else if (pol==2) 
+	}
+
+	//degrade the full resolution maps here too, rather than holding up the
+	//main thread (this is slow for RING maps)
+	if (!job->failed && !mapload_cancelled(job))
+	{
+		for (i=0; i<3 && i<hpic_fltarr_n_get(job->maps); i++)
 		{
-			Q_pixelinfo_text = [[NSString alloc] initWithFormat:@"N:"];
+			map = hpic_fltarr_get(job->maps,i);
+			if (job->cut) pyramid_build_sparse(&job->pyramid[i],map,job->cut,(int)i,NULL,NULL);
+			else pyramid_build(&job->pyramid[i],map,NULL,NULL);
 		}
-		[self setPixinfoText_Q:Q_pixelinfo_text];
-		[Q_pixelinfo_text release];
-		
-		//U
-		NSString *U_pixelinfo_text;
-		U_pixelinfo_text = [[NSString alloc] initWithFormat:@"U:"];
-		[self setPixinfoText_U:U_pixelinfo_text];
-		[U_pixelinfo_text release];
-		
-		//P
-		NSString *P_pixelinfo_text;
-		P_pixelinfo_text = [[NSString alloc] initWithFormat:@"P:"];
-		[self setPixinfoText_P:P_pixelinfo_text];
-		[P_pixelinfo_text release];
+	}
 
+	if (!mapload_cancelled(job))
+	{
+		[self performSelectorOnMainThread:@selector(installMaps:)
+							   withObject:jobvalue
+							waitUntilDone:YES];
 	}
+
+	//whatever was not installed (everything, if the load was cancelled) goes here
+	mapload_free(job);
+	[pool release];
+}
+
+//free the maps currently on display
+- (void)freeMaps
+{
+	//free the degraded levels
+	pyramid_free(&Tpyramid);
+	pyramid_free(&Qpyramid);
+	pyramid_free(&Upyramid);
 	
-	[myOpenGLview setNeedsDisplay:YES];
+	//free the pixels of a cut sky map
+	if (cutmap != NULL)
+	{
+		sparse_free(cutmap);
+		free(cutmap);
+		cutmap = NULL;
+	}
 	
-	if (HPIC_ERROR_FLAG) 
+	//free T map
+	if (hpic_Tmap != NULL)
+	{
+		hpic_float_free(hpic_Tmap);
+		hpic_Tmap = NULL;
+	}
+
+	//free Q map
+	if (hpic_Qmap != NULL)
+	{
+		hpic_float_free(hpic_Qmap);
+		hpic_Qmap = NULL;
+	}
+
+	//free U map
+	if (hpic_Umap != NULL)
+	{
+		hpic_float_free(hpic_Umap);
+		hpic_Umap = NULL;
+	}
+
+	//free N map
+	if (hpic_Nmap != NULL)
+	{
+		hpic_float_free(hpic_Nmap);
+		hpic_Nmap = NULL;
+	}
+
+	//free map container structure
+	if (hpic_maps != NULL)
 	{
-		NSString *guierrorstr=[[NSString alloc] initWithFormat:@"hpic error: %s",hpic_errorstr];		
-		[self setProgressText:guierrorstr];
-		[guierrorstr release];
+		hpic_fltarr_free(hpic_maps);
+		hpic_maps = NULL;
+	}
+}
+
+/*
+   called on the main thread by the load thread, which waits meanwhile. Takes
+   the preview maps if the job has them, otherwise the full resolution maps,
+   and makes them the ones on display.
+*/
+- (void)installMaps:(NSValue *)jobvalue
+{
+	mapload *job = (mapload *)[jobvalue pointerValue];
+	hpic_fltarr *maps;
+	size_t nside;
+	BOOL preview;
+	int pol;
+
+	//a newer file has been opened since this job was started
+	if (mapload_cancelled(job)) return;
+
+	if (job->failed)
+	{
+		[self showLoadFailure:jobvalue];
+		return;
+	}
+
+	preview = (job->preview != NULL);
+	if (preview)
+	{
+		maps = job->preview;
+		job->preview = NULL;
+		nside = PREVIEW_NSIDE;
+	}
+	else
+	{
+		maps = job->maps;
+		job->maps = NULL;
+		nside = job->nside;
+	}
+
+	if ([self maptype]!=0)
+	{
+		[self freeMaps];
+	}
+	hpic_maps = maps;
+	hpic_Tmap = hpic_fltarr_get(maps,0);
+	hpic_Qmap = job->nmaps>1 ? hpic_fltarr_get(maps,1) : NULL;
+	hpic_Umap = job->nmaps>1 ? hpic_fltarr_get(maps,2) : NULL;
+	
+	//the degraded levels for the scans and traces of coarse views; the small
+	//preview maps are degraded here, the full ones on the load thread
+	if (preview)
+	{
+		pyramid_build(&Tpyramid,hpic_Tmap,NULL,NULL);
+		pyramid_build(&Qpyramid,hpic_Qmap,NULL,NULL);
+		pyramid_build(&Upyramid,hpic_Umap,NULL,NULL);
+	}
+	else
+	{
+		Tpyramid = job->pyramid[0];
+		Qpyramid = job->pyramid[1];
+		Upyramid = job->pyramid[2];
+		memset(job->pyramid,0,sizeof(job->pyramid));
 	}
 	
+	//the pyramids point into the cut sky pixels, which move over with them
+	if (!preview)
+	{
+		cutmap = job->cut;
+		job->cut = NULL;
+	}
+
+	if (job->nmaps==1) pol=0;
+	else if (job->nmaps==2) pol=2;
+	else pol=1;
+
+	[self setMap_nside:nside];
+	[self setPixelordering:job->order];
+	[self setNpixels:(long long)hpic_float_npix_get(hpic_Tmap)];
+	[self setPolarisation:pol];
+	[self showMaps:preview];
+}
+
+/*
+   set up the display for newly installed maps. A preview only gets the
+   interactive T view, the rest of the GUI is enabled with the real maps.
+*/
+- (void)showMaps:(BOOL)preview
+{
+	NSString *pixelcount;
+	int pol = [self polarisation];
+
+	//OK, file is kosher and data has been read, now we can display stuff
+	[FITSfilename setStringValue:[myFITSfile lastPathComponent]];
+	[FITSfilename display];
+
+	if (pol==0)
+	{
+		pixelcount = [[NSString alloc] initWithFormat:
+			@"%lld pixels (T only)",[self Npixels]];
+	}
+
+	else if (pol==1)
+	{
+		pixelcount = [[NSString alloc] initWithFormat:
+			@"%lld pixels (T,Q,U)",[self Npixels]];
+	}
+
+	else
+	{
+		pixelcount = [[NSString alloc] initWithFormat:
+			@"%lld pixels (T,N only)",[self Npixels]];
+	}
+
+	[self setPixelnumText:pixelcount];
+	[pixelcount release];
+
+	//show T map first
+	[self setMaptype:1];
+	[self stopProgressBar:NO];
+
+	//make sure to reset all color range information on loading the new map
+	[myLittleOpenGLview reinitializeHistograms];
+
+	//enable text editing of the histogram range values
+	[widget_max setEditable:YES];
+	[widget_min setEditable:YES];
+
+	//switch to interactive mode
+	render_mode = 1;
+	[myCMBdata genTextures_interactive];
+
+	[self enable_zoom_slider];
+
+	id theCell_interactive = [render_mode_matrix cellWithTag:1];
+	id theCell_render = [render_mode_matrix cellWithTag:2];
+	id theCell_presentation = [render_mode_matrix cellWithTag:3];
+	[theCell_render setEnabled:!preview];
+	[theCell_interactive setEnabled:NO];
+	[theCell_presentation setEnabled:!preview];
+	[render_mode_matrix selectCellWithTag:1];
+
+	//do not show Stokes vectors initially
+	[self setStokesflag:0];
+
+	//enable the GUI buttons according to the available data
+	[Tmapbutton setEnabled:!preview];
+	[Tmapbutton setState:NSOnState];
+
+	[Qmapbutton setState:NSOffState];
+	[Umapbutton setState:NSOffState];
+	[Pmapbutton setState:NSOffState];
+
+	[showStokesbutton setEnabled:(BOOL)NO];
+	[showStokesbutton setState:NSOffState];
+
+	[color_matrix setEnabled:(BOOL)YES];
+	[linlog_matrix setEnabled:(BOOL)YES];
+	[updatebutton setEnabled:(BOOL)YES];
+
+	if (pol==0 || preview) //T only
+	{
+		[Qmapbutton setEnabled:(BOOL)NO];
+		[Umapbutton setEnabled:(BOOL)NO];
+		[Pmapbutton setEnabled:(BOOL)NO];
+		[genStokesbutton setEnabled:(BOOL)NO];
+		[Stokesslider setEnabled:(BOOL)NO];
+		[self setStokesflag:0];
+	}
+	else if (pol==1) //T, Q, U
+	{
+		[Qmapbutton setTitle:@"Q"];
+		[Qmapbutton setEnabled:(BOOL)YES];
+		[Umapbutton setEnabled:(BOOL)YES];
+		[Pmapbutton setEnabled:(BOOL)YES];
+		[genStokesbutton setEnabled:(BOOL)YES];
+		[Stokesslider setEnabled:(BOOL)YES];
+	}
+	else if (pol==2) //T, N
+	{
+		[Qmapbutton setTitle:@"N"];
+		[Qmapbutton setEnabled:(BOOL)YES];
+		[Umapbutton setEnabled:(BOOL)NO];
+		[Pmapbutton setEnabled:(BOOL)NO];
+		[genStokesbutton setEnabled:(BOOL)NO];
+		[Stokesslider setEnabled:(BOOL)NO];
+	}
+
+	//reset pixel info box.
+
+	//angles
+	NSString *Theta_pixelinfo_text;
+	NSString *Phi_pixelinfo_text;
+	Theta_pixelinfo_text = [[NSString alloc] initWithFormat:@"Th:"];
+	Phi_pixelinfo_text = [[NSString alloc] initWithFormat:@"Ph:"];
+	[self setPixinfoText_theta:Theta_pixelinfo_text];
+	[self setPixinfoText_phi:Phi_pixelinfo_text];
+
+	//N
+	NSString *N_pixelinfo_text;
+	N_pixelinfo_text = [[NSString alloc] initWithFormat:@"n:"];
+	[self setPixinfoText_N:N_pixelinfo_text];
+	[N_pixelinfo_text release];
+
+	//T
+	NSString *T_pixelinfo_text;
+	T_pixelinfo_text = [[NSString alloc] initWithFormat:@"T:"];
+	[self setPixinfoText_T:T_pixelinfo_text];
+	[T_pixelinfo_text release];
+
+	//Q
+	NSString *Q_pixelinfo_text;
+	if (pol==1 || pol==0)
+	{
+		Q_pixelinfo_text = [[NSString alloc] initWithFormat:@"Q:"];
+	}
+	else
+	{
+		Q_pixelinfo_text = [[NSString alloc] initWithFormat:@"N:"];
+	}
+	[self setPixinfoText_Q:Q_pixelinfo_text];
+	[Q_pixelinfo_text release];
+
+	//U
+	NSString *U_pixelinfo_text;
+	U_pixelinfo_text = [[NSString alloc] initWithFormat:@"U:"];
+	[self setPixinfoText_U:U_pixelinfo_text];
+	[U_pixelinfo_text release];
+
+	//P
+	NSString *P_pixelinfo_text;
+	P_pixelinfo_text = [[NSString alloc] initWithFormat:@"P:"];
+	[self setPixinfoText_P:P_pixelinfo_text];
+	[P_pixelinfo_text release];
+
+	if (preview)
+	{
+		//keep the bar going until the full resolution maps are up
+		[self setProgressText:@"showing a low resolution preview, generating full resolution maps..."];
+	}
+	else
+	{
+		[self setProgressText:@""];
+		[self setProgressIndicator:0.0];
+	}
+
+	[myOpenGLview setNeedsDisplay:YES];
+}
+
+//called on the main thread once the file of a job has been checked
+- (void)loadStarted:(NSValue *)jobvalue
+{
+	mapload *job = (mapload *)[jobvalue pointerValue];
+
+	if (mapload_cancelled(job)) return;
+	if (job->type == HPIC_FITS_FULL)
+	{
+		[self setProgressText:@"this is a valid HEALPix FITS file, reading data..."];
+	}
+	else
+	{
+		[self setProgressText:@"this is a cut sky map... OK"];
+	}
+}
+
+//the error kept by a failed job, not the hpic globals, which another load
+//may be using by now
+- (void)showLoadFailure:(NSValue *)jobvalue
+{
+	mapload *job = (mapload *)[jobvalue pointerValue];
+	NSString *guierrorstr;
+
+	if (job->hpicerror[0])
+	{
+		guierrorstr = [[NSString alloc] initWithFormat:@"hpic error: %s",job->hpicerror];
+	}
+	else
+	{
+		guierrorstr = [[NSString alloc] initWithFormat:@"%s",job->failure ? job->failure : ""];
+	}
+	[self setProgressText:guierrorstr];
+	[guierrorstr release];
 }
 
 
@@ -1399,7 +1669,7 @@ void my_hpic_error_handler (int errcode, const char *file,
 	maptype = map_type;
 }
 
-- (int)Npixels
+- (long long)Npixels
 {
 	return Npixels;
 }
@@ -1419,9 +1689,9 @@ void my_hpic_error_handler (int errcode, const char *file,
 	return map_nside;
 }
 
-- (void)setNpixels:(int)pixelnumber
+- (void)setNpixels:(long long)pixelnumber
 {
-	Npixels = (int)pixelnumber;
+	Npixels = pixelnumber;
 }
 
 - (void)setPolarisation:(int)pol
@@ -1499,6 +1769,9 @@ void my_hpic_error_handler (int errcode, const char *file,
 {
 	if ([self maptype]!=0) 
 	{
+		pyramid_free(&Tpyramid);
+		pyramid_free(&Qpyramid);
+		pyramid_free(&Upyramid);
 		if (hpic_Tmap != NULL) 
 		{
 			hpic_float_free(hpic_Tmap);
@@ -1515,6 +1788,11 @@ void my_hpic_error_handler (int errcode, const char *file,
 		{
 			hpic_fltarr_free(hpic_maps);
 		}
+		if (cutmap != NULL)
+		{
+			sparse_free(cutmap);
+			free(cutmap);
+		}
 	}	
 	
 	[preferenceController release];
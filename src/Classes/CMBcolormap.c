@@ -0,0 +1,375 @@
+/*****************************************************************************
+* Copyright 2005 Jamie Portsmouth <jamports@mac.com>                         *
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+*                                                                            *
+* Colormap definitions and color computations.                               *
+*                                                                            *
+*****************************************************************************/
+
+#import "CMBcolormap.h"
+#import "memory.h"
+#import "threadpool.h"
+
+//colormaps
+colormap mycolormaps[8];
+colormap *current_colormap_ptr;
+
+
+/**********************************************************************/
+/*                       color computations                           */
+/**********************************************************************/
+
+/* convert from HSV color values to RGB values (all in range [0,1]) */
+inline void HSVtoRGB( float *r, float *g, float *b, float h, float s, float v )
+{
+	int i;
+	float f, p, q, t;
+	if (s==0.0f) 
+	{
+		// achromatic (grey)
+		*r = *g = *b = v;
+		return;
+	}
+	if (h==1.0f)
+	{
+		i = 5;
+		h = 6.0f;  
+	}
+	else
+	{
+		h *= 6.0f;  
+		i = (int)floor((double)h);
+	}
+	f = h - (float)i;                      
+	p = v * (1.0f - s);
+	q = v * (1.0f - s*f);
+	t = v * (1.0f - s*(1.0f-f));
+	switch(i)
+	{
+		case 0:  *r = v; *g = t; *b = p; break;
+		case 1:  *r = q; *g = v; *b = p; break;
+		case 2:  *r = p; *g = v; *b = t; break;
+		case 3:  *r = p; *g = q; *b = v; break;
+		case 4:  *r = t; *g = p; *b = v; break;
+		default: *r = v; *g = p; *b = q; break;
+	}
+}
+
+inline void colortable(int c, int samples, int channels, float map_scalars[samples], 
+					   float map_values[samples][channels], float **cm_scalars, float ***cm_values)
+{
+	int i,j;	
+	for (i=0;i<samples;i++) 
+	{
+		cm_scalars[c][i] = map_scalars[i];
+		for (j=0;j<channels;j++)
+		{
+			cm_values[c][i][j] = map_values[i][j];
+		}
+	}
+}
+
+/* discover where x lies in an ordered table tbl[] */
+inline void findbin(float tbl[], unsigned long n, float x, unsigned long *j)
+{
+	unsigned long ju,jm,jl;
+	int step;
+	
+	jl=0;
+	ju=n+1;
+	step = (tbl[n] >= tbl[1]);
+	while (ju-jl > 1) 
+	{
+		jm=(ju+jl) >> 1;
+		if ((x >= tbl[jm]) == step)
+			jl=jm;
+		else
+			ju=jm;
+	}
+	if (x == tbl[1]) *j=1;
+	else if(x == tbl[n]) *j=n-1;
+	else *j=jl;
+}
+
+
+/* linearly interpolate between endpoints in HSV color space */
+inline void colorpath(int n, float *xi, float **ci, float x, float *c)
+{
+	//find out in which interval x lies
+	unsigned long j;
+	findbin(xi-1, n, x, &j); 
+	j -= 1;
+	
+	//find interpolated HSV value
+	int a;
+	float step = (xi[j+1] - xi[j]);
+	float histep = (xi[j+1]-x)/step;
+	float lostep = (x-xi[j])/step;
+	for (a=0;a<3;a++) 
+	{
+		c[a] =  histep*ci[j][a] + lostep*ci[j+1][a];
+	}
+}
+
+/* Colormaps are defined by specifying HSV triples at points (samples) 
+   on the interval [0,1], and linearly interpolating HSV between these points. 
+   In each colormap structure, 1-d array color_xi contains the sample positions, 
+   and 2-d array color_ci contains the HSV triples at each sample. */
+void define_colormaps(void)
+{	
+	int i,j; 	
+	enum colormaps cm;
+	
+	const int MAX_NUMBER_OF_COLORMAPS = 8;
+	const int MAX_COLORMAP_SAMPLES = 10;
+	
+	float **CM_SCALARS = matrix(0, MAX_NUMBER_OF_COLORMAPS, 0, MAX_COLORMAP_SAMPLES);
+	float ***CM_VALUES = f3matrix(0, MAX_NUMBER_OF_COLORMAPS, 0, MAX_COLORMAP_SAMPLES, 0, 3);
+	
+	for (cm = hsv; cm<=winter; cm++) 
+	{	
+		for (i=0;i<MAX_COLORMAP_SAMPLES;i++) 
+		{
+			CM_SCALARS[cm][i] = 0.0f;
+			for (j=0;j<3;j++)
+			{
+				CM_VALUES[cm][i][j] = 0.0f;
+			}
+		}
+	}
+	
+	//hsv colormap
+	cm = hsv;
+	mycolormaps[cm].color_N = 2;		
+	float HSV_SCALARS[2] = {0.0f, 1.0f};
+	float HSV_VALUES[2][3] = {{0.0f, 1.0f, 1.0f}, {0.936f, 1.0f, 1.0f}};		
+	colortable(cm, mycolormaps[cm].color_N, 3 , HSV_SCALARS ,HSV_VALUES, CM_SCALARS, CM_VALUES);
+	
+	//jet colormap
+	cm = jet;
+	mycolormaps[cm].color_N = 6;	
+	float JET_SCALARS[6] = {0.0f, 0.3f, 0.36f, 0.55f, 0.75f, 1.0f};
+	float JET_VALUES[6][3] = 
+	{{ 0.68f,   1.0f,  0.7f },
+	 { 0.5f,    1.0f,  1.0f },
+	 { 0.456f,  0.55f, 0.95f},
+	 { 0.1666f, 0.6f,  1.0f },
+	 { 0.0444f, 1.0f,  1.0f },
+	 { 0.0f,    1.0f,  0.52f}};			
+	colortable(cm, mycolormaps[cm].color_N, 3, JET_SCALARS, JET_VALUES, CM_SCALARS, CM_VALUES);
+	
+	//hot colormap
+	cm = hot;
+	mycolormaps[cm].color_N = 4;	
+	float HOT_SCALARS[4] = {0.0f, 0.3333f, 0.6666f, 1.0f};
+	float HOT_VALUES[4][3] = 
+	{{ 0.0f,    0.0f, 0.0f },
+	 { 0.0f,    1.0f, 1.0f },
+	 { 0.1666f, 1.0f, 1.0f },
+	 { 0.1666f, 0.0f, 1.0f }};			
+	colortable(cm,mycolormaps[cm].color_N, 3, HOT_SCALARS, HOT_VALUES, CM_SCALARS, CM_VALUES);
+	
+	//cool colormap
+	cm = cool;
+	mycolormaps[cm].color_N = 3;	
+	float COOL_SCALARS[3] = {0.0f, 0.5f, 1.0f};
+	float COOL_VALUES[3][3] = 
+	{{ 0.5f,    1.0f,  1.0f },
+	 { 0.636f,  0.55f, 1.0f },
+	 { 0.8333f, 1.0f,  1.0f }};
+	colortable(cm, mycolormaps[cm].color_N, 3, COOL_SCALARS, COOL_VALUES, CM_SCALARS, CM_VALUES);
+	
+	//copper colormap
+	cm = copper;
+	mycolormaps[cm].color_N = 3;	
+	float COPPER_SCALARS[3] = {0.0f, 0.5f, 1.0f};
+	float COPPER_VALUES[3][3] = 
+	{{ 0.0f,     0.67f, 0.05f },
+	 { 0.06888f, 0.62f, 0.68f },
+	 { 0.09444f, 0.52f, 1.0f  }};
+	colortable(cm, mycolormaps[cm].color_N, 3, COPPER_SCALARS, COPPER_VALUES, CM_SCALARS, CM_VALUES);
+	
+	//negative grey colormap
+	cm = neg;
+	mycolormaps[cm].color_N = 2;	
+	float NEG_SCALARS[2] = {0.0f, 1.0f};
+	float NEG_VALUES[2][3] = 
+	{{ 0.0f, 0.0f, 1.0f },
+	 { 0.0f, 0.0f, 0.0f }};
+	colortable(cm, mycolormaps[cm].color_N, 3, NEG_SCALARS, NEG_VALUES, CM_SCALARS, CM_VALUES);
+	
+	//bone colormap
+	cm = bone;
+	mycolormaps[cm].color_N = 3;	
+	float BONE_SCALARS[3] = {0.0f, 0.5f, 1.0f};
+	float BONE_VALUES[3][3] = 
+	{{ 0.6666f, 1.0f,  0.03f },
+	 { 0.625f,  0.24f, 0.55f },
+	 { 0.0f,    0.0f,  1.0f  }};
+	colortable(cm, mycolormaps[cm].color_N, 3, BONE_SCALARS, BONE_VALUES, CM_SCALARS, CM_VALUES);
+	
+	//winter colormap
+	cm = winter;
+	mycolormaps[cm].color_N = 5;	
+	float WINTER_SCALARS[5] = {0.0f, 0.25f, 0.5f, 0.75f, 1.0f};
+	float WINTER_VALUES[5][3] = 
+	{{ 0.6666f, 1.0f, 0.0f },
+	 { 0.6666f, 1.0f, 0.5f },
+	 { 0.5444f, 1.0f, 0.7f },
+	 { 0.4194f, 1.0f, 1.0f },
+	 { 0.4194f, 0.0f, 1.0f }};
+	colortable(cm, mycolormaps[cm].color_N, 3, WINTER_SCALARS, WINTER_VALUES, CM_SCALARS, CM_VALUES);
+	
+	for (cm = hsv; cm<=winter; cm++)
+	{	
+		mycolormaps[cm].color_xi = vector(0,mycolormaps[cm].color_N-1);
+		mycolormaps[cm].color_ci = matrix(0,mycolormaps[cm].color_N-1,0,2);
+		
+		for (i=0;i<mycolormaps[cm].color_N;i++) 
+		{
+			mycolormaps[cm].color_xi[i] = CM_SCALARS[cm][i];
+			for (j=0;j<3;j++)
+			{
+				mycolormaps[cm].color_ci[i][j] = CM_VALUES[cm][i][j];
+			}
+		}
+	}
+	
+	free_matrix(CM_SCALARS, 0, MAX_NUMBER_OF_COLORMAPS, 0, MAX_COLORMAP_SAMPLES);
+	free_f3matrix(CM_VALUES, 0, MAX_NUMBER_OF_COLORMAPS, 0, MAX_COLORMAP_SAMPLES, 0, 3);
+}
+
+
+/**********************************************************************/
+/*                       color lookup tables                          */
+/**********************************************************************/
+
+//values colored by each thread pool task, and by each pass of the two
+//inner loops (small enough for the indices to stay in L1)
+#define COLORLUT_TASK (1L<<16)
+#define COLORLUT_BLOCK 256
+
+typedef struct
+{
+	const colorlut *lut;
+	const float *values;
+	const int *mask;
+	size_t n;
+	float min, scale, bias;
+	unsigned char *rgb;
+} colorjob;
+
+void colorlut_build(colorlut *lut, colormap *cm, int colormap_flag, int reverse)
+{
+	int i;
+	float scalar,R,G,B,color_x[3];
+
+	for (i=0; i<COLORLUT_SIZE; i++)
+	{
+		scalar = (float)i/(float)(COLORLUT_SIZE-1);
+		if (colormap_flag==0)
+		{
+			/* greyscale map */
+			R = scalar; G = scalar; B = scalar;
+		}
+		else
+		{
+			/* color map */
+			if (reverse) scalar = 1.0-scalar;
+			colorpath(cm->color_N,cm->color_xi,cm->color_ci,scalar,color_x);
+			HSVtoRGB(&R,&G,&B,color_x[0],color_x[1],color_x[2]);
+		}
+		lut->rgb[i][0] = (unsigned char)(255.0*R);
+		lut->rgb[i][1] = (unsigned char)(255.0*G);
+		lut->rgb[i][2] = (unsigned char)(255.0*B);
+		lut->rgb[i][3] = 0;
+	}
+}
+
+static void color_task(void *arg, long task, int worker)
+{
+	colorjob *job = (colorjob *)arg;
+	int idx[COLORLUT_BLOCK];
+	const unsigned char *c;
+	const float *v;
+	unsigned char *p;
+	size_t start, end, i, k, len;
+	float t, top = (float)(COLORLUT_SIZE-1);
+
+	start = (size_t)task*COLORLUT_TASK;
+	end = start+COLORLUT_TASK < job->n ? start+COLORLUT_TASK : job->n;
+
+	for (i=start; i<end; i+=len)
+	{
+		len = end-i < COLORLUT_BLOCK ? end-i : COLORLUT_BLOCK;
+		v = job->values + i;
+
+		//quantize: a straight line loop, which the compiler vectorizes
+		for (k=0; k<len; k++)
+		{
+			t = (v[k]-job->min)*job->scale + job->bias;
+			t = t < top ? t : top;
+			t = t > 0.0f ? t : 0.0f;
+			idx[k] = (int)t;
+		}
+
+		//gather
+		p = job->rgb + 3*i;
+		for (k=0; k<len; k++, p+=3)
+		{
+			if (job->mask && !job->mask[i+k])
+			{
+				//background color
+				p[0] = p[1] = p[2] = 255;
+				continue;
+			}
+			c = job->lut->rgb[idx[k]];
+			p[0] = c[0]; p[1] = c[1]; p[2] = c[2];
+		}
+	}
+}
+
+void colorlut_apply(const colorlut *lut, const float *values, const int *mask,
+					size_t n, float min, float max, unsigned char *rgb)
+{
+	colorjob job;
+
+	job.lut = lut;
+	job.values = values;
+	job.mask = mask;
+	job.n = n;
+	job.rgb = rgb;
+	job.min = min;
+
+	//nearest entry; a zero width range maps everything to the middle
+	if (max != min)
+	{
+		job.scale = (float)(COLORLUT_SIZE-1)/(max-min);
+		job.bias = 0.5f;
+	}
+	else
+	{
+		job.scale = 0.0f;
+		job.bias = 0.5f*(float)(COLORLUT_SIZE-1) + 0.5f;
+	}
+
+	threadpool_run(color_task,&job,(long)((n+COLORLUT_TASK-1)/COLORLUT_TASK),NULL,NULL);
+}
@@ -0,0 +1,70 @@
+/*****************************************************************************
+* Copyright 2005 Jamie Portsmouth <jamports@mac.com>                         *
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+*                                                                            *
+* Colormaps, and conversion of map values to colors. Shared by the           *
+* application and the command line renderer, so kept free of OpenGL.        *
+*                                                                            *
+*****************************************************************************/
+
+#import <stdio.h>
+#import <stdlib.h>
+#import <math.h>
+
+//colormap variables
+typedef struct 
+{
+	int color_N;
+	float *color_xi;
+	float **color_ci;
+} colormap;
+extern colormap mycolormaps[8];
+extern colormap *current_colormap_ptr;
+enum colormaps {hsv, jet, hot, cool, copper, neg, bone, winter};
+
+//color computations
+void HSVtoRGB( float *r, float *g, float *b, float h, float s, float v );
+void colorpath(int n, float *xi, float **ci, float x, float *c);
+void findbin(float xx[], unsigned long n, float x, unsigned long *j);
+void define_colormaps(void);
+void colortable(int c, int samples, int channels, 
+				float map_scalars[samples], float map_values[samples][channels],
+				float **cm_scalars, float ***cm_values);
+
+//colormaps baked into lookup tables:
+
+//number of entries in a table, spanning the color range evenly
+#define COLORLUT_SIZE 4096
+
+//RGB for each entry, padded to 4 bytes so entries are word aligned
+typedef struct
+{
+	unsigned char rgb[COLORLUT_SIZE][4];
+} colorlut;
+
+//bake colormap cm (or greyscale, if colormap_flag is 0) and the reverse flag
+void colorlut_build(colorlut *lut, colormap *cm, int colormap_flag, int reverse);
+
+//color n values into packed RGB triples, scaling [min,max] onto the table and
+//clamping outside it. Where mask is not NULL, values with mask 0 get the
+//white background instead. Large arrays are split across the thread pool.
+void colorlut_apply(const colorlut *lut, const float *values, const int *mask,
+					size_t n, float min, float max, unsigned char *rgb);
@@ -47,11 +47,23 @@ extern AppController *anAppController;
 	histogram histogram_presentation;
 	
 	int Ngc_arc, Ntexture, Ntex_render, NStokes;
+	//(vectors the Stokes arrays have room for)
+	int NStokes_alloc;
 	
 	//pointers to texture data
 	float ***Tface, ***Qface, ***Uface, ***Pface;
 	float **renderdata, **renderdata_export;
 	int **rendermask, **rendermask_export;
+	
+	//render data binned during the trace, see makeHistograms_render
+	prehist *render_prehist;
+	
+	//renderdata, rendermask and render_prehist belong to the render cache;
+	//scratch_arena holds buffers which last only for one method call
+	memarena scratch_arena;
+	
+	//bumped whenever new map data is loaded, to key the render cache
+	int map_serial;
 } 
 
 - (id)init;
@@ -69,8 +81,8 @@ extern AppController *anAppController;
 
 - (void)genTextures_interactive;
 - (void)updateTexs_interactive;
-- (void)scancube_T;
-- (void)scancube_TQU;
+- (BOOL)scancube_T;
+- (BOOL)scancube_TQU;
 - (void)genTextures_render;
 - (void)updateTexs_render;
 - (void)genTextures_render_forexport;
@@ -0,0 +1,408 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+* Memory-mapped reader for full sky HEALPix FITS maps. The file is mapped    *
+* read-only, the primary and binary table headers are parsed here to find    *
+* where each column sits in a table row, and the big-endian floats are then  *
+* converted straight into the hpic map buffers in a single pass, split over  *
+* the thread pool. There is no cfitsio buffering and no intermediate copy.   *
+*                                                                            *
+*****************************************************************************/
+
+#import <string.h>
+#import <stdint.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import "CMBfitsmap.h"
+#import "threadpool.h"
+
+#define FITS_BLOCK 2880
+#define FITS_CARD 80
+
+//room for an indexed keyword: a 5 letter root, any int, and the nul
+#define FITS_KEYLEN (5+11+1)
+
+//bytes of table converted by each thread pool task
+#define FITSMAP_TASKBYTES (1L<<18)
+
+//where a column lives in a table row
+typedef struct
+{
+	size_t offset, repeat;
+	char code;
+} fitscol;
+
+//the map extension: its header cards, and the table data offset in the file
+typedef struct
+{
+	const char *hdr, *end;
+	size_t data;
+	long rowbytes, nrows, tfields;
+} fitstable;
+
+typedef struct
+{
+	const unsigned char *table;
+	size_t rowbytes, nrows, rowspertask, repeat;
+	int ncols;
+	const fitscol *cols;
+	float **dst;
+} swapjob;
+
+
+/**********************************************************************/
+/*                          header parsing                            */
+/**********************************************************************/
+
+//does this card hold the given keyword (keywords are padded to 8 chars)?
+static int card_is(const char *card, const char *key)
+{
+	size_t i, len = strlen(key);
+
+	if (memcmp(card,key,len)!=0) return 0;
+	for (i=len; i<8; i++)
+	{
+		if (card[i]!=' ') return 0;
+	}
+	return 1;
+}
+
+//the first card with this keyword in the header, or NULL
+static const char *header_card(const char *hdr, const char *end, const char *key)
+{
+	const char *card;
+
+	for (card=hdr; card+FITS_CARD<=end; card+=FITS_CARD)
+	{
+		if (card_is(card,"END")) return NULL;
+		if (card_is(card,key)) return card;
+	}
+	return NULL;
+}
+
+//the value field of a card, as a nul-terminated string
+static int card_value(const char *card, char *buf)
+{
+	if (card[8]!='=') return 0;
+	memcpy(buf,card+10,FITS_CARD-10);
+	buf[FITS_CARD-10] = '\0';
+	return 1;
+}
+
+static int header_long(const char *hdr, const char *end, const char *key, long *val)
+{
+	const char *card = header_card(hdr,end,key);
+	char buf[FITS_CARD], *p;
+
+	if (!card || !card_value(card,buf)) return 0;
+	*val = strtol(buf,&p,10);
+	return p!=buf;
+}
+
+static int header_double(const char *hdr, const char *end, const char *key, double *val)
+{
+	const char *card = header_card(hdr,end,key);
+	char buf[FITS_CARD], *p;
+
+	if (!card || !card_value(card,buf)) return 0;
+	*val = strtod(buf,&p);
+	return p!=buf;
+}
+
+//a quoted string value, with '' unescaped and trailing blanks removed
+static int header_string(const char *hdr, const char *end, const char *key,
+						 char *out, size_t len)
+{
+	const char *card = header_card(hdr,end,key);
+	char buf[FITS_CARD], *p;
+	size_t n = 0;
+
+	out[0] = '\0';
+	if (!card || !card_value(card,buf)) return 0;
+	p = strchr(buf,'\'');
+	if (!p) return 0;
+	for (p++; *p && n+1<len; p++)
+	{
+		if (*p=='\'')
+		{
+			if (p[1]!='\'') break;
+			p++;
+		}
+		out[n++] = *p;
+	}
+	while (n>0 && out[n-1]==' ') n--;
+	out[n] = '\0';
+	return 1;
+}
+
+//length of the header starting at off, in whole blocks, or 0 if it has no END
+static size_t header_size(const char *base, size_t size, size_t off)
+{
+	size_t p;
+
+	for (p=off; p+FITS_CARD<=size; p+=FITS_CARD)
+	{
+		if (card_is(base+p,"END"))
+		{
+			return ((p+FITS_CARD-off+FITS_BLOCK-1)/FITS_BLOCK)*FITS_BLOCK;
+		}
+	}
+	return 0;
+}
+
+//parse a TFORMn value such as "E", "1024E" or "1PE(100)" into a repeat count,
+//type code and width in bytes
+static int parse_tform(const char *tform, fitscol *col, size_t *width)
+{
+	char *p;
+	long r;
+	size_t size;
+
+	r = strtol(tform,&p,10);
+	if (p==tform) r = 1;
+	if (r<0) return 0;
+	col->repeat = (size_t)r;
+	col->code = *p;
+
+	switch (col->code)
+	{
+		case 'L': case 'B': case 'A': size = 1; break;
+		case 'I': size = 2; break;
+		case 'J': case 'E': size = 4; break;
+		case 'K': case 'D': case 'C': case 'P': size = 8; break;
+		case 'M': case 'Q': size = 16; break;
+		case 'X': *width = (col->repeat+7)/8; return 1;
+		default: return 0;
+	}
+	*width = col->repeat*size;
+	return 1;
+}
+
+
+/**********************************************************************/
+/*                            conversion                              */
+/**********************************************************************/
+
+//one big-endian IEEE float; NaN is the FITS null and becomes HPIC_NULL,
+//as it does when cfitsio reads the column
+static inline float fits_float(const unsigned char *p)
+{
+	union { uint32_t i; float f; } u;
+
+	u.i = ((uint32_t)p[0]<<24) | ((uint32_t)p[1]<<16) | ((uint32_t)p[2]<<8) | (uint32_t)p[3];
+	if ((u.i & 0x7f800000)==0x7f800000 && (u.i & 0x007fffff)) u.f = (float)HPIC_NULL;
+	return u.f;
+}
+
+//one task per block of rows; every map column in the block is converted
+static void swap_rows(void *arg, long task, int worker)
+{
+	swapjob *job = (swapjob *)arg;
+	const unsigned char *src;
+	size_t r, r0, r1, k;
+	float *dst;
+	int c;
+
+	r0 = (size_t)task*job->rowspertask;
+	r1 = r0+job->rowspertask < job->nrows ? r0+job->rowspertask : job->nrows;
+
+	for (c=0; c<job->ncols; c++)
+	{
+		src = job->table + r0*job->rowbytes + job->cols[c].offset;
+		dst = job->dst[c] + r0*job->repeat;
+		if (job->repeat==1)
+		{
+			for (r=r0; r<r1; r++, src+=job->rowbytes) *dst++ = fits_float(src);
+			continue;
+		}
+		for (r=r0; r<r1; r++, src+=job->rowbytes, dst+=job->repeat)
+		{
+			for (k=0; k<job->repeat; k++) dst[k] = fits_float(src+4*k);
+		}
+	}
+}
+
+
+/**********************************************************************/
+/*                           table layout                             */
+/**********************************************************************/
+
+//skip the primary HDU (any image data in it too) and check that the map
+//extension after it is an ordinary binary table. Gzipped files, and anything
+//else that does not start with SIMPLE, are left to cfitsio.
+static int find_table(const char *base, size_t size, fitstable *t)
+{
+	size_t hsize, bytes, off;
+	long bitpix, naxis, n, pcount, gcount;
+	char key[FITS_KEYLEN], value[HPIC_STRNL];
+	int i;
+
+	if (!card_is(base,"SIMPLE")) return 0;
+	hsize = header_size(base,size,0);
+	if (!hsize) return 0;
+	t->hdr = base;
+	t->end = base+hsize;
+	if (header_card(t->hdr,t->end,"GROUPS")) return 0;
+	if (!header_long(t->hdr,t->end,"BITPIX",&bitpix) ||
+		!header_long(t->hdr,t->end,"NAXIS",&naxis)) return 0;
+	bytes = naxis>0 ? (size_t)labs(bitpix)/8 : 0;
+	for (i=1; i<=naxis; i++)
+	{
+		snprintf(key,sizeof(key),"NAXIS%d",i);
+		if (!header_long(t->hdr,t->end,key,&n) || n<0) return 0;
+		bytes *= (size_t)n;
+	}
+	off = hsize + ((bytes+FITS_BLOCK-1)/FITS_BLOCK)*FITS_BLOCK;
+	if (off+FITS_BLOCK>size) return 0;
+
+	//a tile-compressed table is also a BINTABLE, but carries ZTABLE
+	if (!card_is(base+off,"XTENSION")) return 0;
+	hsize = header_size(base,size,off);
+	if (!hsize) return 0;
+	t->hdr = base+off;
+	t->end = t->hdr+hsize;
+	if (!header_string(t->hdr,t->end,"XTENSION",value,sizeof(value)) ||
+		strcmp(value,"BINTABLE")!=0) return 0;
+	if (header_card(t->hdr,t->end,"ZTABLE") || header_card(t->hdr,t->end,"ZIMAGE")) return 0;
+	if (!header_long(t->hdr,t->end,"NAXIS1",&t->rowbytes) ||
+		!header_long(t->hdr,t->end,"NAXIS2",&t->nrows) ||
+		!header_long(t->hdr,t->end,"TFIELDS",&t->tfields)) return 0;
+	if (!header_long(t->hdr,t->end,"PCOUNT",&pcount)) pcount = 0;
+	if (!header_long(t->hdr,t->end,"GCOUNT",&gcount)) gcount = 1;
+	if (t->rowbytes<=0 || t->nrows<=0 || t->tfields<1 || t->tfields>999 ||
+		pcount<0 || gcount!=1) return 0;
+
+	t->data = off+hsize;
+	return t->data + (size_t)t->rowbytes*(size_t)t->nrows <= size;
+}
+
+//work out where every column sits in a row, and check that the first nmaps
+//are unscaled float columns holding the whole sky
+static int find_columns(const fitstable *t, hpic_fltarr *maps, size_t nmaps,
+						fitscol *cols, float **dst)
+{
+	char key[FITS_KEYLEN], value[HPIC_STRNL];
+	double scale, zero;
+	size_t width, rowoff, npix, i;
+	hpic_float *map;
+
+	if (t->tfields<(long)nmaps) return 0;
+	rowoff = 0;
+	for (i=0; i<(size_t)t->tfields; i++)
+	{
+		snprintf(key,sizeof(key),"TFORM%d",(int)i+1);
+		if (!header_string(t->hdr,t->end,key,value,sizeof(value))) return 0;
+		if (!parse_tform(value,&cols[i],&width)) return 0;
+		cols[i].offset = rowoff;
+		rowoff += width;
+	}
+	if (rowoff!=(size_t)t->rowbytes) return 0;
+
+	for (i=0; i<nmaps; i++)
+	{
+		map = hpic_fltarr_get(maps,i);
+		if (!map || !map->data) return 0;
+		npix = 12*map->nside*map->nside;
+		if (map->npix!=npix || cols[i].code!='E' || cols[i].repeat!=cols[0].repeat) return 0;
+		if (cols[i].repeat*(size_t)t->nrows!=npix) return 0;
+		snprintf(key,sizeof(key),"TSCAL%d",(int)i+1);
+		if (header_double(t->hdr,t->end,key,&scale) && scale!=1.0) return 0;
+		snprintf(key,sizeof(key),"TZERO%d",(int)i+1);
+		if (header_double(t->hdr,t->end,key,&zero) && zero!=0.0) return 0;
+		dst[i] = map->data;
+	}
+	return 1;
+}
+
+
+/**********************************************************************/
+/*                            interface                               */
+/**********************************************************************/
+
+int fitsmap_read(const char *filename, hpic_fltarr *maps)
+{
+	char key[FITS_KEYLEN], value[HPIC_STRNL];
+	size_t size, nmaps, i;
+	fitstable t;
+	fitscol *cols = NULL;
+	float **dst = NULL;
+	hpic_float *map;
+	struct stat sb;
+	swapjob job;
+	void *mapping;
+	int ok;
+	FILE *fp;
+
+	nmaps = hpic_fltarr_n_get(maps);
+	if (nmaps<1) return 0;
+
+	fp = fopen(filename,"rb");
+	if (!fp) return 0;
+	if (fstat(fileno(fp),&sb)!=0 || sb.st_size<2*FITS_BLOCK)
+	{
+		fclose(fp);
+		return 0;
+	}
+	size = (size_t)sb.st_size;
+	mapping = mmap(NULL,size,PROT_READ,MAP_SHARED,fileno(fp),0);
+	fclose(fp);
+	if (mapping==MAP_FAILED) return 0;
+	madvise(mapping,size,MADV_SEQUENTIAL);
+
+	ok = find_table((const char *)mapping,size,&t);
+	if (ok)
+	{
+		cols = (fitscol *)calloc((size_t)t.tfields,sizeof(fitscol));
+		dst = (float **)calloc(nmaps,sizeof(float *));
+		ok = cols && dst && find_columns(&t,maps,nmaps,cols,dst);
+	}
+
+	//the file is good: from here on the maps are overwritten
+	if (ok)
+	{
+		for (i=0; i<nmaps; i++)
+		{
+			map = hpic_fltarr_get(maps,i);
+			snprintf(key,sizeof(key),"TTYPE%d",(int)i+1);
+			header_string(t.hdr,t.end,key,value,sizeof(value));
+			hpic_float_name_set(map,value);
+			snprintf(key,sizeof(key),"TUNIT%d",(int)i+1);
+			header_string(t.hdr,t.end,key,value,sizeof(value));
+			hpic_float_units_set(map,value);
+		}
+
+		job.table = (const unsigned char *)mapping + t.data;
+		job.rowbytes = (size_t)t.rowbytes;
+		job.nrows = (size_t)t.nrows;
+		job.repeat = cols[0].repeat;
+		job.rowspertask = FITSMAP_TASKBYTES / job.rowbytes;
+		if (job.rowspertask<1) job.rowspertask = 1;
+		job.ncols = (int)nmaps;
+		job.cols = cols;
+		job.dst = dst;
+		threadpool_run(swap_rows,&job,(long)((job.nrows+job.rowspertask-1)/job.rowspertask),
+					   NULL,NULL);
+	}
+
+	if (cols) free(cols);
+	if (dst) free(dst);
+	munmap(mapping,size);
+	return ok;
+}
@@ -0,0 +1,29 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+*****************************************************************************/
+
+#import "hpic.h"
+
+//read the maps of a full sky HEALPix FITS file from a memory mapping of the
+//file, bypassing cfitsio. Returns 1 if the maps were read, or 0 if the file
+//is anything but a plain uncompressed table of float columns, in which case
+//nothing has been changed and the caller should use hpic_fits_full_read.
+int fitsmap_read(const char *filename, hpic_fltarr *maps);
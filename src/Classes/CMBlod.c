@@ -0,0 +1,323 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+* View dependent sphere mesh. Starting from the six cube faces, the patch    *
+* that looks biggest from the observer is split in four until the patch      *
+* budget is used; patches behind the horizon or outside the view frustum     *
+* are dropped. Each patch is a small regular grid with a skirt round its     *
+* edge hanging into the sphere, which hides the cracks where it meets a      *
+* patch of a different size.                                                 *
+*                                                                            *
+*****************************************************************************/
+
+#import <string.h>
+#import "CMBlod.h"
+#import "memory.h"
+
+//vertices and triangles in one patch, skirt included
+#define LOD_PATCHVERTS ((LOD_GRID+1)*(LOD_GRID+1)+4*LOD_GRID)
+#define LOD_PATCHTRIS (2*LOD_GRID*LOD_GRID+8*LOD_GRID)
+
+//a split adds up to three patches
+#define LOD_MAXNODES (LOD_PATCHES+3)
+
+typedef struct
+{
+	float size;
+	int face, level, i, j;
+} lodnode;
+
+//what the mesh was last built for
+typedef struct
+{
+	float view_point[3], view_direction[3];
+	float fovy, aspect_ratio, frustum_height;
+	int ortho;
+} lodview;
+
+static lodview builtview;
+static int built = 0;
+
+//the view, and quantities used in the size test
+typedef struct
+{
+	const Observer *o;
+	float fovy;
+	int ortho;
+	double eye[3], tanhalf, halfheight;
+} lodobserver;
+
+
+/**********************************************************************/
+/*                        patch geometry                              */
+/**********************************************************************/
+
+//unit vector to the point (x,y) in [-1,1]^2 on a cube face
+static void cubepoint(int face, double x, double y, double *p)
+{
+	int c;
+	double norm = 0.0;
+	
+	for (c=0;c<3;c++)
+	{
+		p[c] = cubecoords.local_z[face][c] + x*cubecoords.local_x[face][c]
+										   + y*cubecoords.local_y[face][c];
+		norm += p[c]*p[c];
+	}
+	norm = sqrt(norm);
+	for (c=0;c<3;c++) p[c] /= norm;
+}
+
+static double dot(const double *a, const double *b)
+{
+	return a[0]*b[0]+a[1]*b[1]+a[2]*b[2];
+}
+
+//set the on-screen size of a patch, as a fraction of the half height of
+//the view. Returns 0 if no part of it can be seen.
+static int measure(const lodobserver *lo, lodnode *n)
+{
+	double side = 2.0/(double)(1<<n->level);
+	double x0 = -1.0+side*n->i, y0 = -1.0+side*n->j;
+	double centre[3], corner[3], d[3];
+	double cosr = 1.0, mu, rho, dist;
+	int a,b,c;
+	
+	//the patch lies in a cap of angular radius r about its centre
+	cubepoint(n->face,x0+0.5*side,y0+0.5*side,centre);
+	for (a=0;a<2;a++)
+	{
+		for (b=0;b<2;b++)
+		{
+			cubepoint(n->face,x0+a*side,y0+b*side,corner);
+			mu = dot(centre,corner);
+			if (mu<cosr) cosr = mu;
+		}
+	}
+	if (!observer_cap_visible(lo->o,lo->fovy,lo->ortho,centre,acos(cosr))) return 0;
+	
+	//size of the ball of radius rho about the centre, which holds the cap
+	rho = radius*sqrt(2.0-2.0*cosr);
+	for (c=0;c<3;c++) d[c] = radius*centre[c]-lo->eye[c];
+	dist = sqrt(dot(d,d));
+	if (lo->ortho) n->size = (float)(rho/lo->halfheight);
+	else n->size = (float)(rho/(fmax(dist-rho,1.0e-6*radius)*lo->tanhalf));
+	return 1;
+}
+
+
+/**********************************************************************/
+/*                     max-heap of patches by size                    */
+/**********************************************************************/
+
+static void heap_push(lodnode *heap, int *nheap, lodnode n)
+{
+	int k = (*nheap)++, parent;
+	while (k>0)
+	{
+		parent = (k-1)/2;
+		if (heap[parent].size >= n.size) break;
+		heap[k] = heap[parent];
+		k = parent;
+	}
+	heap[k] = n;
+}
+
+static lodnode heap_pop(lodnode *heap, int *nheap)
+{
+	lodnode top = heap[0], last = heap[--(*nheap)];
+	int k = 0, child;
+	while ((child = 2*k+1) < *nheap)
+	{
+		if (child+1 < *nheap && heap[child+1].size > heap[child].size) child++;
+		if (heap[child].size <= last.size) break;
+		heap[k] = heap[child];
+		k = child;
+	}
+	heap[k] = last;
+	return top;
+}
+
+
+/**********************************************************************/
+/*                         mesh building                              */
+/**********************************************************************/
+
+//append one patch to the mesh
+static void emit_patch(spheremesh *m, const lodnode *n)
+{
+	double side = 2.0/(double)(1<<n->level);
+	double x0 = -1.0+side*n->i, y0 = -1.0+side*n->j;
+	double faceside = 2.0*(1.0+flange), x, y, p[3], depth;
+	int base = m->Nvertex, skirt, a, b, c, k, e0, e1;
+	int rim[4*LOD_GRID];
+	GLfloat *v;
+	GLushort *t;
+	meshpatch *patch = &m->patch[m->Npatches++];
+	
+	patch->face = n->face;
+	patch->level = n->level;
+	patch->i = n->i;
+	patch->j = n->j;
+	patch->first = m->Nindex;
+	patch->size = 2.0f*n->size;
+	
+	for (b=0;b<=LOD_GRID;b++)
+	{
+		for (a=0;a<=LOD_GRID;a++)
+		{
+			x = x0+side*a/LOD_GRID;
+			y = y0+side*b/LOD_GRID;
+			cubepoint(n->face,x,y,p);
+			v = &m->vertex[3*m->Nvertex];
+			for (c=0;c<3;c++) v[c] = (GLfloat)(radius*p[c]);
+			m->texcoord[2*m->Nvertex]   = (GLfloat)(x/faceside+0.5);
+			m->texcoord[2*m->Nvertex+1] = (GLfloat)(y/faceside+0.5);
+			m->Nvertex++;
+		}
+	}
+	
+	t = &m->index[m->Nindex];
+	for (b=0;b<LOD_GRID;b++)
+	{
+		for (a=0;a<LOD_GRID;a++)
+		{
+			k = base+b*(LOD_GRID+1)+a;
+			*t++ = k; *t++ = k+1; *t++ = k+LOD_GRID+2;
+			*t++ = k; *t++ = k+LOD_GRID+2; *t++ = k+LOD_GRID+1;
+		}
+	}
+	
+	//the edge vertices anticlockwise seen from outside
+	k = 0;
+	for (a=0;a<LOD_GRID;a++) rim[k++] = base+a;
+	for (b=0;b<LOD_GRID;b++) rim[k++] = base+b*(LOD_GRID+1)+LOD_GRID;
+	for (a=LOD_GRID;a>0;a--) rim[k++] = base+LOD_GRID*(LOD_GRID+1)+a;
+	for (b=LOD_GRID;b>0;b--) rim[k++] = base+b*(LOD_GRID+1);
+	
+	//the skirt drops below the sag of the cells of a patch up to five
+	//levels coarser, whose cells are about 4*side radians across
+	depth = 1.0-cos(2.0*side);
+	if (depth>0.5) depth = 0.5;
+	skirt = m->Nvertex;
+	for (k=0;k<4*LOD_GRID;k++)
+	{
+		for (c=0;c<3;c++) m->vertex[3*m->Nvertex+c] = (GLfloat)((1.0-depth)*m->vertex[3*rim[k]+c]);
+		m->texcoord[2*m->Nvertex]   = m->texcoord[2*rim[k]];
+		m->texcoord[2*m->Nvertex+1] = m->texcoord[2*rim[k]+1];
+		m->Nvertex++;
+	}
+	for (k=0;k<4*LOD_GRID;k++)
+	{
+		e0 = rim[k];
+		e1 = rim[(k+1)%(4*LOD_GRID)];
+		*t++ = e0; *t++ = skirt+k; *t++ = skirt+(k+1)%(4*LOD_GRID);
+		*t++ = e0; *t++ = skirt+(k+1)%(4*LOD_GRID); *t++ = e1;
+	}
+	m->Nindex = t - m->index;
+	patch->count = m->Nindex-patch->first;
+}
+
+void lodmesh_init(spheremesh *m)
+{
+	m->vertex = (GLfloat *)malloc(3*LOD_MAXNODES*LOD_PATCHVERTS*sizeof(GLfloat));
+	m->texcoord = (GLfloat *)malloc(2*LOD_MAXNODES*LOD_PATCHVERTS*sizeof(GLfloat));
+	m->index = (GLushort *)malloc(3*LOD_MAXNODES*LOD_PATCHTRIS*sizeof(GLushort));
+	m->patch = (meshpatch *)malloc(LOD_MAXNODES*sizeof(meshpatch));
+	if (!m->vertex || !m->texcoord || !m->index || !m->patch) memerror("failure in lodmesh_init()");
+	m->Nvertex = m->Nindex = m->Npatches = 0;
+	memset(m->first,0,sizeof m->first);
+	memset(m->count,0,sizeof m->count);
+	m->buffers[0] = m->buffers[1] = m->buffers[2] = 0;
+	m->useBuffers = gluCheckExtension((const GLubyte *)"GL_ARB_vertex_buffer_object",
+									  glGetString(GL_EXTENSIONS));
+	built = 0;
+}
+
+int lodmesh_update(spheremesh *m, const Observer *o, float fovy, int ortho)
+{
+	lodview view;
+	lodobserver lo;
+	lodnode heap[LOD_MAXNODES], done[LOD_MAXNODES], n, child;
+	int nheap = 0, ndone = 0, face, k, c;
+	
+	memset(&view,0,sizeof view);
+	for (c=0;c<3;c++)
+	{
+		view.view_point[c] = o->view_point[c];
+		view.view_direction[c] = o->view_direction[c];
+	}
+	view.fovy = ortho ? 0.0f : fovy;
+	view.aspect_ratio = o->aspect_ratio;
+	view.frustum_height = ortho ? o->frustum_height : 0.0f;
+	view.ortho = ortho;
+	if (built && !memcmp(&view,&builtview,sizeof view)) return 0;
+	
+	lo.o = o;
+	lo.fovy = fovy;
+	lo.ortho = ortho;
+	for (c=0;c<3;c++) lo.eye[c] = o->view_point[c];
+	lo.tanhalf = tan(0.5*fovy*PI/180.0);
+	lo.halfheight = 0.5*o->frustum_height;
+	
+	for (face=0;face<6;face++)
+	{
+		n.face = face;
+		n.level = n.i = n.j = 0;
+		if (measure(&lo,&n)) heap_push(heap,&nheap,n);
+	}
+	
+	//split the biggest patch while the budget allows
+	while (nheap>0 && nheap+ndone+3<=LOD_PATCHES)
+	{
+		n = heap_pop(heap,&nheap);
+		if (n.level==LOD_MAXLEVEL)
+		{
+			done[ndone++] = n;
+			continue;
+		}
+		for (k=0;k<4;k++)
+		{
+			child.face = n.face;
+			child.level = n.level+1;
+			child.i = 2*n.i+(k&1);
+			child.j = 2*n.j+(k>>1);
+			if (measure(&lo,&child)) heap_push(heap,&nheap,child);
+		}
+	}
+	for (k=0;k<nheap;k++) done[ndone++] = heap[k];
+	
+	//patches grouped by face so each face is one range of the index array
+	m->Nvertex = m->Nindex = m->Npatches = 0;
+	for (face=0;face<6;face++)
+	{
+		m->first[face] = m->Nindex;
+		for (k=0;k<ndone;k++)
+		{
+			if (done[k].face==face) emit_patch(m,&done[k]);
+		}
+		m->count[face] = m->Nindex-m->first[face];
+	}
+	spheremesh_upload(m);
+	
+	builtview = view;
+	built = 1;
+	return 1;
+}
@@ -0,0 +1,39 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+*****************************************************************************/
+
+#import "CMBview.h"
+
+//the sphere is drawn as a cube-sphere: each texture cube face is a quadtree
+//of square patches of LOD_GRID x LOD_GRID cells, projected onto the sphere.
+//Patches are split where they look biggest on screen until there are
+//LOD_PATCHES of them, so the triangle count is the same at any zoom.
+#define LOD_GRID 8
+#define LOD_PATCHES 256
+#define LOD_MAXLEVEL 16
+
+//allocate the mesh arrays; needs the main view's context current
+void lodmesh_init(spheremesh *m);
+
+//rebuild the mesh for the observer, unless it is already built for this
+//view. Needs observer_setup and o->aspect_ratio, and for orthographic
+//views o->frustum_height. Returns 1 if the mesh was rebuilt.
+int lodmesh_update(spheremesh *m, const Observer *o, float fovy, int ortho);
@@ -0,0 +1,305 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+* Texel -> HEALPix pixel lookup tables for the texture cube. The tables for  *
+* the (Ntexture, nside, ordering) used most recently are kept in memory, up  *
+* to a budget, and optionally in cache files which are mapped straight back  *
+* in next time.                                                              *
+*                                                                            *
+*****************************************************************************/
+
+#import <string.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import "CMBpixtable.h"
+#import "chealpix.h"
+#import "lrucache.h"
+
+#define PIXTABLE_MAGIC "CMBPIXT1"
+#define PIXTABLE_BYTEORDER 0x01020304
+
+//cache file header, padded so the table itself starts 64-byte aligned
+typedef struct
+{
+	char magic[8];
+	uint32_t byteorder;
+	int32_t Ntexture, nside, ordering;
+	float overhang;
+	int32_t width;
+	char pad[32];
+} pixtable_header;
+
+static void release_table(int slot);
+
+static pixtable tables[PIXTABLE_SLOTS];
+static lrucache cache = {PIXTABLE_SLOTS, PIXTABLE_BUDGET, release_table};
+static char *cachedir = NULL;
+
+
+//bytes per table entry
+static size_t pixtable_width(const pixtable *t)
+{
+	return t->nside<=PIXTABLE_NSIDE32 ? sizeof(uint32_t) : sizeof(uint64_t);
+}
+
+
+/**********************************************************************/
+/*                          table generation                          */
+/**********************************************************************/
+
+//one task per texel row
+static void build_row(void *arg, long task, int worker)
+{
+	pixtable *t = (pixtable *)arg;
+	int face, a, b;
+	double vec[3];
+	hpint64 pixnum;
+	size_t row;
+
+	face = (int)(task / t->Ntexture);
+	a = (int)(task % t->Ntexture);
+	row = (size_t)task*t->Ntexture;
+
+	//straight from the texel direction to the pixel, with no angles in between
+	for (b=0; b<t->Ntexture; b++)
+	{
+		cubetexel_to_vector( t->Ntexture, a, b, face, vec );
+		if (t->ordering==0)
+		{
+			heal_vec2pix_ring(t->nside,vec,&pixnum);
+		}
+		else
+		{
+			heal_vec2pix_nest(t->nside,vec,&pixnum);
+		}
+		if (t->pix)
+		{
+			t->pix[row+b] = (uint32_t)pixnum;
+		}
+		else
+		{
+			t->pix64[row+b] = (uint64_t)pixnum;
+		}
+	}
+}
+
+//returns 0 if there is no memory for the table
+static int build_table(pixtable *t, threadpool_monitor monitor, void *monitor_arg)
+{
+	t->pix = NULL;
+	t->pix64 = NULL;
+	if (t->nside<=PIXTABLE_NSIDE32)
+	{
+		t->pix = (uint32_t *)malloc(t->ntexels*sizeof(uint32_t));
+	}
+	else
+	{
+		t->pix64 = (uint64_t *)malloc(t->ntexels*sizeof(uint64_t));
+	}
+	if (!t->pix && !t->pix64) return 0;
+	t->mapping = NULL;
+	t->mapsize = 0;
+
+	threadpool_run(build_row,t,6L*t->Ntexture,monitor,monitor_arg);
+	return 1;
+}
+
+
+/**********************************************************************/
+/*                            disk cache                              */
+/**********************************************************************/
+
+static void cache_filename(char *name, size_t len, const pixtable *t)
+{
+	snprintf(name,len,"%s/pixtable_%d_%d_%s.bin",cachedir,
+			 t->Ntexture,t->nside,t->ordering==0 ? "ring" : "nest");
+}
+
+static int cache_header_ok(const pixtable_header *h, const pixtable *t)
+{
+	return memcmp(h->magic,PIXTABLE_MAGIC,8)==0 &&
+		   h->byteorder==PIXTABLE_BYTEORDER &&
+		   h->Ntexture==t->Ntexture && h->nside==t->nside &&
+		   h->ordering==t->ordering && h->overhang==(float)flange &&
+		   h->width==(int32_t)pixtable_width(t);
+}
+
+//map a cached table file, returning 1 on success
+static int cache_read(pixtable *t)
+{
+	char name[1024];
+	struct stat sb;
+	void *map;
+	size_t size;
+	FILE *fp;
+
+	if (!cachedir) return 0;
+	cache_filename(name,sizeof(name),t);
+
+	fp = fopen(name,"rb");
+	if (!fp) return 0;
+
+	size = sizeof(pixtable_header) + t->ntexels*pixtable_width(t);
+	if (fstat(fileno(fp),&sb)!=0 || (size_t)sb.st_size!=size)
+	{
+		fclose(fp);
+		return 0;
+	}
+
+	map = mmap(NULL,size,PROT_READ,MAP_SHARED,fileno(fp),0);
+	fclose(fp);
+	if (map==MAP_FAILED) return 0;
+
+	if (!cache_header_ok((pixtable_header *)map,t))
+	{
+		munmap(map,size);
+		return 0;
+	}
+
+	t->mapping = map;
+	t->mapsize = size;
+	if (t->nside<=PIXTABLE_NSIDE32)
+	{
+		t->pix = (uint32_t *)((char *)map + sizeof(pixtable_header));
+	}
+	else
+	{
+		t->pix64 = (uint64_t *)((char *)map + sizeof(pixtable_header));
+	}
+	return 1;
+}
+
+//write the table out through a temporary file, so a half-written cache
+//file is never picked up
+static void cache_write(const pixtable *t)
+{
+	char name[1024], tmpname[1032];
+	pixtable_header h;
+	size_t bytes;
+	FILE *fp;
+
+	if (!cachedir) return;
+	mkdir(cachedir,0755);
+	cache_filename(name,sizeof(name),t);
+	snprintf(tmpname,sizeof(tmpname),"%s.tmp",name);
+
+	memset(&h,0,sizeof(h));
+	memcpy(h.magic,PIXTABLE_MAGIC,8);
+	h.byteorder = PIXTABLE_BYTEORDER;
+	h.Ntexture = t->Ntexture;
+	h.nside = t->nside;
+	h.ordering = t->ordering;
+	h.overhang = (float)flange;
+	h.width = (int32_t)pixtable_width(t);
+
+	fp = fopen(tmpname,"wb");
+	if (!fp) return;
+	bytes = fwrite(&h,sizeof(h),1,fp);
+	if (t->pix)
+	{
+		bytes += fwrite(t->pix,sizeof(uint32_t),t->ntexels,fp);
+	}
+	else
+	{
+		bytes += fwrite(t->pix64,sizeof(uint64_t),t->ntexels,fp);
+	}
+	if (fclose(fp)!=0 || bytes!=1+t->ntexels || rename(tmpname,name)!=0)
+	{
+		fprintf(stderr,"warning: could not write pixel table cache %s\n",name);
+		remove(tmpname);
+	}
+}
+
+
+/**********************************************************************/
+/*                            interface                               */
+/**********************************************************************/
+
+//directory for cache files, or NULL to keep tables in memory only
+void pixtable_set_cachedir(const char *dir)
+{
+	if (cachedir) free(cachedir);
+	cachedir = dir ? strdup(dir) : NULL;
+}
+
+static void release_table(int slot)
+{
+	pixtable *t = &tables[slot];
+
+	if (t->mapping)
+	{
+		munmap(t->mapping,t->mapsize);
+	}
+	else
+	{
+		if (t->pix) free(t->pix);
+		if (t->pix64) free(t->pix64);
+	}
+	memset(t,0,sizeof(pixtable));
+}
+
+static int same_table(int slot, const void *key)
+{
+	const pixtable *a = &tables[slot], *b = (const pixtable *)key;
+
+	return a->Ntexture==b->Ntexture && a->nside==b->nside && a->ordering==b->ordering;
+}
+
+//drops every table held in memory
+void pixtable_free(void)
+{
+	lru_flush(&cache);
+}
+
+/*
+   return the lookup table for this texture size and map resolution, building
+   it only if it is not already in memory or in the cache directory. Returns
+   NULL if there is no memory for it. The table stays valid until the next
+   call, which may release it to make room
+*/
+const pixtable *pixtable_get(int Ntexture, int nside, int ordering,
+							 threadpool_monitor monitor, void *monitor_arg)
+{
+	pixtable key, *t;
+	int k;
+
+	memset(&key,0,sizeof(key));
+	key.Ntexture = Ntexture;
+	key.nside = nside;
+	key.ordering = (ordering!=0);
+	key.ntexels = 6*(size_t)Ntexture*(size_t)Ntexture;
+
+	k = lru_lookup(&cache,same_table,&key);
+	if (k>=0) return &tables[k];
+
+	k = lru_add(&cache,key.ntexels*pixtable_width(&key));
+	t = &tables[k];
+	*t = key;
+	if (!cache_read(t))
+	{
+		if (!build_table(t,monitor,monitor_arg))
+		{
+			lru_evict(&cache,k);
+			return NULL;
+		}
+		cache_write(t);
+	}
+	return t;
+}
@@ -0,0 +1,51 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+*****************************************************************************/
+
+#import <stdint.h>
+#import "CMBview.h"
+#import "threadpool.h"
+
+//HEALPix pixel index of every texel center on the texture cube, stored
+//face by face and row by row: pix[(face*Ntexture + a)*Ntexture + b].
+//The indices are held in pix while they all fit in 32 bits (nside up to
+//PIXTABLE_NSIDE32), and in pix64 above that; the other pointer is NULL
+#define PIXTABLE_NSIDE32 16384
+
+typedef struct
+{
+	int Ntexture, nside, ordering;
+	size_t ntexels;
+	uint32_t *pix;
+	uint64_t *pix64;
+	void *mapping;
+	size_t mapsize;
+} pixtable;
+
+//most tables held at once, and the bytes they may take; the table last
+//asked for is kept whatever its size
+#define PIXTABLE_SLOTS 4
+#define PIXTABLE_BUDGET ((size_t)256<<20)
+
+void pixtable_set_cachedir(const char *dir);
+const pixtable *pixtable_get(int Ntexture, int nside, int ordering,
+							 threadpool_monitor monitor, void *monitor_arg);
+void pixtable_free(void);
@@ -0,0 +1,233 @@
+/*****************************************************************************
+* Copyright 2005 Jamie Portsmouth <jamports@mac.com>                         *
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+*                                                                            *
+* Observer setup and ray tracing onto the sphere. The render and export      *
+* textures, the Stokes grid and cmbview-render all project through here.     *
+*                                                                            *
+*****************************************************************************/
+
+#import "CMBproject.h"
+
+#define PI M_PI
+
+//squares in float precision and returns a double, exactly like SQR in
+//CMBview.h, but without its static temporary so threads can share it
+static double fsqr(float a)
+{
+	return a*a;
+}
+
+
+/**********************************************************************/
+/*                          math routines                             */
+/**********************************************************************/
+
+inline float scalarprod(float v1[3], float v2[3])
+{
+	return v1[0]*v2[0] + v1[1]*v2[1] + v1[2]*v2[2];
+}
+
+inline void normalize(float v[3])
+{
+	float d = (float)sqrtf( v[0]*v[0] + v[1]*v[1] + v[2]*v[2] );
+	if (d==0.0f)
+	{
+		printf("ERROR: attempted to normalize a null vector\n");
+		exit(EXIT_FAILURE);
+	}
+
+	v[0] /= d;
+	v[1] /= d;
+	v[2] /= d;
+}
+
+inline void normalize_double(double v[3])
+{
+	double d = sqrt( v[0]*v[0] + v[1]*v[1] + v[2]*v[2] );
+	if (d==0.0)
+	{
+		printf("ERROR: attempted to normalize a null vector\n");
+		exit(EXIT_FAILURE);
+	}
+
+	v[0] /= d;
+	v[1] /= d;
+	v[2] /= d;
+}
+
+inline void normcrossprod(float v1[3], float v2[3], float out[3])
+{
+	out[0] = v1[1]*v2[2] - v1[2]*v2[1];
+	out[1] = v1[2]*v2[0] - v1[0]*v2[2];
+	out[2] = v1[0]*v2[1] - v1[1]*v2[0];
+	normalize(out);
+}
+
+
+/**********************************************************************/
+/*                           observer                                 */
+/**********************************************************************/
+
+void observer_setup(Observer *o, float viewTheta, float viewPhi, float zoom,
+					float fovy, int ortho, float minApproach, float *maxZoom)
+{
+	int a;
+	float viewTheta_rad,viewPhi_rad,zoomfactor,furthest;
+
+	viewTheta_rad = PI*(viewTheta/180.0);
+	viewPhi_rad = 2.0*PI*(viewPhi/360.0);
+	o->view_direction[0] = -cos(viewPhi_rad)*sin(viewTheta_rad);
+	o->view_direction[1] = -sin(viewPhi_rad)*sin(viewTheta_rad);
+	o->view_direction[2] = -cos(viewTheta_rad);
+
+	o->localy[0] = -cos(viewTheta_rad)*cos(viewPhi_rad);
+	o->localy[1] = -cos(viewTheta_rad)*sin(viewPhi_rad);
+	o->localy[2] = sin(viewTheta_rad);
+	o->localx[0] = -sin(viewPhi_rad);
+	o->localx[1] = cos(viewPhi_rad);
+	o->localx[2] = 0.0;
+
+	if (!ortho)
+	{
+		furthest = 3.0/(float)tan((double)0.5*fovy*PI/180.0);
+		zoomfactor = 2.0*(furthest-1.0-minApproach)/(zoom+1.0)+2.0-furthest+2.0*minApproach;
+		o->eyedistance_perspective = radius*zoomfactor;
+		for (a=0;a<3;a++)
+		{
+			o->view_point[a] = o->eyedistance_perspective*(-o->view_direction[a]);
+		}
+		if (maxZoom) *maxZoom = furthest;
+	}
+	else
+	{
+		o->eyedistance_ortho = radius*(1.0+minApproach+5.0*(1.0-zoom));
+		for (a=0;a<3;a++)
+		{
+			o->view_point[a] = o->eyedistance_ortho*(-o->view_direction[a]);
+		}
+	}
+}
+
+void observer_frustum(Observer *o, float fovy, int ortho)
+{
+	if (ortho)
+	{
+		o->frustum_height = (o->eyedistance_ortho-radius);
+	}
+	else
+	{
+		o->frustum_height = 2.0*o->near*(float)tan((double)PI*fovy/360.0);
+	}
+	o->frustum_width = o->aspect_ratio*o->frustum_height;
+}
+
+int observer_cap_visible(const Observer *o, float fovy, int ortho, const double c[3], double r)
+{
+	double d[3], toeye[3], eyedistance, horizon, rho, x, y, z, tanv, tanh;
+	int a;
+	
+	//behind the horizon
+	eyedistance = 0.0;
+	for (a=0;a<3;a++) 
+	{
+		toeye[a] = -o->view_direction[a];
+		eyedistance += (double)o->view_point[a]*o->view_point[a];
+	}
+	eyedistance = sqrt(eyedistance);
+	horizon = (ortho || eyedistance<=radius) ? 0.5*PI : acos(radius/eyedistance);
+	if (acos(fmin(fmax(c[0]*toeye[0]+c[1]*toeye[1]+c[2]*toeye[2],-1.0),1.0))-r >= horizon) return 0;
+	
+	//outside the view, tested with the ball of radius rho about the cap
+	//centre (which holds the cap) against the sides of the frustum
+	rho = radius*2.0*sin(0.5*fmin(r,PI));
+	for (a=0;a<3;a++) d[a] = radius*c[a]-o->view_point[a];
+	x = d[0]*o->localx[0]+d[1]*o->localx[1]+d[2]*o->localx[2];
+	y = d[0]*o->localy[0]+d[1]*o->localy[1]+d[2]*o->localy[2];
+	if (ortho)
+	{
+		return fabs(x) < 0.5*o->frustum_height*o->aspect_ratio+rho &&
+			   fabs(y) < 0.5*o->frustum_height+rho;
+	}
+	z = d[0]*o->view_direction[0]+d[1]*o->view_direction[1]+d[2]*o->view_direction[2];
+	tanv = tan(0.5*fovy*PI/180.0);
+	tanh = o->aspect_ratio*tanv;
+	return tanh*z-fabs(x) > -rho*sqrt(1.0+tanh*tanh) &&
+		   tanv*z-fabs(y) > -rho*sqrt(1.0+tanv*tanv);
+}
+
+
+/**********************************************************************/
+/*                          ray tracing                               */
+/**********************************************************************/
+
+int observer_ray(const Observer *o, int ortho, double x, double y, double ray[3])
+{
+	double scalar_llp,lprime[3],orthox0[3],wx,wy,raylength,J;
+	int i;
+
+	//where the ray crosses the near plane, in world coords
+	wx = 0.5*o->frustum_width*(2.0*x-1.0);
+	wy = 0.5*o->frustum_height*(2.0*y-1.0);
+
+	//project through perspective view frustum
+	if (!ortho)
+	{
+		//lprime is vector directed from observer through selected point on sphere
+		for (i=0;i<3;i++)
+		{
+			lprime[i] = o->near*o->view_direction[i] + wx*o->localx[i] + wy*o->localy[i];
+		}
+		normalize_double(lprime);
+
+		scalar_llp = o->view_direction[0]*lprime[0]
+				   + o->view_direction[1]*lprime[1]
+				   + o->view_direction[2]*lprime[2];
+
+		J = fsqr(scalar_llp)-(1.0-fsqr(radius/o->eyedistance_perspective));
+		if (J<0.0) return 0;
+
+		raylength = o->eyedistance_perspective*(scalar_llp-sqrt(J));
+		for (i=0;i<3;i++)
+		{
+			ray[i] = o->view_point[i] + raylength*lprime[i];
+		}
+	}
+	//project through orthographic view cuboid
+	else
+	{
+		J = fsqr(radius)-fsqr(wx)-fsqr(wy);
+		if (J<0.0) return 0;
+
+		//orthox0[] is position of point on cuboid face where ray starts
+		for (i=0;i<3;i++)
+		{
+			orthox0[i] = o->view_point[i] + wx*o->localx[i] + wy*o->localy[i];
+		}
+		raylength = o->eyedistance_ortho-sqrt(J);
+		for (i=0;i<3;i++)
+		{
+			ray[i] = orthox0[i] + raylength*o->view_direction[i];
+		}
+	}
+	normalize_double(ray);
+	return 1;
+}
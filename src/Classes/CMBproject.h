@@ -0,0 +1,66 @@
+/*****************************************************************************
+* Copyright 2005 Jamie Portsmouth <jamports@mac.com>                         *
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+*                                                                            *
+* Observer and ray projection math, shared by the application and the        *
+* command line renderer. Nothing here depends on OpenGL or AppKit.           *
+*                                                                            *
+*****************************************************************************/
+
+#import <stdio.h>
+#import <stdlib.h>
+#import <math.h>
+
+#define radius 1.0
+
+//observer parameters
+typedef struct
+{
+	float aspect_ratio,near,far,frustum_width,frustum_height;
+	float view_width,view_height,axisspace;
+	float eyedistance, eyedistance_perspective, eyedistance_ortho;
+	float view_direction[3],view_point[3],localy[3],localx[3];
+} Observer;
+
+//math routines
+float scalarprod(float v1[3], float v2[3]);
+void normalize(float v[3]);
+void normalize_double(double v[3]);
+void normcrossprod(float v1[3], float v2[3], float out[3]);
+
+//place the observer looking at the sphere center from the direction
+//(viewTheta,viewPhi) in degrees. zoom runs from 0 (furthest) to 1 (closest).
+//In perspective mode *maxZoom is set to the furthest eye distance for fovy.
+void observer_setup(Observer *o, float viewTheta, float viewPhi, float zoom,
+					float fovy, int ortho, float minApproach, float *maxZoom);
+
+//size the view frustum for ray tracing; needs observer_setup, o->near and
+//o->aspect_ratio
+void observer_frustum(Observer *o, float fovy, int ortho);
+
+//whether any of the cap of angular radius r about the unit vector c can be
+//seen (conservatively: a few caps just outside the view also pass). Needs
+//observer_frustum for orthographic views.
+int observer_cap_visible(const Observer *o, float fovy, int ortho, const double c[3], double r);
+
+//unit vector to where the ray through the view point (x,y), both in [0,1]
+//from the bottom left, meets the sphere. Returns 0 if the ray misses.
+int observer_ray(const Observer *o, int ortho, double x, double y, double ray[3]);
@@ -0,0 +1,256 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+* Multi-resolution HEALPix maps. Each level of the pyramid is the map        *
+* degraded by a further factor of two in nside, built once at load from the  *
+* level above: the four NEST children of a pixel are adjacent there (for a   *
+* RING map they are found through xyf2ring at the first level only). The     *
+* fine levels of a cut sky map are kept sparse like the map itself.          *
+*                                                                            *
+*****************************************************************************/
+
+#import <string.h>
+#import <stdint.h>
+#import "CMBpyramid.h"
+
+//coarse pixels per pool task
+#define PYRAMID_BLOCK 4096
+
+typedef struct
+{
+	const hpic_float *from;
+	hpic_float *to;
+} pyramidjob;
+
+
+//the bits of v in the even positions, squeezed together (the x or, from
+//v>>1, the y coordinate of a NEST pixel within its base face)
+static size_t compact_bits(uint64_t v)
+{
+	v &= 0x5555555555555555ULL;
+	v = (v | (v>>1)) & 0x3333333333333333ULL;
+	v = (v | (v>>2)) & 0x0f0f0f0f0f0f0f0fULL;
+	v = (v | (v>>4)) & 0x00ff00ff00ff00ffULL;
+	v = (v | (v>>8)) & 0x0000ffff0000ffffULL;
+	v = (v | (v>>16)) & 0x00000000ffffffffULL;
+	return (size_t)v;
+}
+
+static void degrade_block(void *arg, long task, int worker)
+{
+	pyramidjob *job = (pyramidjob *)arg;
+	const float *in = job->from->data;
+	float *out = job->to->data;
+	size_t nside = job->to->nside, npface = nside*nside;
+	size_t pix, last, child, local, face = 0, x = 0, y = 0;
+	double sum;
+	float v;
+	int count, k;
+
+	pix = (size_t)task*PYRAMID_BLOCK;
+	last = pix+PYRAMID_BLOCK < job->to->npix ? pix+PYRAMID_BLOCK : job->to->npix;
+	for (; pix<last; pix++)
+	{
+		if (job->from->order!=HPIC_NEST)
+		{
+			face = pix/npface;
+			local = pix%npface;
+			x = 2*compact_bits(local);
+			y = 2*compact_bits(local>>1);
+		}
+		sum = 0.0;
+		count = 0;
+		for (k=0; k<4; k++)
+		{
+			if (job->from->order==HPIC_NEST) child = 4*pix+k;
+			else hpic_xyf2ring(2*nside,x+(k&1),y+(k>>1),face,&child);
+			v = in[child];
+			if (hpic_is_fnull(v)) continue;
+			sum += v;
+			count++;
+		}
+		out[pix] = count ? (float)(sum/count) : (float)HPIC_NULL;
+	}
+}
+
+//levels first..n of p, n being the level of nside 1, in one block of
+//memory. Returns n, or 0 if there are no such levels or no memory for them
+static int alloc_levels(mappyramid *p, int first)
+{
+	size_t nside = p->map->nside, total, offset;
+	int k, n;
+
+	for (n=0; (nside>>n)>1 && n<PYRAMID_MAXLEVELS; n++);
+	if (first>n) return 0;
+	for (k=first, total=0; k<=n; k++)
+	{
+		total += 12*(nside>>k)*(nside>>k);
+	}
+	p->data = (float *)malloc(total*sizeof(float));
+	if (!p->data)
+	{
+		fprintf(stderr,"WARNING: no memory for the map pyramid, using the map alone\n");
+		return 0;
+	}
+
+	for (k=first, offset=0; k<=n; k++)
+	{
+		p->level[k].nside = nside>>k;
+		p->level[k].npix = 12*p->level[k].nside*p->level[k].nside;
+		p->level[k].order = HPIC_NEST;
+		p->level[k].coord = p->map->coord;
+		p->level[k].mem = HPIC_STND;
+		p->level[k].data = p->data+offset;
+		offset += p->level[k].npix;
+	}
+	return n;
+}
+
+//make levels first+1..n, each from the one above, on the thread pool
+static void degrade_levels(mappyramid *p, int first, int n,
+						   threadpool_monitor monitor, void *monitor_arg)
+{
+	pyramidjob job;
+	int k;
+
+	for (k=first+1; k<=n; k++)
+	{
+		job.from = k==1 ? p->map : &p->level[k-1];
+		job.to = &p->level[k];
+		threadpool_run(degrade_block,&job,
+					   (long)((job.to->npix+PYRAMID_BLOCK-1)/PYRAMID_BLOCK),monitor,monitor_arg);
+	}
+}
+
+//degrade map (a full sky map with power of two nside) into the levels of
+//p, on the thread pool. If it can't be degraded, or there is no memory for
+//the levels, p has the map alone
+void pyramid_build(mappyramid *p, hpic_float *map,
+				   threadpool_monitor monitor, void *monitor_arg)
+{
+	size_t nside;
+	int n;
+
+	memset(p,0,sizeof(mappyramid));
+	p->map = map;
+	p->nlevels = 1;
+	if (!map || !map->data) return;
+	nside = map->nside;
+	if (map->npix != 12*nside*nside || (nside&(nside-1))) return;
+
+	n = alloc_levels(p,1);
+	if (!n) return;
+	degrade_levels(p,0,n,monitor,monitor_arg);
+	p->nlevels = n+1;
+}
+
+//the pyramid of column col of a cut sky map; map gives its nside, ordering
+//and coordinates. Levels are degraded sparsely until one has no more
+//pixels than the cut sky map, which is spread into a full sky level; the
+//coarser levels are degraded from that as usual
+void pyramid_build_sparse(mappyramid *p, hpic_float *map, const sparsemap *sparse, int col,
+						  threadpool_monitor monitor, void *monitor_arg)
+{
+	const sparsemap *from;
+	sparsemap *to;
+	hpic_float *level;
+	size_t nside, i;
+	int first, n;
+
+	memset(p,0,sizeof(mappyramid));
+	p->map = map;
+	p->sparse = sparse;
+	p->col = col;
+	p->nlevels = 1;
+	if (!map || !sparse) return;
+	nside = sparse->nside;
+	if (nside<2 || (nside&(nside-1))) return;
+
+	for (first=1; ; first++)
+	{
+		from = first==1 ? sparse : &p->sparselevel[first-1];
+		to = &p->sparselevel[first];
+		if (!sparse_degrade(from,first==1 ? col : 0,to))
+		{
+			fprintf(stderr,"WARNING: no memory for the map pyramid, using the levels made\n");
+			p->nlevels = first;
+			return;
+		}
+		if ((nside>>first)==1 || 12*(nside>>first)*(nside>>first) <= sparse->n) break;
+	}
+
+	n = alloc_levels(p,first);
+	if (!n)
+	{
+		p->nlevels = first+1;
+		return;
+	}
+	level = &p->level[first];
+	to = &p->sparselevel[first];
+	for (i=0; i<level->npix; i++) level->data[i] = (float)HPIC_NULL;
+	for (i=0; i<to->n; i++) level->data[to->pix[i]] = to->values[0][i];
+	sparse_free(to);
+
+	degrade_levels(p,first,n,monitor,monitor_arg);
+	p->nlevels = n+1;
+}
+
+void pyramid_free(mappyramid *p)
+{
+	int k;
+
+	if (p->data) free(p->data);
+	for (k=1; k<=PYRAMID_MAXLEVELS; k++) sparse_free(&p->sparselevel[k]);
+	memset(p,0,sizeof(mappyramid));
+}
+
+int pyramid_source(mappyramid *p, int nside, mapsource *src)
+{
+	int k;
+
+	for (k=p->nlevels-1; k>0; k--)
+	{
+		if ((int)(p->map->nside>>k) < nside) continue;
+		if (p->level[k].data) return map_source(&p->level[k],src);
+		sparse_source(&p->sparselevel[k],0,src);
+		return 1;
+	}
+	if (p->sparse)
+	{
+		sparse_source(p->sparse,p->col,src);
+		return 1;
+	}
+	return map_source(p->map,src);
+}
+
+float pyramid_get(mappyramid *p, size_t pix)
+{
+	if (p->sparse) return sparse_get(p->sparse,p->col,pix);
+	if (!p->map || !p->map->data || pix>=p->map->npix) return (float)HPIC_NULL;
+	return p->map->data[pix];
+}
+
+//the coarsest nside, down from nside by factors of two, whose pixels are
+//no bigger than spacing (in radians): the level to sample at that spacing
+int pyramid_nside(double spacing, int nside)
+{
+	while (nside>1 && sqrt(M_PI/3.0)/(0.5*nside) <= spacing) nside /= 2;
+	return nside;
+}
@@ -0,0 +1,62 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+*****************************************************************************/
+
+#import "hpic.h"
+#import "threadpool.h"
+#import "CMBsparse.h"
+
+//most levels below the map itself (nside 2^29 down to 1)
+#define PYRAMID_MAXLEVELS 29
+
+//a map and its successive degradings to nside/2, nside/4, ... 1, each
+//pixel the average of its non-null children (null if they all are).
+//Level 0 is the map itself (map), in its own ordering and not owned here;
+//level[k] for k>0 is NEST ordered, with the pixels of all of them in one
+//block (data). For a cut sky map, level 0 is column col of sparse (map
+//has no pixels, only the nside and ordering), and the levels with more
+//pixels than sparse holds are cut sky maps too (sparselevel[k], NEST
+//ordered, the level[k] of which have no data)
+typedef struct
+{
+	hpic_float *map;
+	const sparsemap *sparse;
+	int col;
+	int nlevels;
+	hpic_float level[PYRAMID_MAXLEVELS+1];
+	sparsemap sparselevel[PYRAMID_MAXLEVELS+1];
+	float *data;
+} mappyramid;
+
+void pyramid_build(mappyramid *p, hpic_float *map,
+				   threadpool_monitor monitor, void *monitor_arg);
+void pyramid_build_sparse(mappyramid *p, hpic_float *map, const sparsemap *sparse, int col,
+						  threadpool_monitor monitor, void *monitor_arg);
+void pyramid_free(mappyramid *p);
+
+//set src to the coarsest level of p with at least the given nside. Returns
+//0 if p has no pixels to look at
+int pyramid_source(mappyramid *p, int nside, mapsource *src);
+
+//value of pixel pix of the map itself (level 0), HPIC_NULL if there is none
+float pyramid_get(mappyramid *p, size_t pix);
+
+int pyramid_nside(double spacing, int nside);
@@ -0,0 +1,320 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+*                                                                            *
+* Parallel ray tracing of the view. The view is cut into RENDER_TILE square  *
+* tiles which are handed to the thread pool; each worker keeps its own       *
+* statistics of the values, gathered from each tile while it is still in     *
+* cache, and these are merged once all the tiles are done.                   *
+*                                                                            *
+* Adaptive antialiasing traces the corners of each texel, a row at a time,   *
+* and subdivides only the texels whose corners disagree, so the cost over    *
+* a single ray per texel is in proportion to the pixel boundaries and limb   *
+* in view.                                                                   *
+*                                                                            *
+*****************************************************************************/
+
+#import "CMBrender.h"
+#import "chealpix.h"
+
+//running statistics for one worker, padded so workers do not share cache lines
+typedef struct
+{
+	valuestats stats;
+	char pad[64];
+} renderstats;
+
+typedef struct
+{
+	const Observer *obs;
+	int ortho, Nx, Ny, aa, ntiles_x, ntiles_y;
+	hpint64 nside;
+	void (*vec2pix)(const hpint64 nside, const double *vec, hpint64 *ipix);
+	const mapsource *src, *Q, *U;
+	float **data;
+	int **mask;
+	renderstats stats[THREADPOOL_MAXWORKERS];
+	prehist *pre;
+} renderjob;
+
+//a map to trace is checked once here instead of on every ray
+static int in_memory(const mapsource *map)
+{
+	return map && (map->data || map->sparse);
+}
+
+//sets *v to the map value of pixel pixnum, and returns 0 if the pixel is
+//null (in either of Q and U for P); src is the T, Q or U pixels, picked once
+//per job, and only P is computed
+static int pixel_value(const renderjob *job, hpint64 pixnum, float *v)
+{
+	float q, u;
+
+	if (job->src)
+	{
+		*v = source_value(job->src,pixnum);
+		return !hpic_is_fnull(*v);
+	}
+	q = source_value(job->Q,pixnum);
+	u = source_value(job->U,pixnum);
+	*v = (float)sqrt((double)q*q+u*u);
+	return !hpic_is_fnull(q) && !hpic_is_fnull(u);
+}
+
+//the pixel seen along the ray through view position (x,y), or -1 if the
+//ray misses the sphere
+static hpint64 trace_pixel(const renderjob *job, double x, double y)
+{
+	double ray[3];
+	hpint64 pixnum;
+
+	if (!observer_ray(job->obs,job->ortho,x,y,ray)) return -1;
+	job->vec2pix(job->nside,ray,&pixnum);
+	return pixnum;
+}
+
+//one ray through the centre of each texel
+static void trace_centres(const renderjob *job, int a0, int a1, int b0, int b1)
+{
+	int a, b;
+	double x, y;
+	hpint64 pixnum;
+
+	for (a=a0; a<a1; a++)
+	{
+		x = ((double)a+0.5)/(double)job->Nx;
+		for (b=b0; b<b1; b++)
+		{
+			y = ((double)b+0.5)/(double)job->Ny;
+			pixnum = trace_pixel(job,x,y);
+			if (pixnum<0)
+			{
+				job->mask[a][b] = 0;
+				continue;
+			}
+			pixel_value(job,pixnum,&job->data[a][b]);
+			job->mask[a][b] = 1;
+		}
+	}
+}
+
+//adds sample pixel pix, weighted by w, to *sum and *hits, unless the ray
+//missed the sphere or the pixel is null; *seen is set to any pixel on the
+//sphere
+static void add_sample(const renderjob *job, hpint64 pix, double w,
+					   double *sum, double *hits, hpint64 *seen)
+{
+	float v;
+
+	if (pix<0) return;
+	*seen = pix;
+	if (!pixel_value(job,pix,&v)) return;
+	*sum += w*v;
+	*hits += w;
+}
+
+/*
+   adds the samples of the cell at (x,y) of size (dx,dy), weighted by w,
+   to *sum and their non-null area to *hits. p holds the pixels seen at the
+   corners (x,y), (x+dx,y), (x,y+dy), (x+dx,y+dy). A cell whose corners
+   agree is taken to see that pixel throughout; otherwise it is quartered,
+   down to level aa, below which its corners are averaged.
+*/
+static void sample_cell(const renderjob *job, double x, double y, double dx, double dy,
+						const hpint64 p[4], int level, double w, double *sum, double *hits,
+						hpint64 *seen)
+{
+	hpint64 mid[5], q[4];
+	int k;
+
+	if (p[0]==p[1] && p[0]==p[2] && p[0]==p[3])
+	{
+		add_sample(job,p[0],w,sum,hits,seen);
+		return;
+	}
+
+	if (level==job->aa)
+	{
+		for (k=0; k<4; k++) add_sample(job,p[k],0.25*w,sum,hits,seen);
+		return;
+	}
+
+	//edge midpoints (bottom, left, right, top) and centre
+	dx *= 0.5;
+	dy *= 0.5;
+	mid[0] = trace_pixel(job,x+dx,y);
+	mid[1] = trace_pixel(job,x,y+dy);
+	mid[2] = trace_pixel(job,x+dx+dx,y+dy);
+	mid[3] = trace_pixel(job,x+dx,y+dy+dy);
+	mid[4] = trace_pixel(job,x+dx,y+dy);
+	w *= 0.25;
+	level++;
+
+	q[0] = p[0];   q[1] = mid[0]; q[2] = mid[1]; q[3] = mid[4];
+	sample_cell(job,x,y,dx,dy,q,level,w,sum,hits,seen);
+	q[0] = mid[0]; q[1] = p[1];   q[2] = mid[4]; q[3] = mid[2];
+	sample_cell(job,x+dx,y,dx,dy,q,level,w,sum,hits,seen);
+	q[0] = mid[1]; q[1] = mid[4]; q[2] = p[2];   q[3] = mid[3];
+	sample_cell(job,x,y+dy,dx,dy,q,level,w,sum,hits,seen);
+	q[0] = mid[4]; q[1] = mid[2]; q[2] = mid[3]; q[3] = p[3];
+	sample_cell(job,x+dx,y+dy,dx,dy,q,level,w,sum,hits,seen);
+}
+
+//rays through the texel corners, kept for two rows of texels at a time,
+//refined where the corners disagree. A texel that sees only null pixels
+//gets the value trace_centres would give it
+static void trace_adaptive(const renderjob *job, int a0, int a1, int b0, int b1)
+{
+	hpint64 row0[RENDER_TILE+1], row1[RENDER_TILE+1], *lo = row0, *hi = row1, *t;
+	hpint64 p[4], seen;
+	double dx = 1.0/(double)job->Nx, dy = 1.0/(double)job->Ny, sum, hits;
+	int a, b;
+
+	for (b=b0; b<=b1; b++) lo[b-b0] = trace_pixel(job,a0*dx,b*dy);
+
+	for (a=a0; a<a1; a++)
+	{
+		for (b=b0; b<=b1; b++) hi[b-b0] = trace_pixel(job,(a+1)*dx,b*dy);
+
+		for (b=b0; b<b1; b++)
+		{
+			p[0] = lo[b-b0];
+			p[1] = hi[b-b0];
+			p[2] = lo[b-b0+1];
+			p[3] = hi[b-b0+1];
+			sum = hits = 0.0;
+			seen = -1;
+			sample_cell(job,a*dx,b*dy,dx,dy,p,0,1.0,&sum,&hits,&seen);
+			if (hits>0.0)
+			{
+				job->data[a][b] = (float)(sum/hits);
+				job->mask[a][b] = 1;
+			}
+			else if (seen>=0)
+			{
+				pixel_value(job,seen,&job->data[a][b]);
+				job->mask[a][b] = 1;
+			}
+			else job->mask[a][b] = 0;
+		}
+
+		t = lo; lo = hi; hi = t;
+	}
+}
+
+static void trace_tile(void *arg, long task, int worker)
+{
+	renderjob *job = (renderjob *)arg;
+	renderstats *s = &job->stats[worker];
+	int a, a0, a1, b0, b1;
+
+	a0 = (int)(task / job->ntiles_y) * RENDER_TILE;
+	b0 = (int)(task % job->ntiles_y) * RENDER_TILE;
+	a1 = a0+RENDER_TILE < job->Nx ? a0+RENDER_TILE : job->Nx;
+	b1 = b0+RENDER_TILE < job->Ny ? b0+RENDER_TILE : job->Ny;
+
+	if (job->aa) trace_adaptive(job,a0,a1,b0,b1);
+	else trace_centres(job,a0,a1,b0,b1);
+
+	for (a=a0; a<a1; a++)
+	{
+		stats_block(job->data[a]+b0,job->mask[a]+b0,b1-b0,&s->stats,
+					job->pre ? &job->pre[worker] : NULL);
+	}
+}
+
+double render_spacing(const Observer *o, int ortho, int Nx, int Ny)
+{
+	double r0[3], r1[3], dot;
+
+	//(the view is always centred on the sphere)
+	if (!observer_ray(o,ortho,0.5,0.5,r0) ||
+		!observer_ray(o,ortho,0.5+1.0/(double)Nx,0.5,r1)) return M_PI;
+	dot = r0[0]*r1[0] + r0[1]*r1[1] + r0[2]*r1[2];
+	return acos(dot < 1.0 ? dot : 1.0);
+}
+
+long render_trace(const Observer *o, int ortho, int Nx, int Ny, int aa, int maptype,
+				  const mapsource *T, const mapsource *Q, const mapsource *U,
+				  float **data, int **mask, valuestats *stats, prehist *pre,
+				  threadpool_monitor monitor, void *monitor_arg)
+{
+	renderjob *job;
+	const mapsource *map;
+	int nworkers, w;
+
+	map = maptype==2 ? Q : (maptype==3 ? U : T);
+	if (maptype==4 ? !in_memory(Q) || !in_memory(U) : !in_memory(map)) return -1;
+
+	job = (renderjob *)calloc(1,sizeof(renderjob));
+	if (!job) return -1;
+	job->obs = o;
+	job->ortho = ortho;
+	job->Nx = Nx;
+	job->Ny = Ny;
+	job->aa = aa < 0 ? 0 : (aa > RENDER_AA_MAXLEVEL ? RENDER_AA_MAXLEVEL : aa);
+	job->ntiles_x = (Nx+RENDER_TILE-1) / RENDER_TILE;
+	job->ntiles_y = (Ny+RENDER_TILE-1) / RENDER_TILE;
+	job->data = data;
+	job->mask = mask;
+
+	//a fine histogram for each worker, over the caller's provisional range
+	nworkers = threadpool_nworkers();
+	if (pre)
+	{
+		job->pre = (prehist *)malloc(nworkers*sizeof(prehist));
+		if (!job->pre)
+		{
+			free(job);
+			return -1;
+		}
+		for (w=0; w<nworkers; w++)
+		{
+			prehist_clear(&job->pre[w],pre->lo,pre->hi);
+		}
+	}
+
+	if (maptype==4)
+	{
+		job->Q = Q;
+		job->U = U;
+		map = Q;
+	}
+	else
+	{
+		job->src = map;
+	}
+	job->nside = (hpint64)map->nside;
+	job->vec2pix = map->order==HPIC_RING ? heal_vec2pix_ring : heal_vec2pix_nest;
+
+	threadpool_run(trace_tile,job,(long)job->ntiles_x*job->ntiles_y,monitor,monitor_arg);
+
+	//merge the per-worker statistics
+	stats_clear(stats);
+	for (w=0; w<nworkers; w++)
+	{
+		stats_merge(stats,&job->stats[w].stats);
+		if (pre) prehist_merge(pre,&job->pre[w]);
+	}
+
+	if (pre) free(job->pre);
+	free(job);
+	return stats->count;
+}
@@ -0,0 +1,62 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+*                                                                            *
+* Parallel ray tracing of the view onto the sphere, for the render mode      *
+* texture, the image export and cmbview-render.                              *
+*                                                                            *
+*****************************************************************************/
+
+#import "hpic.h"
+#import "CMBproject.h"
+#import "threadpool.h"
+#import "CMBstats.h"
+#import "CMBsparse.h"
+
+//edge length (in rays) of the square tiles the view is cut into
+#define RENDER_TILE 64
+
+//deepest subdivision of a texel for adaptive antialiasing (8x8 cells)
+#define RENDER_AA_MAXLEVEL 3
+
+//angle on the sphere between the rays through the central texel of an Nx
+//by Ny view and its neighbour, the finest spacing of the texels
+double render_spacing(const Observer *o, int ortho, int Nx, int Ny);
+
+/*
+   trace the Nx by Ny texels of the view of observer o (already set up with
+   observer_frustum). With aa = 0 the ray through (x,y) = ((a+0.5)/Nx,
+   (b+0.5)/Ny) sets mask[a][b] to 1 and data[a][b] to the map value if it
+   hits the sphere, and mask[a][b] to 0 otherwise.
+   With aa > 0 rays are traced through the texel corners instead, and a
+   texel whose corners see different pixels (or straddle the limb) is split
+   into quarters, up to aa times; data[a][b] is the area weighted average
+   of the samples which hit, and mask[a][b] is 1 if any of them did.
+   maptype is 1,2,3,4 for T,Q,U,P as in AppController; the maps may be
+   full or cut sky, and Q and U may be NULL for a T map. stats gets the range and moments of the values hit, and if
+   pre is not NULL the values are also binned into it, over the provisional
+   range it was cleared with. Returns the number of texels hit, or -1 with
+   nothing traced if there is no memory for the trace or a map it needs is
+   not in memory.
+*/
+long render_trace(const Observer *o, int ortho, int Nx, int Ny, int aa, int maptype,
+				  const mapsource *T, const mapsource *Q, const mapsource *U,
+				  float **data, int **mask, valuestats *stats, prehist *pre,
+				  threadpool_monitor monitor, void *monitor_arg);
@@ -0,0 +1,108 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+* LRU cache of ray-traced render data. Each entry owns an arena holding      *
+* the traced values, mask, statistics and provisional histogram for one      *
+* view; the least recently used entries are released once the data held      *
+* exceeds the memory budget.                                                 *
+*                                                                            *
+*****************************************************************************/
+
+#import <string.h>
+#import "CMBrendercache.h"
+#import "lrucache.h"
+#import "memory.h"
+
+static void release_trace(int slot);
+
+static renderkey keys[RENDERCACHE_SLOTS];
+static rendertrace traces[RENDERCACHE_SLOTS];
+static memarena arenas[RENDERCACHE_SLOTS];
+static lrucache cache = {RENDERCACHE_SLOTS, 128*1024*1024, release_trace};
+
+static void release_trace(int slot)
+{
+	arena_release(&arenas[slot]);
+}
+
+static int same_key(int slot, const void *key)
+{
+	const renderkey *a = &keys[slot], *b = (const renderkey *)key;
+
+	return a->mapid==b->mapid && a->maptype==b->maptype &&
+		   a->width==b->width && a->height==b->height &&
+		   a->Ntex==b->Ntex && a->ortho==b->ortho && a->aa==b->aa && a->fovy==b->fovy &&
+		   !memcmp(&a->o,&b->o,sizeof(Observer));
+}
+
+//budget for the data held, in bytes
+void rendercache_set_budget(size_t bytes)
+{
+	lru_set_budget(&cache,bytes);
+}
+
+//fills t with the trace cached for key and returns 1, or else allocates a
+//new trace for key in t and returns 0, and the caller must then fill it.
+//Returns -1 if the memory can't be had
+int rendercache_get(const renderkey *key, rendertrace *t)
+{
+	rendertrace *r;
+	memarena *a;
+	int k;
+
+	k = lru_lookup(&cache,same_key,key);
+	if (k>=0)
+	{
+		*t = traces[k];
+		return 1;
+	}
+
+	k = lru_add(&cache,(size_t)key->Ntex*key->Ntex*(sizeof(float)+sizeof(int)) + sizeof(prehist));
+	r = &traces[k];
+	a = &arenas[k];
+	arena_init(a);
+	r->data = arena_matrix(a,key->Ntex,key->Ntex);
+	r->mask = arena_imatrix(a,key->Ntex,key->Ntex);
+	r->stats = (valuestats *)arena_alloc(a,sizeof(valuestats));
+	r->pre = (prehist *)arena_alloc(a,sizeof(prehist));
+	if (!r->data || !r->mask || !r->stats || !r->pre)
+	{
+		lru_evict(&cache,k);
+		return -1;
+	}
+	keys[k] = *key;
+	*t = *r;
+	return 0;
+}
+
+//drops the entry for key, for a trace that could not be filled in
+void rendercache_drop(const renderkey *key)
+{
+	int k;
+
+	k = lru_lookup(&cache,same_key,key);
+	if (k>=0) lru_evict(&cache,k);
+}
+
+//drops every entry, for when the map data itself changes
+void rendercache_flush(void)
+{
+	lru_flush(&cache);
+}
@@ -0,0 +1,54 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+*****************************************************************************/
+
+#import "CMBview.h"
+#import "CMBstats.h"
+
+//ray-traced render data, retained between views so that switching between
+//render and presentation mode, or returning to a view already traced,
+//needs only recoloring
+
+//everything the trace depends on; mapid changes whenever new map data is
+//loaded
+typedef struct
+{
+	int mapid, maptype, width, height, Ntex, ortho, aa;
+	float fovy;
+	Observer o;
+} renderkey;
+
+//the traced data for a key; all of it belongs to the cache
+typedef struct
+{
+	float **data;
+	int **mask;
+	valuestats *stats;
+	prehist *pre;
+} rendertrace;
+
+//most traces held at once, whatever the budget
+#define RENDERCACHE_SLOTS 8
+
+void rendercache_set_budget(size_t bytes);
+int rendercache_get(const renderkey *key, rendertrace *t);
+void rendercache_drop(const renderkey *key);
+void rendercache_flush(void);
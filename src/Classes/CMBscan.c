@@ -0,0 +1,228 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+* Parallel scan of the texture cube. Each face is cut into SCAN_TILE square  *
+* tiles which are handed to the thread pool; every worker keeps its own map  *
+* maxima, and these are merged once all the tiles are done. The texel ->     *
+* pixel mapping comes from a precomputed table, so a scan is just a gather.  *
+*                                                                            *
+*****************************************************************************/
+
+#import <string.h>
+#import "CMBscan.h"
+#import "CMBpixtable.h"
+
+//running maxima for one worker, padded so workers do not share cache lines
+typedef struct
+{
+	mapmaxima m;
+	int valid;
+	char pad[64];
+} scanstats;
+
+typedef struct
+{
+	int Ntexture, ntiles;
+	const pixtable *table;
+	const mapsource *T, *Q, *U;
+	float ***Tface, ***Qface, ***Uface, ***Pface;
+	scanstats stats[THREADPOOL_MAXWORKERS];
+} scanjob;
+
+//a map to scan is checked once here instead of on every texel
+static int in_memory(const mapsource *map)
+{
+	return map && (map->data || map->sparse);
+}
+
+//zero the faces and maxima of a scan which could not be made, so nothing
+//left over from an earlier map is drawn
+static void clear_faces(int Ntexture, float ***Tface, float ***Qface, float ***Uface,
+						float ***Pface, mapmaxima *maxima)
+{
+	size_t bytes = (size_t)Ntexture*Ntexture*sizeof(float);
+	int face;
+
+	for (face=0; face<6; face++)
+	{
+		memset(Tface[face][0],0,bytes);
+		if (!Qface) continue;
+		memset(Qface[face][0],0,bytes);
+		memset(Uface[face][0],0,bytes);
+		memset(Pface[face][0],0,bytes);
+	}
+	memset(maxima,0,sizeof(mapmaxima));
+}
+
+static void scan_tile(void *arg, long task, int worker)
+{
+	scanjob *job = (scanjob *)arg;
+	scanstats *s = &job->stats[worker];
+	int face, a, b, a0, a1, b0, b1, tile;
+	float T,Q,U,P;
+	mapmaxima m;
+	const uint32_t *pix;
+	const uint64_t *pix64;
+	size_t pixnum;
+
+	face = (int)(task / (job->ntiles*job->ntiles));
+	tile = (int)(task % (job->ntiles*job->ntiles));
+	a0 = (tile / job->ntiles) * SCAN_TILE;
+	b0 = (tile % job->ntiles) * SCAN_TILE;
+	a1 = a0+SCAN_TILE < job->Ntexture ? a0+SCAN_TILE : job->Ntexture;
+	b1 = b0+SCAN_TILE < job->Ntexture ? b0+SCAN_TILE : job->Ntexture;
+
+	for (a=a0; a<a1; a++)
+	{
+		//only one of the two is non-NULL, see CMBpixtable.h
+		pix = job->table->pix;
+		pix64 = job->table->pix64;
+		if (pix) pix += ((size_t)face*job->Ntexture + a)*job->Ntexture;
+		else pix64 += ((size_t)face*job->Ntexture + a)*job->Ntexture;
+		for (b=b0; b<b1; b++)
+		{
+			pixnum = pix ? (size_t)pix[b] : (size_t)pix64[b];
+			T = source_value(job->T,pixnum);
+			job->Tface[face][a][b] = T;
+
+			if (!job->Qface)
+			{
+				//update maxima and minima
+				if (a==a0 && b==b0)
+				{
+					m.minT = T; m.maxT = T;
+				}
+				else
+				{
+					if (T<m.minT) m.minT=T;
+					if (T>m.maxT) m.maxT=T;
+				}
+				continue;
+			}
+
+			Q = source_value(job->Q,pixnum);
+			U = source_value(job->U,pixnum);
+			P = (float)sqrt((double)Q*Q+U*U);
+
+			job->Qface[face][a][b] = Q;
+			job->Uface[face][a][b] = U;
+			job->Pface[face][a][b] = P;
+
+			//update maxima and minima
+			if (a==a0 && b==b0)
+			{
+				m.minT = T; m.maxT = T;
+				m.minQ = Q; m.maxQ = Q;
+				m.minU = U; m.maxU = U;
+				m.minP = P; m.maxP = P;
+			}
+			else
+			{
+				if (T<m.minT) m.minT=T; if (T>m.maxT) m.maxT=T;
+				if (Q<m.minQ) m.minQ=Q; if (Q>m.maxQ) m.maxQ=Q;
+				if (U<m.minU) m.minU=U; if (U>m.maxU) m.maxU=U;
+				if (P<m.minP) m.minP=P; if (P>m.maxP) m.maxP=P;
+			}
+		}
+	}
+
+	//fold this tile into the worker's running maxima
+	if (!s->valid)
+	{
+		s->m = m;
+		s->valid = 1;
+		return;
+	}
+	if (m.minT<s->m.minT) s->m.minT=m.minT; if (m.maxT>s->m.maxT) s->m.maxT=m.maxT;
+	if (!job->Qface) return;
+	if (m.minQ<s->m.minQ) s->m.minQ=m.minQ; if (m.maxQ>s->m.maxQ) s->m.maxQ=m.maxQ;
+	if (m.minU<s->m.minU) s->m.minU=m.minU; if (m.maxU>s->m.maxU) s->m.maxU=m.maxU;
+	if (m.minP<s->m.minP) s->m.minP=m.minP; if (m.maxP>s->m.maxP) s->m.maxP=m.maxP;
+}
+
+int scan_nside(int Ntexture, int nside)
+{
+	return pyramid_nside(sqrt(4.0*PI/6.0)/(double)Ntexture,nside);
+}
+
+int scan_cubemap(int Ntexture, const mapsource *T, const mapsource *Q, const mapsource *U,
+				 float ***Tface, float ***Qface, float ***Uface, float ***Pface,
+				 mapmaxima *maxima, threadpool_monitor monitor, void *monitor_arg)
+{
+	scanjob *job;
+	scanstats *s;
+	int w, first;
+
+	job = NULL;
+	if (in_memory(T) && (!Qface || (in_memory(Q) && in_memory(U))))
+	{
+		job = (scanjob *)calloc(1,sizeof(scanjob));
+	}
+	if (!job)
+	{
+		clear_faces(Ntexture,Tface,Qface,Uface,Pface,maxima);
+		return 0;
+	}
+	job->Ntexture = Ntexture;
+	job->ntiles = (Ntexture+SCAN_TILE-1) / SCAN_TILE;
+	job->Tface = Tface;
+	job->Qface = Qface;
+	job->Uface = Uface;
+	job->Pface = Pface;
+
+	job->T = T;
+	if (Qface)
+	{
+		job->Q = Q;
+		job->U = U;
+	}
+
+	//only building a new lookup table takes long enough to be worth reporting
+	job->table = pixtable_get(Ntexture,(int)T->nside,T->order,monitor,monitor_arg);
+	if (!job->table)
+	{
+		free(job);
+		clear_faces(Ntexture,Tface,Qface,Uface,Pface,maxima);
+		return 0;
+	}
+	threadpool_run(scan_tile,job,6L*job->ntiles*job->ntiles,NULL,NULL);
+
+	//merge the per-worker maxima
+	first = 1;
+	for (w=0; w<THREADPOOL_MAXWORKERS; w++)
+	{
+		s = &job->stats[w];
+		if (!s->valid) continue;
+		if (first)
+		{
+			*maxima = s->m;
+			first = 0;
+			continue;
+		}
+		if (s->m.minT<maxima->minT) maxima->minT=s->m.minT; if (s->m.maxT>maxima->maxT) maxima->maxT=s->m.maxT;
+		if (!Qface) continue;
+		if (s->m.minQ<maxima->minQ) maxima->minQ=s->m.minQ; if (s->m.maxQ>maxima->maxQ) maxima->maxQ=s->m.maxQ;
+		if (s->m.minU<maxima->minU) maxima->minU=s->m.minU; if (s->m.maxU>maxima->maxU) maxima->maxU=s->m.maxU;
+		if (s->m.minP<maxima->minP) maxima->minP=s->m.minP; if (s->m.maxP>maxima->maxP) maxima->maxP=s->m.maxP;
+	}
+
+	free(job);
+	return 1;
+}
@@ -0,0 +1,40 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+*****************************************************************************/
+
+#import "CMBview.h"
+#import "threadpool.h"
+#import "CMBsparse.h"
+
+//edge length (in texels) of the square tiles the cube faces are cut into
+#define SCAN_TILE 64
+
+//the nside to scan Ntexture face textures at: the pyramid level whose
+//pixels match the mean texel size
+int scan_nside(int Ntexture, int nside);
+
+//fill the cube-map face arrays from the maps T,Q,U (full or cut sky, of one
+//nside and ordering). If Qface is NULL only the T map is scanned, otherwise
+//T,Q,U and P. Returns 0, with the faces and maxima zeroed, if there is no
+//memory for the scan or its pixel table, or a map it needs is not in memory.
+int scan_cubemap(int Ntexture, const mapsource *T, const mapsource *Q, const mapsource *U,
+				 float ***Tface, float ***Qface, float ***Uface, float ***Pface,
+				 mapmaxima *maxima, threadpool_monitor monitor, void *monitor_arg);
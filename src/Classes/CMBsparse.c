@@ -0,0 +1,375 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+* Cut sky maps kept as the list of observed pixels rather than scattered     *
+* into full sky arrays, so the memory they take goes with the sky they       *
+* cover. The columns of the file are read as they lie (the hits and errors   *
+* columns are skipped), sorted if the pixels are not already in order, and   *
+* indexed in blocks of pixel numbers for lookup. Degrading one keeps it      *
+* sparse, in NEST order, for the fine levels of its pyramid.                 *
+*                                                                            *
+*****************************************************************************/
+
+#import <string.h>
+#import "fitsio.h"
+#import "CMBsparse.h"
+#import "threadpool.h"
+
+//smallest block of pixel numbers; the index has at most one block for
+//every SPARSE_PERBLOCK pixels held
+#define SPARSE_MINSHIFT 4
+#define SPARSE_PERBLOCK 4
+
+//pixels per pool task in sparse_degrade
+#define SPARSE_TASK 16384
+
+//a row of the file, for sorting
+typedef struct
+{
+	hpint64 pix;
+	size_t row;
+} sparserow;
+
+//a pixel of a map being degraded: its NEST number, and its value
+typedef struct
+{
+	uint64_t pix;
+	float value;
+} sparsepair;
+
+typedef struct
+{
+	const sparsemap *s;
+	int col;
+	sparsepair *pairs;
+} degradejob;
+
+//free what has been read, set the hpic error and fail
+static int read_failed(sparsemap *s, fitsfile *fp, int errcode, const char *msg)
+{
+	int ret = 0;
+
+	if (fp) fits_close_file(fp,&ret);
+	sparse_free(s);
+	hpic_error(errcode,__FILE__,__LINE__,msg);
+	return 0;
+}
+
+static int compare_rows(const void *a, const void *b)
+{
+	const sparserow *r = (const sparserow *)a, *q = (const sparserow *)b;
+
+	if (r->pix != q->pix) return r->pix < q->pix ? -1 : 1;
+	return r->row < q->row ? -1 : (r->row > q->row);
+}
+
+//put the rows in pixel order. A pixel in more than one row gets the last,
+//as when the rows are written into a full sky map one by one
+static int sort_rows(sparsemap *s)
+{
+	sparserow *rows;
+	float *values;
+	size_t i, n;
+	int c;
+
+	rows = (sparserow *)malloc(s->n*sizeof(sparserow));
+	if (!rows) return 0;
+	for (i=0; i<s->n; i++)
+	{
+		rows[i].pix = s->pix[i];
+		rows[i].row = i;
+	}
+	qsort(rows,s->n,sizeof(sparserow),compare_rows);
+	for (i=0, n=0; i<s->n; i++)
+	{
+		if (i+1<s->n && rows[i+1].pix==rows[i].pix) continue;
+		rows[n++] = rows[i];
+	}
+
+	for (c=0; c<s->ncols; c++)
+	{
+		values = (float *)malloc(n*sizeof(float));
+		if (!values)
+		{
+			free(rows);
+			return 0;
+		}
+		for (i=0; i<n; i++) values[i] = s->values[c][rows[i].row];
+		free(s->values[c]);
+		s->values[c] = values;
+	}
+	for (i=0; i<n; i++) s->pix[i] = rows[i].pix;
+	s->n = n;
+	free(rows);
+	return 1;
+}
+
+//the block index, with blocks small enough that there are about
+//SPARSE_PERBLOCK pixels held for every block
+static int build_index(sparsemap *s)
+{
+	size_t npix = 12*s->nside*s->nside, perblock = s->n/SPARSE_PERBLOCK, b, i;
+
+	if (perblock<1) perblock = 1;
+	s->shift = SPARSE_MINSHIFT;
+	while ((npix>>s->shift) > perblock) s->shift++;
+	s->nblocks = (npix+((size_t)1<<s->shift)-1)>>s->shift;
+	s->block = (size_t *)malloc((s->nblocks+1)*sizeof(size_t));
+	if (!s->block) return 0;
+	for (b=0, i=0; b<=s->nblocks; b++)
+	{
+		while (i<s->n && ((size_t)s->pix[i]>>s->shift) < b) i++;
+		s->block[b] = i;
+	}
+	return 1;
+}
+
+int sparse_read(sparsemap *s, const char *filename, size_t nside, int order, int ncols)
+{
+	fitsfile *fp = NULL;
+	int ret = 0, type, tfields, anynull, sorted, c;
+	long nrows;
+	float nullval = HPIC_NULL;
+	hpint64 pixnull = HPIC_INT_NULL;
+	size_t npix = 12*nside*nside, i;
+
+	memset(s,0,sizeof(sparsemap));
+	s->nside = nside;
+	s->order = order;
+	s->ncols = ncols;
+
+	if (fits_open_file(&fp,(char *)filename,READONLY,&ret) ||
+		fits_movabs_hdu(fp,2,&type,&ret) ||
+		fits_get_num_rows(fp,&nrows,&ret) ||
+		fits_get_num_cols(fp,&tfields,&ret))
+	{
+		return read_failed(s,fp,HPIC_ERR_FITS,"cannot open cut sky table");
+	}
+
+	s->n = (size_t)nrows;
+	s->pix = (hpint64 *)malloc((s->n+1)*sizeof(hpint64));
+	if (!s->pix) return read_failed(s,fp,HPIC_ERR_ALLOC,"cannot allocate cut sky map");
+	for (c=0; c<ncols; c++)
+	{
+		s->values[c] = (float *)malloc((s->n+1)*sizeof(float));
+		if (!s->values[c]) return read_failed(s,fp,HPIC_ERR_ALLOC,"cannot allocate cut sky map");
+	}
+
+	//the columns are the pixels, the maps, then the hits and the errors.
+	//Pixel numbers pass 2^31 from nside 16384, so they are read as 64-bit
+	if (fits_read_col(fp,TLONGLONG,1,1,1,nrows,&pixnull,s->pix,&anynull,&ret))
+	{
+		return read_failed(s,fp,HPIC_ERR_FITS,"cannot read cut sky pixels");
+	}
+	for (c=0; c<ncols; c++)
+	{
+		if (c+2 > tfields-2)
+		{
+			for (i=0; i<s->n; i++) s->values[c][i] = (float)HPIC_NULL;
+			continue;
+		}
+		if (fits_read_col(fp,TFLOAT,c+2,1,1,nrows,&nullval,s->values[c],&anynull,&ret))
+		{
+			return read_failed(s,fp,HPIC_ERR_FITS,"cannot read cut sky map");
+		}
+	}
+	fits_close_file(fp,&ret);
+	fp = NULL;
+
+	sorted = 1;
+	for (i=0; i<s->n; i++)
+	{
+		if (s->pix[i]<0 || (size_t)s->pix[i]>=npix)
+		{
+			return read_failed(s,NULL,HPIC_ERR_RANGE,"pixel in file is out of range");
+		}
+		if (i>0 && s->pix[i]<=s->pix[i-1]) sorted = 0;
+	}
+	if ((!sorted && !sort_rows(s)) || !build_index(s))
+	{
+		return read_failed(s,NULL,HPIC_ERR_ALLOC,"cannot allocate cut sky map");
+	}
+	return 1;
+}
+
+void sparse_free(sparsemap *s)
+{
+	int c;
+
+	if (s->pix) free(s->pix);
+	for (c=0; c<3; c++)
+	{
+		if (s->values[c]) free(s->values[c]);
+	}
+	if (s->block) free(s->block);
+	memset(s,0,sizeof(sparsemap));
+}
+
+//(the search halves the range without branching on the comparison, which
+//random pixels would mispredict at every step)
+float sparse_get(const sparsemap *s, int col, size_t pix)
+{
+	size_t b = pix>>s->shift, lo, n, half;
+
+	if (b>=s->nblocks) return (float)HPIC_NULL;
+	lo = s->block[b];
+	n = s->block[b+1]-lo;
+	if (!n) return (float)HPIC_NULL;
+	while (n>1)
+	{
+		half = n/2;
+		lo = (size_t)s->pix[lo+half] <= pix ? lo+half : lo;
+		n -= half;
+	}
+	if ((size_t)s->pix[lo]==pix) return s->values[col][lo];
+	return (float)HPIC_NULL;
+}
+
+//the NEST numbers and values of one column of the pixels
+static void pair_block(void *arg, long task, int worker)
+{
+	degradejob *job = (degradejob *)arg;
+	const sparsemap *s = job->s;
+	size_t i, last, nest;
+
+	i = (size_t)task*SPARSE_TASK;
+	last = i+SPARSE_TASK < s->n ? i+SPARSE_TASK : s->n;
+	for (; i<last; i++)
+	{
+		if (s->order==HPIC_NEST) nest = (size_t)s->pix[i];
+		else hpic_ring2nest(s->nside,(size_t)s->pix[i],&nest);
+		job->pairs[i].pix = (uint64_t)nest;
+		job->pairs[i].value = s->values[job->col][i];
+	}
+}
+
+//sort the pairs by pixel, a byte at a time from the lowest, over the bytes
+//a pixel of a map with npix pixels can have. *pairs may be swapped for
+//another block of memory
+static int sort_pairs(sparsepair **pairs, size_t n, size_t npix)
+{
+	sparsepair *from = *pairs, *to, *t;
+	size_t count[256], i, c, sum, k;
+	int shift, bits = 0;
+
+	while (bits<64 && ((uint64_t)(npix-1)>>bits)) bits++;
+	to = (sparsepair *)malloc((n+1)*sizeof(sparsepair));
+	if (!to) return 0;
+	for (shift=0; shift<bits; shift+=8)
+	{
+		memset(count,0,sizeof(count));
+		for (i=0; i<n; i++) count[(from[i].pix>>shift)&255]++;
+		for (c=0, sum=0; c<256; c++)
+		{
+			k = count[c];
+			count[c] = sum;
+			sum += k;
+		}
+		for (i=0; i<n; i++) to[count[(from[i].pix>>shift)&255]++] = from[i];
+		t = from;
+		from = to;
+		to = t;
+	}
+	free(to);
+	*pairs = from;
+	return 1;
+}
+
+int sparse_degrade(const sparsemap *s, int col, sparsemap *out)
+{
+	degradejob job;
+	sparsepair *pairs;
+	size_t i, j, n;
+	double sum;
+	int count;
+
+	memset(out,0,sizeof(sparsemap));
+	out->nside = s->nside/2;
+	out->order = HPIC_NEST;
+	out->ncols = 1;
+	if (!out->nside) return 0;
+
+	pairs = (sparsepair *)malloc((s->n+1)*sizeof(sparsepair));
+	if (!pairs) return 0;
+	job.s = s;
+	job.col = col;
+	job.pairs = pairs;
+	threadpool_run(pair_block,&job,(long)((s->n+SPARSE_TASK-1)/SPARSE_TASK),NULL,NULL);
+	if (s->order!=HPIC_NEST && !sort_pairs(&pairs,s->n,12*s->nside*s->nside))
+	{
+		free(pairs);
+		return 0;
+	}
+
+	for (i=0, n=0; i<s->n; i++)
+	{
+		if (!i || (pairs[i].pix>>2)!=(pairs[i-1].pix>>2)) n++;
+	}
+	out->pix = (hpint64 *)malloc((n+1)*sizeof(hpint64));
+	out->values[0] = (float *)malloc((n+1)*sizeof(float));
+	if (!out->pix || !out->values[0])
+	{
+		free(pairs);
+		sparse_free(out);
+		return 0;
+	}
+
+	//the children of a pixel are adjacent, in order, as in a full sky map
+	for (i=0; i<s->n; i=j)
+	{
+		sum = 0.0;
+		count = 0;
+		for (j=i; j<s->n && (pairs[j].pix>>2)==(pairs[i].pix>>2); j++)
+		{
+			if (hpic_is_fnull(pairs[j].value)) continue;
+			sum += pairs[j].value;
+			count++;
+		}
+		out->pix[out->n] = (hpint64)(pairs[i].pix>>2);
+		out->values[0][out->n] = count ? (float)(sum/count) : (float)HPIC_NULL;
+		out->n++;
+	}
+	free(pairs);
+	if (!build_index(out))
+	{
+		sparse_free(out);
+		return 0;
+	}
+	return 1;
+}
+
+int map_source(hpic_float *map, mapsource *src)
+{
+	memset(src,0,sizeof(mapsource));
+	if (!map || !map->data || map->npix != 12*map->nside*map->nside) return 0;
+	src->nside = map->nside;
+	src->order = map->order;
+	src->data = map->data;
+	return 1;
+}
+
+void sparse_source(const sparsemap *s, int col, mapsource *src)
+{
+	memset(src,0,sizeof(mapsource));
+	src->nside = s->nside;
+	src->order = s->order;
+	src->sparse = s;
+	src->col = col;
+}
@@ -0,0 +1,77 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+*****************************************************************************/
+
+#import "hpic.h"
+#import "chealpix.h"
+
+//a cut sky map held as its observed pixels alone: the pixel numbers in
+//increasing order, and a value for each in every column (T, Q, U). The
+//pixel numbers are cut into blocks of 2^shift, and block[b] is the index of
+//the first pixel at or after block b (block[nblocks] is n), so a lookup is
+//a binary search of one block.
+typedef struct
+{
+	size_t nside, n;
+	int order, ncols;
+	hpint64 *pix;
+	float *values[3];
+	int shift;
+	size_t nblocks;
+	size_t *block;
+} sparsemap;
+
+//where the pixel values of a map are: either a full sky array (data), or
+//column col of a cut sky map (sparse)
+typedef struct
+{
+	size_t nside;
+	int order;
+	const float *data;
+	const sparsemap *sparse;
+	int col;
+} mapsource;
+
+//read the pixels and the first ncols map columns of the cut sky file
+//filename, of the given nside and ordering, into s. Columns the file does
+//not have are null. Returns 1 if it was read, or 0 with the hpic error set.
+int sparse_read(sparsemap *s, const char *filename, size_t nside, int order, int ncols);
+void sparse_free(sparsemap *s);
+
+//value of pixel pix in column col of s, HPIC_NULL if it was not observed
+float sparse_get(const sparsemap *s, int col, size_t pix);
+
+//degrade column col of s to nside/2, as the levels of a map pyramid are:
+//each pixel the average of its non-null children. out is NEST ordered,
+//with one column. Returns 0 if there is no memory for it
+int sparse_degrade(const sparsemap *s, int col, sparsemap *out);
+
+//set src to a full sky map or a column of a cut sky map. map_source
+//returns 0 (and src is cleared) if the map has no full sky array
+int map_source(hpic_float *map, mapsource *src);
+void sparse_source(const sparsemap *s, int col, mapsource *src);
+
+//value of pixel pix of a source; this is on the inner loop of every scan
+//and trace
+static inline float source_value(const mapsource *src, size_t pix)
+{
+	return src->data ? src->data[pix] : sparse_get(src->sparse,src->col,pix);
+}
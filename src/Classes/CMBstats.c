@@ -0,0 +1,407 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+* Reductions over float buffers: range, count, sum and sum of squares in     *
+* one pass, and the Nbin histograms shown in the histogram view, either      *
+* binned exactly or refined from a fine histogram gathered on the fly.       *
+*                                                                            *
+*****************************************************************************/
+
+#import <string.h>
+#import "CMBstats.h"
+
+//independent accumulators per block, so the inner loops carry no
+//dependency from one value to the next and the compiler vectorizes them
+#define STATS_LANES 8
+
+//values reduced by each thread pool task, and by each pass of the inner
+//loops (small enough for the bin indices to stay in L1)
+#define STATS_TASK (1L<<16)
+#define STATS_BLOCK 256
+
+//most channels stats_histograms() takes at once (T, Q, U and P)
+#define STATS_MAXCHAN 4
+
+//the fine histogram must resolve each Nbin bin into at least this many
+//fine bins for the refined histogram to be used
+#define PREHIST_MINFINE 4
+
+
+/**********************************************************************/
+/*                       range and moments                            */
+/**********************************************************************/
+
+void stats_clear(valuestats *s)
+{
+	s->min = s->max = 0.0;
+	s->count = 0;
+	s->sum = s->sum2 = 0.0;
+}
+
+void stats_merge(valuestats *into, const valuestats *from)
+{
+	if (!from->count) return;
+	if (!into->count)
+	{
+		*into = *from;
+		return;
+	}
+	if (from->min<into->min) into->min = from->min;
+	if (from->max>into->max) into->max = from->max;
+	into->count += from->count;
+	into->sum += from->sum;
+	into->sum2 += from->sum2;
+}
+
+//fold n values (those with nonzero mask, if mask is not NULL) into s, and
+//into the fine histogram h if it is not NULL
+void stats_block(const float *values, const int *mask, size_t n,
+				 valuestats *s, prehist *h)
+{
+	float mn[STATS_LANES], mx[STATS_LANES], sum[STATS_LANES], sum2[STATS_LANES];
+	float x, lo, hi, scale = 0.0, top = (float)(PREHIST_BINS-1), t;
+	int cnt[STATS_LANES], idx[STATS_BLOCK], j, on;
+	const float *v;
+	const int *m;
+	size_t i, k, len;
+	valuestats b;
+
+	stats_clear(&b);
+	b.min = HUGE_VALF; b.max = -HUGE_VALF;
+	for (j=0; j<STATS_LANES; j++)
+	{
+		mn[j] = HUGE_VALF; mx[j] = -HUGE_VALF;
+	}
+	if (h && h->hi>h->lo) scale = (float)PREHIST_BINS/(h->hi-h->lo);
+
+	for (i=0; i<n; i+=len)
+	{
+		len = n-i < STATS_BLOCK ? n-i : STATS_BLOCK;
+		v = values+i;
+		m = mask ? mask+i : NULL;
+
+		//sums are kept in float within a block and in double across blocks
+		for (j=0; j<STATS_LANES; j++)
+		{
+			sum[j] = sum2[j] = 0.0f;
+			cnt[j] = 0;
+		}
+
+		//whole groups of lanes; masked out values leave each lane unchanged
+		if (m)
+		{
+			for (k=0; k+STATS_LANES<=len; k+=STATS_LANES)
+			{
+				for (j=0; j<STATS_LANES; j++)
+				{
+					//(v is read whatever the mask, so this is a select not a branch)
+					on = m[k+j]!=0;
+					x = v[k+j];
+					lo = on ? x : HUGE_VALF;
+					hi = on ? x : -HUGE_VALF;
+					x = on ? x : 0.0f;
+					mn[j] = lo<mn[j] ? lo : mn[j];
+					mx[j] = hi>mx[j] ? hi : mx[j];
+					sum[j] += x;
+					sum2[j] += x*x;
+					cnt[j] += on;
+				}
+			}
+		}
+		else
+		{
+			for (k=0; k+STATS_LANES<=len; k+=STATS_LANES)
+			{
+				for (j=0; j<STATS_LANES; j++)
+				{
+					x = v[k+j];
+					mn[j] = x<mn[j] ? x : mn[j];
+					mx[j] = x>mx[j] ? x : mx[j];
+					sum[j] += x;
+					sum2[j] += x*x;
+					cnt[j]++;
+				}
+			}
+		}
+		for (; k<len; k++)
+		{
+			if (m && !m[k]) continue;
+			x = v[k];
+			mn[0] = x<mn[0] ? x : mn[0];
+			mx[0] = x>mx[0] ? x : mx[0];
+			sum[0] += x;
+			sum2[0] += x*x;
+			cnt[0]++;
+		}
+		for (j=0; j<STATS_LANES; j++)
+		{
+			b.sum += sum[j];
+			b.sum2 += sum2[j];
+			b.count += cnt[j];
+		}
+
+		if (!h) continue;
+
+		//fine bin indices, clamped to the end bins
+		for (k=0; k<len; k++)
+		{
+			t = (v[k]-h->lo)*scale;
+			t = t < top ? t : top;
+			t = t > 0.0f ? t : 0.0f;
+			idx[k] = (int)t;
+		}
+		for (k=0; k<len; k++)
+		{
+			if (m && !m[k]) continue;
+			if (v[k]<h->lo || v[k]>h->hi) h->outside++;
+			h->bins[idx[k]]++;
+		}
+	}
+
+	for (j=0; j<STATS_LANES; j++)
+	{
+		if (mn[j]<b.min) b.min = mn[j];
+		if (mx[j]>b.max) b.max = mx[j];
+	}
+	stats_merge(s,&b);
+}
+
+
+/**********************************************************************/
+/*                      fine pre-histograms                           */
+/**********************************************************************/
+
+void prehist_clear(prehist *h, float lo, float hi)
+{
+	h->lo = lo;
+	h->hi = hi;
+	h->outside = 0;
+	memset(h->bins,0,sizeof(h->bins));
+}
+
+//(both must have the same provisional range)
+void prehist_merge(prehist *into, const prehist *from)
+{
+	int i;
+
+	into->outside += from->outside;
+	for (i=0; i<PREHIST_BINS; i++)
+	{
+		into->bins[i] += from->bins[i];
+	}
+}
+
+//Nbin histogram of the values gathered in h over their range [min,max],
+//binned like the exact histograms below. Each fine bin is counted in the
+//bin holding its center. Returns 0, leaving hist alone, if some values
+//fell outside the provisional range or the fine bins are too coarse for
+//[min,max]; the caller must then bin the values exactly
+int prehist_refine(const prehist *h, float min, float max, float hist[Nbin])
+{
+	double wfine, wbin, center;
+	long total;
+	int i, bin;
+
+	if (h->outside) return 0;
+
+	memset(hist,0,Nbin*sizeof(float));
+	if (max==min)
+	{
+		for (i=0, total=0; i<PREHIST_BINS; i++) total += h->bins[i];
+		hist[0] = (float)total;
+		return 1;
+	}
+
+	wfine = ((double)h->hi-h->lo)/PREHIST_BINS;
+	wbin = ((double)max-min)/(Nbin-1);
+	if (!(h->hi>h->lo) || PREHIST_MINFINE*wfine>wbin) return 0;
+
+	for (i=0; i<PREHIST_BINS; i++)
+	{
+		if (!h->bins[i]) continue;
+		center = h->lo+(i+0.5)*wfine;
+		bin = (int)floor((center-min)/wbin);
+		if (bin<0) bin = 0;
+		if (bin>Nbin-1) bin = Nbin-1;
+		hist[bin] += h->bins[i];
+	}
+	return 1;
+}
+
+
+/**********************************************************************/
+/*                       exact histograms                             */
+/**********************************************************************/
+
+//per-worker bins, padded so workers do not share cache lines
+typedef struct
+{
+	unsigned int bins[STATS_MAXCHAN][Nbin];
+	valuestats stats[STATS_MAXCHAN];
+	char pad[64];
+} histworker;
+
+typedef struct
+{
+	int nchan, wantstats;
+	float *const *values;
+	const int *mask;
+	size_t n;
+	float min[STATS_MAXCHAN], max[STATS_MAXCHAN];
+	histworker *workers;
+} histjob;
+
+static void hist_task(void *arg, long task, int worker)
+{
+	histjob *job = (histjob *)arg;
+	histworker *w = &job->workers[worker];
+	int idx[STATS_BLOCK], c;
+	const float *v;
+	const int *mask;
+	size_t start, end, i, k, len;
+	float t, min, range, top = (float)(Nbin-1);
+
+	start = (size_t)task*STATS_TASK;
+	end = start+STATS_TASK < job->n ? start+STATS_TASK : job->n;
+
+	for (c=0; c<job->nchan; c++)
+	{
+		min = job->min[c];
+		range = job->max[c]-job->min[c];
+		for (i=start; i<end; i+=len)
+		{
+			len = end-i < STATS_BLOCK ? end-i : STATS_BLOCK;
+			v = job->values[c]+i;
+			mask = job->mask ? job->mask+i : NULL;
+
+			if (job->wantstats) stats_block(v,mask,len,&w->stats[c],NULL);
+
+			//same arithmetic as the histograms have always used, so the
+			//bins are unchanged; a zero width range puts everything in bin 0
+			for (k=0; k<len; k++)
+			{
+				t = range!=0.0f ? top*(v[k]-min)/range : 0.0f;
+				t = t < top ? t : top;
+				t = t > 0.0f ? t : 0.0f;
+				idx[k] = (int)t;
+			}
+			for (k=0; k<len; k++)
+			{
+				if (mask && !mask[k]) continue;
+				w->bins[c][idx[k]]++;
+			}
+		}
+	}
+}
+
+//one pass over nchan arrays of n values each (only those with nonzero
+//mask, if mask is not NULL), giving the statistics of each array and its
+//Nbin histogram over [min[c],max[c]]. Either output may be NULL
+void stats_histograms(int nchan, float *const *values, const int *mask, size_t n,
+					  const float *min, const float *max,
+					  valuestats *stats, float (*hist)[Nbin],
+					  threadpool_monitor monitor, void *monitor_arg)
+{
+	histjob job;
+	int nworkers, c, w, bin;
+
+	if (nchan>STATS_MAXCHAN)
+	{
+		fprintf(stderr,"ERROR: stats_histograms takes at most %d channels\n",STATS_MAXCHAN);
+		exit(EXIT_FAILURE);
+	}
+
+	nworkers = threadpool_nworkers();
+	job.workers = (histworker *)calloc(nworkers,sizeof(histworker));
+	if (!job.workers)
+	{
+		fprintf(stderr,"ERROR: failed to allocate histograms\n");
+		exit(EXIT_FAILURE);
+	}
+	job.nchan = nchan;
+	job.wantstats = stats!=NULL;
+	job.values = values;
+	job.mask = mask;
+	job.n = n;
+	for (c=0; c<nchan; c++)
+	{
+		job.min[c] = min[c];
+		job.max[c] = max[c];
+	}
+
+	threadpool_run(hist_task,&job,(long)((n+STATS_TASK-1)/STATS_TASK),monitor,monitor_arg);
+
+	//merge the per-worker results
+	for (c=0; c<nchan; c++)
+	{
+		if (stats) stats_clear(&stats[c]);
+		if (hist) memset(hist[c],0,Nbin*sizeof(float));
+		for (w=0; w<nworkers; w++)
+		{
+			if (stats) stats_merge(&stats[c],&job.workers[w].stats[c]);
+			if (!hist) continue;
+			for (bin=0; bin<Nbin; bin++)
+			{
+				hist[c][bin] += job.workers[w].bins[c][bin];
+			}
+		}
+	}
+	free(job.workers);
+}
+
+
+/**********************************************************************/
+/*                     normalized histograms                          */
+/**********************************************************************/
+
+//the linear and log scaled histograms drawn by the histogram view, each
+//normalized to the fullest bin. Empty bins are 0 on both scales
+void hist_normalize(const float hist[Nbin], float norm[Nbin], float normlog[Nbin])
+{
+	float hist_max = 0.0, hlog_max = 0.0, hlog_min = 0.0;
+	double hlog[Nbin];
+	float loghist_floor = 0.02;
+	int bin, found = 0;
+
+	for (bin=0; bin<Nbin; bin++)
+	{
+		if (hist[bin]>hist_max) hist_max = hist[bin];
+		if (hist[bin]==0.0) continue;
+
+		hlog[bin] = log(hist[bin]);
+		if (!found || hlog[bin]>hlog_max) hlog_max = hlog[bin];
+		if (!found || hlog[bin]<hlog_min) hlog_min = hlog[bin];
+		found = 1;
+	}
+
+	for (bin=0; bin<Nbin; bin++)
+	{
+		norm[bin] = hist_max==0.0 ? 0.0 : hist[bin]/hist_max;
+
+		if (hist[bin]==0.0 || hlog_max==hlog_min)
+		{
+			normlog[bin] = 0.0;
+		}
+		else
+		{
+			normlog[bin] = loghist_floor + (hlog[bin]-hlog_min)/(hlog_max-hlog_min)*(1.0-loghist_floor);
+		}
+	}
+}
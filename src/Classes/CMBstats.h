@@ -0,0 +1,69 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+*                                                                            *
+* Statistics and histograms of map values. Shared by the application and     *
+* the ray tracer, so kept free of OpenGL.                                    *
+*                                                                            *
+*****************************************************************************/
+
+#import <stdio.h>
+#import <stdlib.h>
+#import <math.h>
+#import "threadpool.h"
+
+//number of bins for histogram view
+#define Nbin 256
+
+//statistics of a set of values; the mean and rms follow from sum and sum2.
+//min and max are only meaningful once count is nonzero
+typedef struct
+{
+	float min, max;
+	long count;
+	double sum, sum2;
+} valuestats;
+
+//fine histogram over a provisional range [lo,hi], filled while the values
+//are produced and refined to Nbin bins once their own range is known.
+//Values outside [lo,hi] are counted in outside (and the end bins)
+#define PREHIST_BINS (64*Nbin)
+
+typedef struct
+{
+	float lo, hi;
+	long outside;
+	unsigned int bins[PREHIST_BINS];
+} prehist;
+
+void stats_clear(valuestats *s);
+void stats_merge(valuestats *into, const valuestats *from);
+void stats_block(const float *values, const int *mask, size_t n,
+				 valuestats *s, prehist *h);
+
+void prehist_clear(prehist *h, float lo, float hi);
+void prehist_merge(prehist *into, const prehist *from);
+int prehist_refine(const prehist *h, float min, float max, float hist[Nbin]);
+
+void stats_histograms(int nchan, float *const *values, const int *mask, size_t n,
+					  const float *min, const float *max,
+					  valuestats *stats, float (*hist)[Nbin],
+					  threadpool_monitor monitor, void *monitor_arg);
+void hist_normalize(const float hist[Nbin], float norm[Nbin], float normlog[Nbin]);
@@ -0,0 +1,273 @@
+/*****************************************************************************
+* Copyright 2005 Jamie Portsmouth <jamports@mac.com>                         *
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+* Equal-area Stokes vectors. The NEST pixel tree is walked down from the    *
+* twelve base pixels, keeping only pixels which can be seen, to the binning  *
+* nside; Q and U of each of those are read from the pyramid level at that   *
+* nside, which already holds the averages of the map pixels under it.       *
+*                                                                            *
+*****************************************************************************/
+
+#import "CMBstokes.h"
+#import "memory.h"
+
+//binned pixels per pool task
+#define STOKES_BLOCK 64
+
+//a visible pixel at the binning nside
+typedef struct
+{
+	size_t pix, x, y, face;
+	double vec[3];
+} stokesbin;
+
+typedef struct
+{
+	float Pmax;
+	char pad[64];
+} stokesmax;
+
+typedef struct
+{
+	const stokesbin *bins;
+	long nbins;
+	int nside_bin, convention;
+	float lift;
+	mapsource Q, U;
+	float *P;
+	Stokes_ptrs *s;
+	stokesmax max[THREADPOOL_MAXWORKERS];
+} stokesjob;
+
+void stokes_headless(const double ray[3], float Q, float U, int convention, GLfloat out[3])
+{
+	float thetas, phis, Stokes_angle, Stokes_xvec[3], Stokes_yvec[3];
+	int c;
+	
+	thetas = (float)acos(ray[2]);
+	phis = (float)atan2(ray[1],ray[0]);
+	
+	Stokes_xvec[0] = cos(phis)*cos(thetas);
+	Stokes_xvec[1] = sin(phis)*cos(thetas);
+	Stokes_xvec[2] = -sin(thetas);		
+	
+	if (!convention)
+	{
+		//HEALPix convention								
+		Stokes_yvec[0] = -sin(phis);
+		Stokes_yvec[1] = cos(phis);
+		Stokes_yvec[2] = 0.0;			
+	}
+	else 
+	{
+		//IAU convention								
+		Stokes_yvec[0] = sin(phis);
+		Stokes_yvec[1] = -cos(phis);
+		Stokes_yvec[2] = 0.0;
+	}
+	
+	Stokes_angle = 0.5*(float)atan2((double)U,(double)Q);
+	for (c=0;c<3;c++)
+	{
+		out[c] = cos(Stokes_angle)*Stokes_xvec[c] + sin(Stokes_angle)*Stokes_yvec[c];
+	}
+}
+
+int stokes_binned_nside(const Observer *o, float fovy, int ortho, int NStokes, int nside)
+{
+	double view, pixsize;
+	int n;
+	
+	//angle subtended by the view height where the sphere is nearest
+	if (ortho) view = o->frustum_height/radius;
+	else view = 2.0*(o->eyedistance_perspective-radius)*tan(0.5*fovy*PI/180.0)/radius;
+	if (view>PI) view = PI;
+	
+	for (n=1; n<nside; n*=2)
+	{
+		pixsize = sqrt(PI/3.0)/(double)n;
+		if (pixsize <= view/(double)NStokes) break;
+	}
+	return n;
+}
+
+
+/**********************************************************************/
+/*                    visible pixels at the bin nside                 */
+/**********************************************************************/
+
+typedef struct
+{
+	stokesbin *bins;
+	long nbins, size;
+} binlist;
+
+//children of NEST pixel pix at nside n are 4*pix..4*pix+3 at nside 2n. A
+//pixel lies within 2/n radians of its centre.
+static void find_bins(const Observer *o, float fovy, int ortho, int n, size_t pix,
+					  int nside_bin, binlist *list)
+{
+	stokesbin *b;
+	double vec[3];
+	int k;
+	
+	hpic_pix2vec_nest((size_t)n,pix,&vec[0],&vec[1],&vec[2]);
+	if (n<nside_bin)
+	{
+		if (!observer_cap_visible(o,fovy,ortho,vec,2.0/(double)n)) return;
+		for (k=0;k<4;k++) find_bins(o,fovy,ortho,2*n,4*pix+k,nside_bin,list);
+		return;
+	}
+	
+	//a bin is kept only if its centre, where the vector goes, is in view
+	if (!observer_cap_visible(o,fovy,ortho,vec,0.0)) return;
+	if (list->nbins==list->size)
+	{
+		list->size = list->size ? 2*list->size : 1024;
+		list->bins = (stokesbin *)realloc(list->bins,list->size*sizeof(stokesbin));
+		if (!list->bins) memerror("failure in stokes_binned()");
+	}
+	b = &list->bins[list->nbins++];
+	b->pix = pix;
+	hpic_nest2xyf((size_t)n,pix,&b->x,&b->y,&b->face);
+	for (k=0;k<3;k++) b->vec[k] = vec[k];
+}
+
+
+/**********************************************************************/
+/*                        averaging the map                           */
+/**********************************************************************/
+
+//the pyramid levels normally give r = 1, one pixel per bin; the pixels are
+//only averaged here if a level at the bin nside is missing
+static void bin_block(void *arg, long task, int worker)
+{
+	stokesjob *job = (stokesjob *)arg;
+	const stokesbin *b;
+	long k, last = (task+1)*STOKES_BLOCK;
+	size_t r = job->Q.nside/(size_t)job->nside_bin, i, j, pix, first;
+	double Qsum, Usum;
+	float Q, U, P;
+	long count;
+	int c;
+	
+	if (last>job->nbins) last = job->nbins;
+	for (k=task*STOKES_BLOCK; k<last; k++)
+	{
+		b = &job->bins[k];
+		Qsum = Usum = 0.0;
+		count = 0;
+		
+		if (job->Q.order==HPIC_NEST)
+		{
+			first = b->pix*r*r;
+			for (pix=first; pix<first+r*r; pix++)
+			{
+				Q = source_value(&job->Q,pix);
+				U = source_value(&job->U,pix);
+				if (hpic_is_fnull(Q) || hpic_is_fnull(U)) continue;
+				Qsum += Q;
+				Usum += U;
+				count++;
+			}
+		}
+		else
+		{
+			for (i=0; i<r; i++)
+			{
+				for (j=0; j<r; j++)
+				{
+					hpic_xyf2ring(job->Q.nside,b->x*r+i,b->y*r+j,b->face,&pix);
+					Q = source_value(&job->Q,pix);
+					U = source_value(&job->U,pix);
+					if (hpic_is_fnull(Q) || hpic_is_fnull(U)) continue;
+					Qsum += Q;
+					Usum += U;
+					count++;
+				}
+			}
+		}
+		
+		//(a bin with no data gets a vector of zero length)
+		Q = count ? (float)(Qsum/count) : 0.0f;
+		U = count ? (float)(Usum/count) : 0.0f;
+		P = (float)sqrt((double)Q*Q+U*U);
+		if (P>job->max[worker].Pmax) job->max[worker].Pmax = P;
+		job->P[k] = P;
+		
+		for (c=0;c<3;c++) job->s->Stokes_centre[3*k+c] = job->lift * (float)b->vec[c];
+		stokes_headless(b->vec,Q,U,job->convention,&job->s->Stokes_offset[3*k]);
+	}
+}
+
+int stokes_binned(const Observer *o, float fovy, int ortho, int nside_bin,
+				  int convention, Stokes_ptrs *s,
+				  threadpool_monitor monitor, void *monitor_arg)
+{
+	binlist list = {NULL,0,0};
+	stokesjob *job;
+	size_t base;
+	long k;
+	int w, c;
+	float Pmax;
+	
+	job = (stokesjob *)calloc(1,sizeof(stokesjob));
+	if (!job) memerror("failure in stokes_binned()");
+	if (!pyramid_source(&Qpyramid,nside_bin,&job->Q) || !pyramid_source(&Upyramid,nside_bin,&job->U) ||
+		job->Q.nside!=job->U.nside || job->Q.order!=job->U.order)
+	{
+		free(job);
+		return 0;
+	}
+	
+	for (base=0; base<12; base++) find_bins(o,fovy,ortho,1,base,nside_bin,&list);
+	
+	s->NStokes_vectors = (int)list.nbins;
+	s->Stokes_ends_scale = -1.0f;
+	s->Stokes_centre = vector(0,3*list.nbins);
+	s->Stokes_offset = vector(0,3*list.nbins);
+	s->Stokes_ends = vector(0,6*list.nbins);
+	
+	job->bins = list.bins;
+	job->nbins = list.nbins;
+	job->nside_bin = nside_bin;
+	job->convention = convention;
+	job->lift = (1.0+o->axisspace) * radius;
+	job->P = vector(0,list.nbins);
+	job->s = s;
+	threadpool_run(bin_block,job,(list.nbins+STOKES_BLOCK-1)/STOKES_BLOCK,monitor,monitor_arg);
+	
+	//scale the headless vectors by the polarisation relative to the largest
+	Pmax = 0.0f;
+	for (w=0; w<THREADPOOL_MAXWORKERS; w++)
+	{
+		if (job->max[w].Pmax>Pmax) Pmax = job->max[w].Pmax;
+	}
+	for (k=0; k<list.nbins; k++)
+	{
+		for (c=0;c<3;c++) s->Stokes_offset[3*k+c] *= Pmax>0.0f ? job->P[k]/Pmax : 0.0f;
+	}
+	
+	free_vector(job->P,0,list.nbins);
+	free(job);
+	free(list.bins);
+	return 1;
+}
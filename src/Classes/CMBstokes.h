@@ -0,0 +1,41 @@
+/*****************************************************************************
+* Copyright 2005 Jamie Portsmouth <jamports@mac.com>                         *
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+*****************************************************************************/
+
+#import "CMBview.h"
+#import "threadpool.h"
+
+//headless Stokes vector direction at the unit vector ray on the sphere, for
+//polarisation (Q,U); convention is 0 for HEALPix, 1 for IAU
+void stokes_headless(const double ray[3], float Q, float U, int convention, GLfloat out[3]);
+
+//coarsest NEST nside whose pixels are no bigger than 1/NStokes of the view
+//height, and no finer than the map
+int stokes_binned_nside(const Observer *o, float fovy, int ortho, int NStokes, int nside);
+
+//equal-area Stokes vectors: one at the centre of each visible pixel of the
+//map degraded to nside_bin, with Q and U averaged over the map pixels inside
+//it. Allocates and fills the vector arrays of s; needs observer_frustum.
+//Returns 0, with nothing allocated, if the Q and U pyramids have no pixels
+int stokes_binned(const Observer *o, float fovy, int ortho, int nside_bin,
+				  int convention, Stokes_ptrs *s,
+				  threadpool_monitor monitor, void *monitor_arg);
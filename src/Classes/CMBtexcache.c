@@ -0,0 +1,83 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+* LRU cache of colored cube face textures. Each entry owns six texture       *
+* names; the least recently used entries are deleted once the textures       *
+* held exceed the memory budget.                                             *
+*                                                                            *
+*****************************************************************************/
+
+#import <string.h>
+#import "CMBtexcache.h"
+#import "lrucache.h"
+
+static void release_texs(int slot);
+
+static texkey keys[TEXCACHE_SLOTS];
+static GLuint texs_held[TEXCACHE_SLOTS][6];
+static lrucache cache = {TEXCACHE_SLOTS, 256*1024*1024, release_texs};
+
+static void release_texs(int slot)
+{
+	glDeleteTextures((GLsizei)6,texs_held[slot]);
+}
+
+static int same_key(int slot, const void *key)
+{
+	const texkey *a = &keys[slot], *b = (const texkey *)key;
+
+	return a->maptype==b->maptype && a->colormap==b->colormap &&
+		   a->reverse==b->reverse && a->Ntexture==b->Ntexture &&
+		   a->min==b->min && a->max==b->max;
+}
+
+//budget for the textures held, in bytes
+void texcache_set_budget(size_t bytes)
+{
+	lru_set_budget(&cache,bytes);
+}
+
+//copies the texture names cached for key into texs and returns 1, or else
+//makes six new names for key and returns 0, and the caller must then fill
+//them
+int texcache_get(const texkey *key, GLuint texs[6])
+{
+	int k;
+
+	k = lru_lookup(&cache,same_key,key);
+	if (k>=0)
+	{
+		memcpy(texs,texs_held[k],sizeof(texs_held[k]));
+		return 1;
+	}
+
+	//RGB8 is padded to 4 bytes a texel by most drivers
+	k = lru_add(&cache,(size_t)6*4*key->Ntexture*key->Ntexture);
+	keys[k] = *key;
+	glGenTextures((GLsizei)6,texs_held[k]);
+	memcpy(texs,texs_held[k],sizeof(texs_held[k]));
+	return 0;
+}
+
+//drops every entry, for when the face data itself changes
+void texcache_flush(void)
+{
+	lru_flush(&cache);
+}
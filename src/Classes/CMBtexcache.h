@@ -0,0 +1,42 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+*****************************************************************************/
+
+#import "CMBview.h"
+
+//colored cube face textures, retained between maps and color settings so
+//switching back to one already seen needs no recoloring or upload.
+//Everything here must be called with the main view's context current.
+
+//what a set of face textures was colored from; colormap is an index into
+//mycolormaps, or -1 for greyscale
+typedef struct
+{
+	int maptype, colormap, reverse, Ntexture;
+	float min, max;
+} texkey;
+
+//most sets held at once, whatever the budget
+#define TEXCACHE_SLOTS 16
+
+void texcache_set_budget(size_t bytes);
+int texcache_get(const texkey *key, GLuint texs[6]);
+void texcache_flush(void);
@@ -30,9 +30,14 @@
 #import <math.h>
 #import <OpenGL/OpenGL.h>
 #import <OpenGL/gl.h>
+#import <OpenGL/glext.h>
 #import <OpenGL/glu.h>
 #import <GLUT/glut.h>
 #import "hpic.h"
+#import "CMBproject.h"
+#import "CMBcolormap.h"
+#import "CMBstats.h"
+#import "CMBpyramid.h"
 
 /* useful defs */
 
@@ -45,39 +50,45 @@ static float maxarg1,maxarg2;
 
 /* hard-coded */
 
-#define radius 1.0
-
-//number of polygons in sphere mesh
-#define Ntheta 64
-#define Nphi (2*Ntheta)
-
 //fraction by which each cube face overhangs 
 #define flange 0.15
 
-//number of bins for histogram view
-#define Nbin 256
-
 /* typedefs and global variable externs */
 
-//vertices and texture coord data
-typedef struct meshtriangle *link;
-typedef struct meshtriangle
+//one patch of the sphere mesh: the square (i,j) of side 2/2^level in the
+//[-1,1]^2 coordinates of a cube face, with triangles indices first to
+//first+count-1, and size its diameter on screen over the view height
+typedef struct
 {
-	float vertex1[3], vertex2[3], vertex3[3]; 
-	float texcoords1[2], texcoords2[2], texcoords3[2];
-	float normal[3];
-	link next;	
-} meshtriangle;
-
-extern link triangles_on_face[6];
+	int face, level, i, j, first, count;
+	float size;
+} meshpatch;
+
+//vertices and texture coord data of the sphere mesh (see CMBlod.c); the
+//triangles of face f are indices first[f] to first[f]+count[f]-1, made up
+//of its patches in order. The vertex positions (on the unit sphere) double
+//as the normals.
+typedef struct
+{
+	GLfloat *vertex, *texcoord;
+	GLushort *index;
+	int Nvertex, Nindex;
+	int first[6], count[6];
+	meshpatch *patch;
+	int Npatches;
+	GLuint buffers[3];
+	int useBuffers;
+} spheremesh;
 extern GLuint face_texs[6], render_tex;
 
-//Stokes vector data
+//Stokes vector data: for each vector, its centre just above the sphere and
+//its headless direction scaled by P/Pmax. Stokes_ends holds the line
+//endpoints for the length scale Stokes_ends_scale (<0 when out of date).
 typedef struct
 {
-	float ***Stokes_headless, **Stokes_headless_mag;
-	double **Stokes_theta_proj, **Stokes_phi_proj;
-	int **Stokes_mask;	
+	GLfloat *Stokes_centre, *Stokes_offset, *Stokes_ends;
+	int NStokes_vectors;
+	float Stokes_ends_scale;
 } Stokes_ptrs;
 extern Stokes_ptrs stokes_ptrs;
 enum stokesproperties {stokes_color,stokes_opacity,stokes_thickness,
@@ -92,36 +103,36 @@ typedef struct
 } Cubecoords;
 extern Cubecoords cubecoords;
 
-//colormap variables
-typedef struct 
-{
-	int color_N;
-	float *color_xi;
-	float **color_ci;
-} colormap;
-extern colormap mycolormaps[8];
-extern colormap *current_colormap_ptr;
-enum colormaps {hsv, jet, hot, cool, copper, neg, bone, winter};
-
 //grid properties
 enum gridproperties {grid_color,grid_enable,grid_opacity,grid_thickness,gridincaps};
 
+//vertices of the grid lines, one line strip per line; rebuilt only when the
+//grid or the number of segments per quarter circle (Narc) changes
+typedef struct
+{
+	int gridnum, incaps, Narc;
+	float axisspace;
+	GLfloat *vertex;
+	GLint *first;
+	GLsizei *count;
+	int Nlines;
+} graticule;
+
+//range of segments per quarter circle in the grid lines
+#define GRATICULE_MINARC 32
+#define GRATICULE_MAXARC 1024
+
 //global pointers to hpic data
 extern hpic_fltarr* hpic_maps; 	
 extern hpic_float *hpic_Tmap, *hpic_Qmap, *hpic_Umap, *hpic_Nmap;
-extern hpic_float *cuterrs;
-extern hpic_int *cutpix, *cuthits;
+//and their degraded levels, for sampling at coarser spacings
+extern mappyramid Tpyramid, Qpyramid, Upyramid;
+//the pixels of a cut sky map (NULL for a full sky one)
+extern sparsemap *cutmap;
 extern char hpic_errorstr[HPIC_STRNL];
 extern _Bool HPIC_ERROR_FLAG;
 
 //observer parameters
-typedef struct
-{
-	float aspect_ratio,near,far,frustum_width,frustum_height;
-	float view_width,view_height,axisspace;
-	float eyedistance, eyedistance_perspective, eyedistance_ortho;
-	float view_direction[3],view_point[3],localy[3],localx[3];
-} Observer;
 extern Observer obs;
 
 //structures to organize histogram data and view:
@@ -174,37 +185,20 @@ typedef struct Histogram
 
 /* function declarations */
 
-//math routines
-float scalarprod(float v1[3], float v2[3]);
-void normalize(float v[3]);
-void normalize_double(double v[3]);
-void normcrossprod(float v1[3], float v2[3], float out[3]);
-
 //draw routines
-void drawtriangle_projected(float *v1, float *v2, float *v3,
-							float tex1[2], float tex2[2], float tex3[2]);
-void drawtriangle_projected_notex(float *v1, float *v2, float *v3);
-void greatcircle(double gc_theta1,double gc_phi1,
-				 double gc_theta2,double gc_phi2,int Narc);
-void latitude(double lat_theta,double lat_phi1,double lat_phi2,int Narc);
+void spheremesh_upload(spheremesh *m);
+void spheremesh_begin(const spheremesh *m, int textured);
+void spheremesh_drawface(const spheremesh *m, int face);
+void spheremesh_drawpatch(const spheremesh *m, int k);
+void spheremesh_end(const spheremesh *m);
+int graticule_segments(const Observer *o, float fovy, int ortho);
+void graticule_update(graticule *g, int gridnum, int incaps, float axisspace, int Narc);
+void graticule_draw(const graticule *g);
+void stokes_draw(Stokes_ptrs *s, float scale);
 
 //mesh geometry and projection
 void initcoordsystem(void);
-void genvertexcoords(void);
-void addtriangle(link *tlink,float *v1, float *v2, float *v3,
-				             float *t1, float *t2, float *t3);
 void projecttocube(float *onsphere, int *facenum, float *tex);
 void projecttoface(float *onsphere, int whichface, float *tex);
 void cubetexel_to_sphere(int Ntexture, int a, int b, int face, double *theta_proj, double *phi_proj);
-
-//color computations
-void HSVtoRGB( float *r, float *g, float *b, float h, float s, float v );
-void colorpath(int n, float *xi, float **ci, float x, float *c);
-void findbin(float xx[], unsigned long n, float x, unsigned long *j);
-void define_colormaps(void);
-void colortable(int c, int samples, int channels, 
-				float map_scalars[samples], float map_values[samples][channels],
-				float **cm_scalars, float ***cm_values);
-
-
-
+void cubetexel_to_vector(int Ntexture, int a, int b, int face, double *vec);
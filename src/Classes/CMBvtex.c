@@ -0,0 +1,422 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+* Virtual cube map tiles: an LRU of GL textures found by a hash on the      *
+* tile, the list of tiles the last frame wanted, and their making, which    *
+* samples the map pyramid level matching the tile's texels on the thread    *
+* pool and colors and uploads them here.                                    *
+*                                                                            *
+*****************************************************************************/
+
+#import <stdlib.h>
+#import <string.h>
+#import "CMBvtex.h"
+#import "chealpix.h"
+#import "memory.h"
+#import "threadpool.h"
+
+//rows of a tile filled by one task
+#define VTEX_ROWS 32
+
+//buckets of the tile hash
+#define VTEX_HASH 8192
+
+//each patch of the mesh wants at most one tile
+#define VTEX_WANTS 512
+
+//RGB8 is padded to 4 bytes a texel by most drivers
+#define VTEX_TILEBYTES (4*VTEX_TILE*VTEX_TILE)
+
+typedef struct
+{
+	vtile tile;
+	GLuint tex;
+	unsigned long used;
+	int valid, next;
+} vslot;
+
+typedef struct
+{
+	vtile tile;
+	float priority;
+} vwant;
+
+//the tiles sampled by one call to threadpool_run
+typedef struct
+{
+	vtile tile[VTEX_BATCH];
+	mapsource src[VTEX_BATCH], U[VTEX_BATCH];
+	int pol[VTEX_BATCH];
+	hpint64 nside[VTEX_BATCH];
+	void (*vec2pix[VTEX_BATCH])(const hpint64 nside, const double *vec, hpint64 *ipix);
+	float *values;
+} vjob;
+
+static vslot slots[VTEX_SLOTS];
+static int head[VTEX_HASH];
+static int nslots = 0, hashed = 0;
+static unsigned long frame = 0;
+
+static vwant wants[VTEX_WANTS];
+static int nwants = 0;
+static float view_px = 0.0f;
+static int lo_level = 0, hi_level = -1;
+
+static texkey colorkey;
+static colorlut colors;
+static int colored = 0;
+
+//staging for a batch, kept between calls
+static float *values = NULL;
+static unsigned char *rgb = NULL;
+
+
+/**********************************************************************/
+/*                          tile lookup                               */
+/**********************************************************************/
+
+static int same_tile(const vtile *a, const vtile *b)
+{
+	return a->face==b->face && a->level==b->level && a->i==b->i && a->j==b->j;
+}
+
+static unsigned int hash(const vtile *t)
+{
+	unsigned int h = (unsigned int)(t->face*8+t->level);
+	h = h*2654435761u + (unsigned int)t->i;
+	h = h*2654435761u + (unsigned int)t->j;
+	return (h>>13) & (VTEX_HASH-1);
+}
+
+//the slot holding t, or -1
+static int find(const vtile *t)
+{
+	int k;
+
+	if (!hashed) return -1;
+	for (k=head[hash(t)]; k>=0; k=slots[k].next)
+	{
+		if (same_tile(&slots[k].tile,t)) return k;
+	}
+	return -1;
+}
+
+static void unlink_slot(int k)
+{
+	int *link = &head[hash(&slots[k].tile)];
+
+	while (*link!=k) link = &slots[*link].next;
+	*link = slots[k].next;
+	slots[k].valid = 0;
+}
+
+static void link_slot(int k, const vtile *t)
+{
+	unsigned int h = hash(t);
+
+	slots[k].tile = *t;
+	slots[k].next = head[h];
+	slots[k].used = frame;
+	slots[k].valid = 1;
+	head[h] = k;
+}
+
+//a free slot, or the least recently used one not drawn in the last frame,
+//or -1 if every slot was
+static int claim_slot(void)
+{
+	int k, lru = -1;
+
+	for (k=0; k<nslots; k++)
+	{
+		if (!slots[k].valid) return k;
+		if (slots[k].used!=frame && (lru<0 || slots[k].used<slots[lru].used)) lru = k;
+	}
+	if (lru>=0) unlink_slot(lru);
+	return lru;
+}
+
+
+/**********************************************************************/
+/*                        budget and coloring                         */
+/**********************************************************************/
+
+void vtex_flush(void)
+{
+	int k;
+
+	for (k=0; k<VTEX_SLOTS; k++)
+	{
+		if (slots[k].tex) glDeleteTextures((GLsizei)1,&slots[k].tex);
+		slots[k].tex = 0;
+		slots[k].valid = 0;
+	}
+	for (k=0; k<VTEX_HASH; k++) head[k] = -1;
+	hashed = 1;
+	nwants = 0;
+}
+
+void vtex_set_budget(size_t bytes)
+{
+	vtex_flush();
+	nslots = bytes/VTEX_TILEBYTES < VTEX_SLOTS ? (int)(bytes/VTEX_TILEBYTES) : VTEX_SLOTS;
+}
+
+//tiles need a map to sample, besides a budget and a coloring
+int vtex_enabled(void)
+{
+	mapsource src;
+
+	return nslots>0 && colored && pyramid_source(&Tpyramid,1,&src);
+}
+
+void vtex_set_colors(const texkey *key, const colorlut *lut)
+{
+	if (colored && key->maptype==colorkey.maptype && key->colormap==colorkey.colormap &&
+		key->reverse==colorkey.reverse && key->Ntexture==colorkey.Ntexture &&
+		key->min==colorkey.min && key->max==colorkey.max) return;
+	
+	vtex_flush();
+	colorkey = *key;
+	colors = *lut;
+	colored = 1;
+}
+
+
+/**********************************************************************/
+/*                           drawing                                  */
+/**********************************************************************/
+
+void vtex_begin(int view_height)
+{
+	double nbase;
+
+	frame++;
+	nwants = 0;
+	view_px = (float)view_height;
+	if (!vtex_enabled()) return;
+	
+	//tiles start at the level finer than the face textures, and stop at
+	//about four texels a map pixel
+	nbase = colorkey.Ntexture/(1.0+flange);
+	for (lo_level=0; lo_level<=VTEX_MAXLEVEL && (VTEX_TILE<<lo_level)<=nbase; lo_level++);
+	for (hi_level=0; hi_level<VTEX_MAXLEVEL && (VTEX_TILE<<hi_level)<4*Tpyramid.map->nside; hi_level++);
+}
+
+static void want_tile(const vtile *t, float priority)
+{
+	int k;
+
+	for (k=0; k<nwants; k++)
+	{
+		if (same_tile(&wants[k].tile,t))
+		{
+			if (priority>wants[k].priority) wants[k].priority = priority;
+			return;
+		}
+	}
+	if (nwants==VTEX_WANTS) return;
+	wants[nwants].tile = *t;
+	wants[nwants].priority = priority;
+	nwants++;
+}
+
+GLuint vtex_lookup(const meshpatch *p, vtile *t)
+{
+	float px = p->size*view_px;
+	int want, level, k = -1;
+	vtile w;
+
+	//no tile finer than the face texture, or one the patch would not fit in
+	if (!vtex_enabled() || p->level<lo_level || lo_level>hi_level) return 0;
+	
+	//the face texture is fine enough already
+	if (colorkey.Ntexture/(1.0+flange)*ldexp(1.0,-p->level) >= px) return 0;
+	
+	//the level whose texels are no bigger than the screen pixels
+	want = lo_level;
+	while (want<hi_level && want<p->level && VTEX_TILE*ldexp(1.0,want-p->level)<px) want++;
+	
+	w.face = p->face;
+	for (level=want; level>=lo_level; level--)
+	{
+		w.level = level;
+		w.i = p->i>>(p->level-level);
+		w.j = p->j>>(p->level-level);
+		if ((k = find(&w))>=0) break;
+	}
+	
+	//the bigger the patch and the coarser what it has, the sooner it is made
+	if (level<want)
+	{
+		w.level = want;
+		w.i = p->i>>(p->level-want);
+		w.j = p->j>>(p->level-want);
+		want_tile(&w,px*(float)(want-level));
+	}
+	if (k<0) return 0;
+	
+	slots[k].used = frame;
+	*t = slots[k].tile;
+	return slots[k].tex;
+}
+
+void vtex_tilematrix(const vtile *t)
+{
+	double side = 2.0/(double)(1<<t->level);
+	double x0 = -1.0+side*t->i, y0 = -1.0+side*t->j;
+	double sc = 2.0*(1.0+flange)/side;
+	
+	//face coords s = x/faceside+0.5 to tile coords (x-x0)/side
+	glMatrixMode(GL_TEXTURE);
+	glLoadIdentity();
+	glTranslated(-0.5*sc-x0/side,-0.5*sc-y0/side,0.0);
+	glScaled(sc,sc,1.0);
+	glMatrixMode(GL_MODELVIEW);
+}
+
+
+/**********************************************************************/
+/*                          making tiles                              */
+/**********************************************************************/
+
+//VTEX_ROWS rows of one tile, laid out like the face textures: row a
+//is y and column b is x on the face
+static void fill_rows(void *arg, long task, int worker)
+{
+	vjob *job = (vjob *)arg;
+	int n = (int)(task/(VTEX_TILE/VTEX_ROWS));
+	int a0 = (int)(task%(VTEX_TILE/VTEX_ROWS))*VTEX_ROWS;
+	const vtile *t = &job->tile[n];
+	double side = 2.0/(double)(1<<t->level);
+	double x0 = -1.0+side*t->i, y0 = -1.0+side*t->j, x, y, p[3];
+	float *out = job->values + ((size_t)n*VTEX_TILE+a0)*VTEX_TILE;
+	float q, u;
+	hpint64 pixnum;
+	int a, b, c;
+
+	for (a=a0; a<a0+VTEX_ROWS; a++)
+	{
+		y = y0+side*(a+0.5)/VTEX_TILE;
+		for (b=0; b<VTEX_TILE; b++)
+		{
+			x = x0+side*(b+0.5)/VTEX_TILE;
+			for (c=0; c<3; c++)
+			{
+				p[c] = cubecoords.local_z[t->face][c] + x*cubecoords.local_x[t->face][c]
+													  + y*cubecoords.local_y[t->face][c];
+			}
+			job->vec2pix[n](job->nside[n],p,&pixnum);
+			if (!job->pol[n])
+			{
+				*out++ = source_value(&job->src[n],pixnum);
+				continue;
+			}
+			q = source_value(&job->src[n],pixnum);
+			u = source_value(&job->U[n],pixnum);
+			*out++ = (float)sqrt((double)q*q+u*u);
+		}
+	}
+}
+
+//point the job at the pyramid level matching the texels of tile n, which
+//are smallest at its corner furthest from the face centre
+static void sample_level(vjob *job, int n)
+{
+	const vtile *t = &job->tile[n];
+	double side = 2.0/(double)(1<<t->level);
+	double x = fmax(fabs(-1.0+side*t->i),fabs(-1.0+side*(t->i+1)));
+	double y = fmax(fabs(-1.0+side*t->j),fabs(-1.0+side*(t->j+1)));
+	double spacing = (side/VTEX_TILE)/(1.0+x*x+y*y);
+	int nside = pyramid_nside(spacing,(int)Tpyramid.map->nside);
+	
+	memset(&job->src[n],0,sizeof(mapsource));
+	job->pol[n] = 0;
+	switch (colorkey.maptype)
+	{
+		case 2:  pyramid_source(&Qpyramid,nside,&job->src[n]); break;
+		case 3:  pyramid_source(&Upyramid,nside,&job->src[n]); break;
+		case 4:
+			pyramid_source(&Qpyramid,nside,&job->src[n]);
+			pyramid_source(&Upyramid,nside,&job->U[n]);
+			job->pol[n] = 1;
+			break;
+		default: pyramid_source(&Tpyramid,nside,&job->src[n]); break;
+	}
+	job->nside[n] = (hpint64)job->src[n].nside;
+	job->vec2pix[n] = job->src[n].order==HPIC_RING ? heal_vec2pix_ring : heal_vec2pix_nest;
+}
+
+int vtex_pending(void)
+{
+	return vtex_enabled() && nwants>0;
+}
+
+static int by_priority(const void *a, const void *b)
+{
+	float pa = ((const vwant *)a)->priority, pb = ((const vwant *)b)->priority;
+	return (pa<pb) - (pa>pb);
+}
+
+int vtex_generate(void)
+{
+	vjob job;
+	int slot[VTEX_BATCH], n = 0, k;
+	
+	if (!vtex_pending()) return 0;
+	if (!values)
+	{
+		values = (float *)malloc((size_t)VTEX_BATCH*VTEX_TILE*VTEX_TILE*sizeof(float));
+		rgb = (unsigned char *)malloc((size_t)VTEX_BATCH*VTEX_TILE*VTEX_TILE*3);
+		if (!values || !rgb) memerror("failure in vtex_generate()");
+	}
+	
+	//the most wanted tiles that there are slots for
+	qsort(wants,(size_t)nwants,sizeof(vwant),by_priority);
+	for (k=0; k<nwants && n<VTEX_BATCH; k++)
+	{
+		if (find(&wants[k].tile)>=0) continue;
+		if ((slot[n] = claim_slot())<0) break;
+		link_slot(slot[n],&wants[k].tile);
+		job.tile[n] = wants[k].tile;
+		sample_level(&job,n);
+		n++;
+	}
+	nwants -= k;
+	memmove(wants,wants+k,(size_t)nwants*sizeof(vwant));
+	if (!n) return 0;
+	
+	job.values = values;
+	threadpool_run(fill_rows,&job,(long)n*(VTEX_TILE/VTEX_ROWS),NULL,NULL);
+	colorlut_apply(&colors,values,NULL,(size_t)n*VTEX_TILE*VTEX_TILE,
+				   colorkey.min,colorkey.max,rgb);
+	
+	glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+	for (k=0; k<n; k++)
+	{
+		if (!slots[slot[k]].tex) glGenTextures((GLsizei)1,&slots[slot[k]].tex);
+		glBindTexture(GL_TEXTURE_2D,slots[slot[k]].tex);
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+		glTexImage2D(GL_TEXTURE_2D,0,GL_RGB8,VTEX_TILE,VTEX_TILE,0,GL_RGB,GL_UNSIGNED_BYTE,
+					 rgb+(size_t)k*VTEX_TILE*VTEX_TILE*3);
+	}
+	return n;
+}
@@ -0,0 +1,76 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+* Virtual cube map. Each face of the texture cube is a quadtree of tiles    *
+* of VTEX_TILE^2 texels; level t has 2^t x 2^t tiles across the face. Only  *
+* the tiles that the visible mesh patches need finer than the face          *
+* textures are made, most wanted first, sampled straight from the map       *
+* pyramid; a patch whose tile is not made yet is drawn from a coarser one,  *
+* or from the face texture.                                                 *
+*                                                                            *
+*****************************************************************************/
+
+#import "CMBview.h"
+#import "CMBcolormap.h"
+#import "CMBtexcache.h"
+
+//texels along the side of a tile
+#define VTEX_TILE 256
+
+//finest level, 2^VTEX_MAXLEVEL tiles (16384 texels) across a face
+#define VTEX_MAXLEVEL 6
+
+//tiles made per call to vtex_generate
+#define VTEX_BATCH 16
+
+//most tiles held at once, whatever the budget
+#define VTEX_SLOTS 4096
+
+//a tile: square (i,j) of level on a cube face
+typedef struct
+{
+	int face, level, i, j;
+} vtile;
+
+//Everything here must be called with the main view's context current.
+
+//budget for the tiles held, in bytes; 0 turns tiling off. Flushes the tiles
+void vtex_set_budget(size_t bytes);
+int vtex_enabled(void);
+
+//the coloring for the tiles, as for the face textures of key; tiles
+//colored otherwise are dropped
+void vtex_set_colors(const texkey *key, const colorlut *lut);
+
+//drop every tile, for when the map itself changes
+void vtex_flush(void);
+
+//start a frame drawn view_height pixels high. Then for each patch of the
+//mesh vtex_lookup gives the finest tile held for it (0 if none, when the
+//face texture does), noting the tile it wants, and vtex_tilematrix sets
+//the texture matrix to map its face texture coords into tile t
+void vtex_begin(int view_height);
+GLuint vtex_lookup(const meshpatch *p, vtile *t);
+void vtex_tilematrix(const vtile *t);
+
+//whether the last frame wanted tiles not yet made, and make the
+//VTEX_BATCH most wanted of them. Returns the number made.
+int vtex_pending(void);
+int vtex_generate(void);
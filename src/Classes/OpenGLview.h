@@ -21,6 +21,8 @@
 *****************************************************************************/
 
 #import "CMBview.h"
+#import "CMBlod.h"
+#import "CMBvtex.h"
 #import "CMBdata.h"
 #import "LittleOpenGLview.h"
 #import "AppController.h"
@@ -38,12 +40,11 @@
 	IBOutlet AppController *myAppController;
 	
 	//viewing state
-	float *v1_display, *v2_display, *v3_display;
-	float *t1_display, *t2_display, *t3_display;
-	float *norm_display;
+	spheremesh lodmesh;
 	float viewTheta, viewPhi, oldviewTheta, oldviewPhi;
 	float viewZoom, maxZoom, minApproach, backgroundRGB[3];
 	int texelInterpolationFlag;
+	BOOL tilesScheduled;
 	float fovy, fovy_render;
 	BOOL orthoEnabledFlag, orthoEnabledFlag_render;
 	
@@ -69,6 +70,7 @@
 	//axis grid state
 	BOOL axis_flag, gridincapsFlag;
 	int GRID_NUM;
+	graticule grid;
 	GLfloat gridRGBA[4];
 	float grid_line_thickness;
 	
@@ -92,6 +94,7 @@
 - (void)drawBorderWithPixnum:(int)bpix
 					   color:(float*)colorvec;
 - (void)draw_interactivemode;
+- (void)generateTiles;
 - (void)draw_rendermode;
 - (void)draw_presentationmode;
 - (void)drawAxes:(float)fovy_current:(BOOL)orthoFlag;
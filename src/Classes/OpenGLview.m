@@ -28,6 +28,16 @@
 #import "OpenGLview.h"
 #import "PreferenceController.h"
 
+//bind tex for drawing, with nearest or linear filtering
+static void bind_texture(GLuint tex, int nearest)
+{
+	GLint filter = nearest ? GL_NEAREST : GL_LINEAR;
+	
+	glBindTexture(GL_TEXTURE_2D,tex);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,filter);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,filter);
+}
+
 @implementation OpenGLview
 
 /**********************************************************************/
@@ -188,22 +198,12 @@
 		
 	glPixelStorei(GL_UNPACK_ALIGNMENT,1);
 	glPixelStorei(GL_PACK_ALIGNMENT,1);
-	glGenTextures(6,face_texs);
+	//(the face texture names come from the texture cache, see CMBtexcache.c)
 	glGenTextures((GLsizei)1,&render_tex);
 	
-	//generate the sphere mesh vertices and the corresponding
-	//texture coords on the circumscribed cube
+	//the sphere mesh is built for each view as it is drawn
 	initcoordsystem();
-	genvertexcoords();
-			
-	//pointers to arrays used in drawing routines
-	v1_display = vector(0,2);
-	v2_display = vector(0,2);
-	v3_display = vector(0,2);
-	t1_display = vector(0,1);
-	t2_display = vector(0,1);
-	t3_display = vector(0,1);
-	norm_display = vector(0,2);
+	lodmesh_init(&lodmesh);
 	
 	//initialize various flags and variables
 	texelInterpolationFlag = [[NSUserDefaults standardUserDefaults] 
@@ -613,48 +613,15 @@
 //observer coord system
 - (void)setup_observer:(float)fovy_current:(BOOL)orthoFlag
 {
-	int a;
-	float viewTheta_rad,viewPhi_rad,zoom,zoomfactor;	
-	
-	viewTheta_rad = PI*(viewTheta/180.0);
-	viewPhi_rad = 2.0*PI*(viewPhi/360.0);
-	obs.view_direction[0] = -cos(viewPhi_rad)*sin(viewTheta_rad);
-	obs.view_direction[1] = -sin(viewPhi_rad)*sin(viewTheta_rad);
-	obs.view_direction[2] = -cos(viewTheta_rad);
-	
-	obs.localy[0] = -cos(viewTheta_rad)*cos(viewPhi_rad);
-	obs.localy[1] = -cos(viewTheta_rad)*sin(viewPhi_rad);
-	obs.localy[2] = sin(viewTheta_rad);	
-	obs.localx[0] = -sin(viewPhi_rad);
-	obs.localx[1] = cos(viewPhi_rad);
-	obs.localx[2] = 0.0;
-		
-	zoom = ([self viewZoom]/5.0);
-	
-	if (!orthoFlag)
-	{
-		maxZoom = 3.0/(float)tan((double)0.5*fovy_current*PI/180.0);
-		zoomfactor = 2.0*(maxZoom-1.0-minApproach)/(zoom+1.0)+2.0-maxZoom+2.0*minApproach;
-		obs.eyedistance_perspective = radius*zoomfactor;
-		for (a=0;a<3;a++) 
-		{
-			obs.view_point[a] = obs.eyedistance_perspective*(-obs.view_direction[a]);
-		}	
-	}
-	else 
-	{
-		obs.eyedistance_ortho = radius*(1.0+minApproach+5.0*(1.0-zoom));
-		for (a=0;a<3;a++) 
-		{
-			obs.view_point[a] = obs.eyedistance_ortho*(-obs.view_direction[a]);
-		}	
-	}
-								
+	observer_setup(&obs,viewTheta,viewPhi,[self viewZoom]/5.0,
+				   fovy_current,orthoFlag,minApproach,&maxZoom);
 }
 
 - (void)draw_interactivemode
 {
-	int a,i,j,vind;
+	int a,i,j,k,vind;
+	GLuint tex;
+	vtile tile;
 	float tex_coords1[2],tex_coords2[2],tex_coords3[2];	
 	float d1[3],d2[3],norm[3],vert1[3],vert2[3],vert3[3];
 	
@@ -700,49 +667,54 @@
 	}
 	glPrioritizeTextures(6, face_texs,priorities);
 	
-	link tlist[6];	
-		
+	lodmesh_update(&lodmesh,&obs,fovy,orthoEnabledFlag);
+	spheremesh_begin(&lodmesh,1);
+	vtex_begin((int)[self bounds].size.height);
 	for (face=0;face<6;face++) 
 	{
-		glBindTexture(GL_TEXTURE_2D,face_texs[face]);		
-		if (texelInterpolationFlag)
+		bind_texture(face_texs[face],texelInterpolationFlag);
+		if (!vtex_enabled())
 		{
-			glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
+			spheremesh_drawface(&lodmesh,face);
+			continue;
 		}
-		else 
-		{
-			glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);	
-		}			
-		
-		glBegin(GL_TRIANGLES);		
-		
-		//point to first node of list 
-		tlist[face] = triangles_on_face[face]->next;		
 		
-		//advance through the list of all the triangles on this face
-		while (tlist[face] != NULL)
+		//patch by patch, each from the finest virtual texture tile held for it
+		for (k=0;k<lodmesh.Npatches;k++)
 		{
-			v1_display = &(tlist[face]->vertex1[0]);
-			v2_display = &(tlist[face]->vertex2[0]);
-			v3_display = &(tlist[face]->vertex3[0]);
-			t1_display = &(tlist[face]->texcoords1[0]);
-			t2_display = &(tlist[face]->texcoords2[0]);
-			t3_display = &(tlist[face]->texcoords3[0]);	
-			norm_display = &(tlist[face]->normal[0]);			
-			
-			if (scalarprod(norm_display,obs.view_direction)<0.0)
-			{				
-				drawtriangle_projected(v1_display, v2_display, v3_display,
-									   t1_display, t2_display, t3_display);
+			if (lodmesh.patch[k].face!=face) continue;
+			if (!(tex = vtex_lookup(&lodmesh.patch[k],&tile)))
+			{
+				spheremesh_drawpatch(&lodmesh,k);
+				continue;
 			}
-			tlist[face] = tlist[face]->next;	
-		}			
-		glEnd();														
+			bind_texture(tex,texelInterpolationFlag);
+			vtex_tilematrix(&tile);
+			spheremesh_drawpatch(&lodmesh,k);
+			glMatrixMode(GL_TEXTURE);
+			glLoadIdentity();
+			glMatrixMode(GL_MODELVIEW);
+			bind_texture(face_texs[face],texelInterpolationFlag);
+		}
+	}
+	spheremesh_end(&lodmesh);
+	
+	//make the tiles still wanted once this frame is on screen
+	if (vtex_pending() && !tilesScheduled)
+	{
+		tilesScheduled = YES;
+		[self performSelector:@selector(generateTiles) withObject:nil afterDelay:0.0];
 	}
 }
 
+//make a batch of the tiles the last frame wanted, and draw again with them
+- (void)generateTiles
+{
+	tilesScheduled = NO;
+	[self makeThisViewCurrentContext];
+	if (vtex_generate()>0) [self setNeedsDisplay:YES];
+}
+
 - (void)setFovy_render:(float)fr
 {
 	fovy_render = fr;
@@ -789,27 +761,11 @@
 	glEnable(GL_POLYGON_OFFSET_FILL);
 	glPolygonOffset(1.0,1.0);
 	
-	link tlist[6];
 	int face;
-	for (face=0;face<6;face++) 
-	{
-		glBegin(GL_TRIANGLES);		
-		tlist[face] = triangles_on_face[face];		
-		while (tlist[face]->next != NULL)
-		{
-			tlist[face] = tlist[face]->next;	
-			v1_display = &(tlist[face]->vertex1[0]);
-			v2_display = &(tlist[face]->vertex2[0]);
-			v3_display = &(tlist[face]->vertex3[0]);
-			norm_display = &(tlist[face]->normal[0]);			
-			
-			if (scalarprod(norm_display,obs.view_direction)<0.0)
-			{				
-				drawtriangle_projected_notex(v1_display, v2_display, v3_display);									   
-			}			
-		}			
-		glEnd();														
-	}
+	lodmesh_update(&lodmesh,&obs,fovy_render,orthoEnabledFlag_render);
+	spheremesh_begin(&lodmesh,0);
+	for (face=0;face<6;face++) spheremesh_drawface(&lodmesh,face);
+	spheremesh_end(&lodmesh);
 	
 	//draw a textured quad to exactly cover the viewport.
 	//blend texture with previously drawn sphere to 
@@ -906,28 +862,11 @@
 	glEnable(GL_POLYGON_OFFSET_FILL);
 	glPolygonOffset(1.0,1.0);
 	
-	link tlist[6];
 	int face;
-	for (face=0;face<6;face++) 
-	{
-		glBegin(GL_TRIANGLES);		
-		tlist[face] = triangles_on_face[face];		
-		
-		while (tlist[face]->next != NULL) 
-		{
-			tlist[face] = tlist[face]->next;	
-			v1_display = &(tlist[face]->vertex1[0]);
-			v2_display = &(tlist[face]->vertex2[0]);
-			v3_display = &(tlist[face]->vertex3[0]);
-			norm_display = &(tlist[face]->normal[0]);			
-			
-			if (scalarprod(norm_display,obs.view_direction)<0.0) 
-			{				
-				drawtriangle_projected_notex(v1_display, v2_display, v3_display);									   
-			}			
-		}			
-		glEnd();														
-	}
+	lodmesh_update(&lodmesh,&obs,fovy_render,orthoEnabledFlag_render);
+	spheremesh_begin(&lodmesh,0);
+	for (face=0;face<6;face++) spheremesh_drawface(&lodmesh,face);
+	spheremesh_end(&lodmesh);
 	
 	//draw a textured quad to exactly cover the viewport.
 	//blend texture with previously drawn sphere to 
@@ -1119,58 +1058,17 @@
 	glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
 	glColor4f(stokesRGBA[0], stokesRGBA[1], stokesRGBA[2], stokesRGBA[3]);		
 	
-	int a,b,c;
-	float spherevec[3], vert1[3], vert2[3], stokelength;
-	double thetas, phis;
+	//StokesLength contains current user selected de-magnification factor, in [0,1]
 	float max_length = 0.5*radius*(max_stokes_arcmin/60.0)*PI/180.0;
-			
-	int nStokes = [myCMBdata NStokes];
-		
-	for (a=0;a<nStokes;a++)
-	{	
-		for (b=0;b<nStokes;b++) 
-		{
-			if (stokes_ptrs.Stokes_mask[a][b]) 
-			{
-				thetas = stokes_ptrs.Stokes_theta_proj[a][b];
-				phis = stokes_ptrs.Stokes_phi_proj[a][b];		
-				
-				//TO DO: these might as well be pre-computed
-				spherevec[0] = (1.0+obs.axisspace) * radius * (float)sin(thetas)*cos(phis);
-				spherevec[1] = (1.0+obs.axisspace) * radius * (float)sin(thetas)*sin(phis);
-				spherevec[2] = (1.0+obs.axisspace) * radius * (float)cos(thetas);
-				
-				//StokesLength contains current user selected de-magnification factor, in [0,1]
-				stokelength = max_length*StokesLength*stokes_ptrs.Stokes_headless_mag[a][b];										
-				for (c=0; c<3; c++)
-				{
-					vert1[c] = (spherevec[c] + stokelength*stokes_ptrs.Stokes_headless[a][b][c]);
-					vert2[c] = (spherevec[c] - stokelength*stokes_ptrs.Stokes_headless[a][b][c]);
-				}
-				
-				glBegin(GL_LINES);
-				glVertex3f(vert1[0],vert1[1],vert1[2]);
-				glVertex3f(vert2[0],vert2[1],vert2[2]);
-				glEnd();						
-			}							
-		}
-	}
+	stokes_draw(&stokes_ptrs,max_length*StokesLength);
+	
 	glLineWidth((GLfloat)1.0);
 	glShadeModel(GL_SMOOTH);
 }
 
-//TO DO: it would be much more efficient to compute the grid vertices once
-//rather than having to call a lot of trig functions every frame.
 - (void)drawAxes:(float)fovy_current:(BOOL)orthoFlag
 {			
 	//if axis button is toggled on, draw axes, which are GRID_NUM lines of longitude and GRID_NUM/2 - 1 lines of latitude	
-	double GRID_SPACE = 360.0/(double)GRID_NUM;
-	
-	int gc_i, gc_j, Ngc_arc;
-	double gc_vec1[3], gc_vec2[3], gc_vec[3], gc_last[3], gc_lambda;
-	double gc_arc, gc_mu, gc_norm, gc_rad, gc_theta1, gc_phi1, gc_theta2;
-    double gc_phi2, gc_theta, gc_theta3, gc_phi;
-	
 	if (axis_flag) 
 	{
 		//glDisable(GL_POLYGON_OFFSET_FILL);
@@ -1201,64 +1099,11 @@
 		gluLookAt(obs.view_point[0],obs.view_point[1],obs.view_point[2],
 				  0.0,0.0,0.0,obs.localy[0],obs.localy[1],obs.localy[2]);	
 		
-		//longitude lines are great circles from pole to pole
-		if (gridincapsFlag) 
-		{
-			gc_theta1 = 0.0;
-			gc_theta3 = M_PI;}
-		else 
-		{
-			gc_theta1 = GRID_SPACE/180.0*M_PI;
-			gc_theta3 = M_PI-gc_theta1;
-		}
-		gc_theta2 = 0.5*M_PI;			
-		Ngc_arc = 32; //numbers of line segments per quarter circle		
-		
-		//prime meridian is plotted with a stippled line
-		gc_phi1 = 0.0;
-		glLineStipple(1,0x3F07);
-		glEnable(GL_LINE_STIPPLE);
-		glBegin(GL_LINE_STRIP);
-		greatcircle(gc_theta1,gc_phi1,gc_theta2,gc_phi1,Ngc_arc);
-		greatcircle(gc_theta2,gc_phi1,gc_theta3,gc_phi1,Ngc_arc);
-		glEnd();				
-		glDisable(GL_LINE_STIPPLE);
-		for (gc_i=1;gc_i<GRID_NUM;gc_i++) 
-		{
-			glBegin(GL_LINE_STRIP);
-			gc_phi1 = (double)gc_i/GRID_NUM * 2.0*M_PI;
-			greatcircle(gc_theta1,gc_phi1,gc_theta2,gc_phi1,Ngc_arc);
-			greatcircle(gc_theta2,gc_phi1,gc_theta3,gc_phi1,Ngc_arc);
-			glEnd();				
-		}
-		
-		//latitude lines are small circles of constant theta
-		for (gc_i=1;gc_i<GRID_NUM/4;gc_i++)
-		{	
-			glBegin(GL_LINE_STRIP);
-			gc_theta1 = (double)gc_i*GRID_SPACE/180.0*M_PI;
-			latitude(gc_theta1,0.0,M_PI,2*Ngc_arc);
-			latitude(gc_theta1,M_PI,2.0*M_PI,2*Ngc_arc);
-			glEnd();				
-		}
-		
-		//draw equator stippled
-		glEnable(GL_LINE_STIPPLE);
-		glBegin(GL_LINE_STRIP);
-		gc_theta1 = (double)0.5*M_PI;
-		latitude(gc_theta1,0.0,M_PI,2*Ngc_arc);
-		latitude(gc_theta1,M_PI,2.0*M_PI,2*Ngc_arc);
-		glEnd();				
-		
-		glDisable(GL_LINE_STIPPLE);
-		for (gc_i=GRID_NUM/4+1;gc_i<GRID_NUM/2;gc_i++)
-		{	
-			glBegin(GL_LINE_STRIP);
-			gc_theta1 = (double)gc_i*GRID_SPACE/180.0*M_PI;
-			latitude(gc_theta1,0.0,M_PI,2*Ngc_arc);
-			latitude(gc_theta1,M_PI,2.0*M_PI,2*Ngc_arc);
-			glEnd();				
-		}
+		//the grid vertices are only recomputed when the grid changes or
+		//the zoom needs a different number of segments
+		graticule_update(&grid,GRID_NUM,gridincapsFlag,obs.axisspace,
+						 graticule_segments(&obs,fovy_current,orthoFlag));
+		graticule_draw(&grid);
 	}
 }
 
@@ -1423,9 +1268,8 @@
 - (void)rightMouseDown:(NSEvent *)event
 {
 	int a,b,k,l,d,ray_flag;
-	double Nray,lray,delta_ray,scalar_llp,fovy_current;
-	double ray[3],lprime[3],wx,wy,raylength,J;
-	double orthox0[3],dp;
+	double Nray,lray,delta_ray,fovy_current;
+	double ray[3],dp;
 	BOOL ortho_current;
 		
 	int render = [myAppController render_mode];	
@@ -1434,35 +1278,16 @@
 	{
 		[self setup_observer:fovy:orthoEnabledFlag];
 		fovy_current = fovy;
-		if (orthoEnabledFlag)
-		{
-			obs.frustum_height = (obs.eyedistance_ortho - radius);
-			ortho_current = YES;
-		}
-		else 
-		{
-			obs.frustum_height = 2.0*obs.near*(float)tan((double)PI*fovy_current/360.0);
-			ortho_current = NO;
-		}		
+		ortho_current = orthoEnabledFlag;
+		observer_frustum(&obs,fovy_current,ortho_current);
 	}
 	else if (render == 2)
 	{
 		[self setup_observer:fovy_render:orthoEnabledFlag_render];
 		fovy_current = fovy_render;
-		if (orthoEnabledFlag_render)
-		{
-			obs.frustum_height = (obs.eyedistance_ortho-radius);
-			ortho_current = YES;
-		}
-		else 
-		{
-			obs.frustum_height = 2.0*obs.near*(float)tan((double)PI*fovy_current/360.0);
-			ortho_current = NO;
-		}		
+		ortho_current = orthoEnabledFlag_render;
+		observer_frustum(&obs,fovy_current,ortho_current);
 	}	
-	obs.frustum_width = obs.aspect_ratio*obs.frustum_height;
-	
-	BOOL intersect_flag;
 	
 	if (render == 1 || render == 2) {	
 
@@ -1471,56 +1296,8 @@
 		lastPoint = currentPoint;
 											
 		//compute where the intersection with sphere occurs, in world coords.
-		wx = 0.5* obs.frustum_width  * (2.0*currentPoint.x/obs.view_width  - 1.0);
-		wy = 0.5* obs.frustum_height * (2.0*currentPoint.y/obs.view_height - 1.0);
-		intersect_flag = NO;
-				
-		if (!ortho_current)
-		{					
-			lprime[0] = obs.near*obs.view_direction[0] 
-			            + wx*obs.localx[0] + wy*obs.localy[0];
-			lprime[1] = obs.near*obs.view_direction[1] 
-				        + wx*obs.localx[1] + wy*obs.localy[1];
-			lprime[2] = obs.near*obs.view_direction[2] 
-				        + wx*obs.localx[2] + wy*obs.localy[2];			
-			normalize_double(lprime);
-			scalar_llp = obs.view_direction[0]*lprime[0]
-					   + obs.view_direction[1]*lprime[1]
-				       + obs.view_direction[2]*lprime[2];
-			
-			J = SQR(scalar_llp)-(1.0-SQR(radius/obs.eyedistance_perspective));			
-			if (J>=0.0)
-			{
-				intersect_flag = YES;
-				raylength = obs.eyedistance_perspective*(scalar_llp-sqrt(J));		
-				ray[0] = obs.view_point[0] + raylength*lprime[0];
-				ray[1] = obs.view_point[1] + raylength*lprime[1];
-				ray[2] = obs.view_point[2] + raylength*lprime[2];				
-				normalize_double(ray);
-			}
-		}		
-		else 
-		{
-			J = SQR(radius)-SQR(wx)-SQR(wy);
-			if (J>=0.0)
-			{	
-				intersect_flag = YES;
-				orthox0[0] = obs.view_point[0] 
-					         + wx*obs.localx[0] + wy*obs.localy[0];
-				orthox0[1] = obs.view_point[1] 
-					         + wx*obs.localx[1] + wy*obs.localy[1];
-				orthox0[2] = obs.view_point[2] 
-					         + wx*obs.localx[2] + wy*obs.localy[2];
-				raylength = obs.eyedistance_ortho-sqrt(J);
-				
-				ray[0] = orthox0[0] + raylength*obs.view_direction[0];
-				ray[1] = orthox0[1] + raylength*obs.view_direction[1];
-				ray[2] = orthox0[2] + raylength*obs.view_direction[2];				
-				normalize_double(ray);
-			}										
-		}
-				
-		if (intersect_flag)
+		if (observer_ray(&obs,ortho_current,currentPoint.x/obs.view_width,
+						 currentPoint.y/obs.view_height,ray))
 		{		
 			down_rightmouse_theta = (float)acos((double)ray[2]);
 			down_rightmouse_phi = (float)atan2((double)ray[1],(double)ray[0]);
@@ -1547,7 +1324,7 @@
 			{		
 				//..find Healpix pixel corresponding to these angles
 				//and write information to text fields in the pixel info box 					
-				size_t pixnum;
+				hpint64 pixnum;
 				int ordering = [myAppController pixelordering];
 				int nside = [myAppController map_nside];
 				if (ordering==0) 
@@ -1561,13 +1338,13 @@
 				
 				//Healpix n
 				NSString *N_pixelinfo_text;
-				N_pixelinfo_text = [[NSString alloc] initWithFormat:@"n: %-9d",pixnum];
+				N_pixelinfo_text = [[NSString alloc] initWithFormat:@"n: %-9lld",(long long)pixnum];
 				[myAppController setPixinfoText_N:N_pixelinfo_text];
 				[N_pixelinfo_text release];
 				
 				//T
 				float Tundermouse;		
-				Tundermouse = hpic_float_get(hpic_Tmap,pixnum);		
+				Tundermouse = pyramid_get(&Tpyramid,pixnum);		
 				NSString *T_pixelinfo_text;
 				T_pixelinfo_text = [[NSString alloc] initWithFormat:@"T:%+5.4e",Tundermouse];
 				[myAppController setPixinfoText_T:T_pixelinfo_text];
@@ -1578,14 +1355,14 @@
 					float Qundermouse, Uundermouse, Pundermouse;
 					
 					//Q
-					Qundermouse = hpic_float_get(hpic_Qmap,pixnum);		
+					Qundermouse = pyramid_get(&Qpyramid,pixnum);		
 					NSString *Q_pixelinfo_text;
 					Q_pixelinfo_text = [[NSString alloc] initWithFormat:@"Q:%+5.4e",Qundermouse];
 					[myAppController setPixinfoText_Q:Q_pixelinfo_text];
 					[Q_pixelinfo_text release];
 					
 					//U
-					Uundermouse = hpic_float_get(hpic_Umap,pixnum);		
+					Uundermouse = pyramid_get(&Upyramid,pixnum);		
 					NSString *U_pixelinfo_text;
 					U_pixelinfo_text = [[NSString alloc] initWithFormat:@"U:%+5.4e",Uundermouse];
 					[myAppController setPixinfoText_U:U_pixelinfo_text];
@@ -1602,7 +1379,7 @@
 				{
 					float Qundermouse, Uundermouse, Pundermouse;
 					//N
-					Qundermouse = hpic_float_get(hpic_Qmap,pixnum);		
+					Qundermouse = pyramid_get(&Qpyramid,pixnum);		
 					NSString *Q_pixelinfo_text;
 					Q_pixelinfo_text = [[NSString alloc] initWithFormat:@"N:%+5.4e",Qundermouse];
 					[myAppController setPixinfoText_Q:Q_pixelinfo_text];
@@ -38,65 +38,59 @@
 //Note, I (JP) have modified the name of this routine to avoid
 //a clash with an hpic function name
 
-inline void heal_ang2pix_nest( const long nside, double theta, double phi, long *ipix) {
+inline void heal_ang2pix_nest( const hpint64 nside, double theta, double phi, hpint64 *ipix) {
 
   /* =======================================================================
    * subroutine ang2pix_nest(nside, theta, phi, ipix)
    * =======================================================================
    * gives the pixel number ipix (NESTED) corresponding to angles theta and phi
    *
-   * the computation is made to the highest resolution available (nside=8192)
-   * and then degraded to that required (by integer division)
-   * this doesn't cost more, and it makes sure that the treatement of round-off 
-   * will be consistent for every resolution
+   * the original computation was made at the highest resolution available
+   * (nside=8192) and then degraded to that required, to make the round-off
+   * consistent for every resolution. nside is a power of 2, so scaling by
+   * ns_max/nside is exact in floating point and working at nside directly
+   * gives the same pixels, with no upper limit from ns_max (JP)
    * =======================================================================
    */
   
   double z, za, z0, tt, tp, tmp;
-  int    face_num,jp,jm;
-  long   ifp, ifm;
-  int    ix, iy, ix_low, ix_hi, iy_low, iy_hi, ipf, ntt;
+  int    face_num, ntt;
+  hpint64 jp, jm, ifp, ifm, ix, iy;
   double piover2 = 0.5*M_PI, pi = M_PI, twopi = 2.0*M_PI;
-  int    ns_max = 8192;
-  static int x2pix[128], y2pix[128];
-  static char setup_done = 0;
   
-  if( nside<1 || nside>ns_max ) {
-    fprintf(stderr, "%s (%d): nside out of range: %ld\n", __FILE__, __LINE__, nside);
+  if( nside<1 || nside>HEAL_NS_MAX || (nside & (nside-1))!=0 ) {
+    fprintf(stderr, "%s (%d): nside out of range: %lld\n", __FILE__, __LINE__, (long long)nside);
     exit(0);
   }
   if( theta<0. || theta>pi ) {
     fprintf(stderr, "%s (%d): theta out of range: %f\n", __FILE__, __LINE__, theta);
     exit(0);
   }
-  if( !setup_done ) {
-    mk_xy2pix(x2pix,y2pix);
-    setup_done = 1;
-  }
   
   z  = cos(theta);
   za = fabs(z);
   z0 = 2./3.;
   if( phi>=twopi ) phi = phi - twopi;
   if( phi<0. )    phi = phi + twopi;
+  if( phi>=twopi ) phi = 0.; /* a tiny negative phi rounds up to 2pi (JP) */
   tt = phi / piover2; /* in [0,4[ */
   
   if( za<=z0 ) { /* equatorial region */
     
     /* (the index of edge lines increase when the longitude=phi goes up) */
-    jp = (int)floor(ns_max*(0.5 + tt - z*0.75)); /* ascending edge line index */
-    jm = (int)floor(ns_max*(0.5 + tt + z*0.75)); /* descending edge line index */
+    jp = (hpint64)floor(nside*(0.5 + tt - z*0.75)); /* ascending edge line index */
+    jm = (hpint64)floor(nside*(0.5 + tt + z*0.75)); /* descending edge line index */
     
     /* finds the face */
-    ifp = jp / ns_max; /* in {0,4} */
-    ifm = jm / ns_max;
+    ifp = jp / nside; /* in {0,4} */
+    ifm = jm / nside;
     
-    if( ifp==ifm ) face_num = (int)fmod(ifp,4) + 4; /* faces 4 to 7 */
-    else if( ifp<ifm ) face_num = (int)fmod(ifp,4); /* (half-)faces 0 to 3 */
-    else face_num = (int)fmod(ifm,4) + 8;           /* (half-)faces 8 to 11 */
+    if( ifp==ifm ) face_num = (int)(ifp & 3) + 4; /* faces 4 to 7 */
+    else if( ifp<ifm ) face_num = (int)(ifp & 3); /* (half-)faces 0 to 3 */
+    else face_num = (int)(ifm & 3) + 8;           /* (half-)faces 8 to 11 */
     
-    ix = (int)fmod(jm, ns_max);
-    iy = ns_max - (int)fmod(jp, ns_max) - 1;
+    ix = jm & (nside-1);
+    iy = nside - (jp & (nside-1)) - 1;
   }
   else { /* polar region, za > 2/3 */
     
@@ -109,18 +103,18 @@ inline void heal_ang2pix_nest( const long nside, double theta, double phi, long
      * goes up)
      */
     /* line going toward the pole as phi increases */
-    jp = (int)floor( ns_max * tp          * tmp ); 
+    jp = (hpint64)floor( nside * tp          * tmp ); 
 
     /* that one goes away of the closest pole */
-    jm = (int)floor( ns_max * (1. - tp) * tmp );
-    jp = (int)(jp < ns_max-1 ? jp : ns_max-1);
-    jm = (int)(jm < ns_max-1 ? jm : ns_max-1);
+    jm = (hpint64)floor( nside * (1. - tp) * tmp );
+    jp = (jp < nside-1 ? jp : nside-1);
+    jm = (jm < nside-1 ? jm : nside-1);
     
     /* finds the face and pixel's (x,y) */
     if( z>=0 ) {
       face_num = ntt; /* in {0,3} */
-      ix = ns_max - jm - 1;
-      iy = ns_max - jp - 1;
+      ix = nside - jm - 1;
+      iy = nside - jp - 1;
     }
     else {
       face_num = ntt + 8; /* in {8,11} */
@@ -129,12 +123,6 @@ inline void heal_ang2pix_nest( const long nside, double theta, double phi, long
     }
   }
   
-  ix_low = (int)fmod(ix,128);
-  ix_hi  =     ix/128;
-  iy_low = (int)fmod(iy,128);
-  iy_hi  =     iy/128;
-
-  ipf = (x2pix[ix_hi]+y2pix[iy_hi]) * (128 * 128)+ (x2pix[ix_low]+y2pix[iy_low]);
-  ipf = (long)(ipf / pow(ns_max/nside,2));     /* in {0, nside**2 - 1} */
-  *ipix =(long)( ipf + face_num*pow(nside,2)); /* in {0, 12*nside**2 - 1} */
+  /* in {0, 12*nside**2 - 1} */
+  *ipix = (hpint64)(heal_spread_bits(ix) + 2*heal_spread_bits(iy)) + face_num*nside*nside;
 }
@@ -38,7 +38,7 @@
 //Note, I (JP) have modified the name of this routine to avoid
 //a clash with an hpic function name
 
-inline void heal_ang2pix_ring( const long nside, double theta, double phi, long *ipix) {
+inline void heal_ang2pix_ring( const hpint64 nside, double theta, double phi, hpint64 *ipix) {
   /*
     c=======================================================================
     c     gives the pixel number ipix (RING) 
@@ -46,18 +46,17 @@ inline void heal_ang2pix_ring( const long nside, double theta, double phi, long
     c=======================================================================
   */
   
-  int nl2, nl4, ncap, npix, jp, jm, ipix1;
+  hpint64 nl2, nl4, ncap, npix, jp, jm, ipix1;
   double  z, za, tt, tp, tmp;
-  int ir, ip, kshift;
+  hpint64 ir, ip, kshift;
   
   double piover2 = 0.5*M_PI;
   double PI=M_PI;
   double twopi=2.0*M_PI;
   double z0=2.0/3.0;
-  long ns_max=8192;
   
-  if( nside<1 || nside>ns_max ) {
-    fprintf(stderr, "%s (%d): nside out of range: %ld\n", __FILE__, __LINE__, nside);
+  if( nside<1 || nside>HEAL_NS_MAX ) {
+    fprintf(stderr, "%s (%d): nside out of range: %lld\n", __FILE__, __LINE__, (long long)nside);
     exit(0);
   }
   
@@ -70,6 +69,7 @@ inline void heal_ang2pix_ring( const long nside, double theta, double phi, long
   za = fabs(z);
   if( phi >= twopi)  phi = phi - twopi;
   if (phi < 0.)     phi = phi + twopi;
+  if( phi>=twopi ) phi = 0.; /* a tiny negative phi rounds up to 2pi (JP) */
   tt = phi / piover2;//  ! in [0,4)
   
   nl2 = 2*nside;
@@ -79,14 +79,13 @@ inline void heal_ang2pix_ring( const long nside, double theta, double phi, long
   
   if( za <= z0 ) {
     
-    jp = (int)floor(nside*(0.5 + tt - z*0.75)); /*index of ascending edge line*/
-    jm = (int)floor(nside*(0.5 + tt + z*0.75)); /*index of descending edge line*/
+    jp = (hpint64)floor(nside*(0.5 + tt - z*0.75)); /*index of ascending edge line*/
+    jm = (hpint64)floor(nside*(0.5 + tt + z*0.75)); /*index of descending edge line*/
     
     ir = nside + 1 + jp - jm;// ! in {1,2n+1} (ring number counted from z=2/3)
-    kshift = 0;
-    if (fmod(ir,2)==0.) kshift = 1;// ! kshift=1 if ir even, 0 otherwise
+    kshift = 1 - (ir & 1);// ! kshift=1 if ir even, 0 otherwise
     
-    ip = (int)floor( ( jp+jm - nside + kshift + 1 ) / 2 ) + 1;// ! in {1,4n}
+    ip = ( jp+jm - nside + kshift + 1 ) / 2 + 1;// ! in {1,4n}
     if( ip>nl4 ) ip = ip - nl4;
     
     ipix1 = ncap + nl4*(ir-1) + ip ;
@@ -96,11 +95,11 @@ inline void heal_ang2pix_ring( const long nside, double theta, double phi, long
     tp = tt - floor(tt);//      !MOD(tt,1.d0)
     tmp = sqrt( 3.*(1. - za) );
     
-    jp = (int)floor( nside * tp * tmp );// ! increasing edge line index
-    jm = (int)floor( nside * (1. - tp) * tmp );// ! decreasing edge line index
+    jp = (hpint64)floor( nside * tp * tmp );// ! increasing edge line index
+    jm = (hpint64)floor( nside * (1. - tp) * tmp );// ! decreasing edge line index
     
     ir = jp + jm + 1;//        ! ring number counted from the closest pole
-    ip = (int)floor( tt * ir ) + 1;// ! in {1,4*ir}
+    ip = (hpint64)floor( tt * ir ) + 1;// ! in {1,4*ir}
     if( ip>4*ir ) ip = ip - 4*ir;
     
     ipix1 = 2*ir*(ir-1) + ip;
@@ -34,6 +34,11 @@
 #ifndef __CHEALPIX_H__
 #define __CHEALPIX_H__
 
+#include <stdint.h>
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
 /* -------------------- */
 /* Constant Definitions */
 /* -------------------- */
@@ -42,6 +47,30 @@
 #define HEALPIX_NULLVAL (-1.6375e30)
 #endif /* HEALPIX_NULLVAL */
 
+/* largest nside supported: 12*nside^2 pixels must fit in 64 bits, and
+   4*nside in the mantissa of a double with room to spare (CMBview) */
+#define HEAL_NS_MAX (1L<<29)
+
+/* 64 bit pixel indices, so maps above nside 8192 can be addressed */
+typedef int64_t hpint64;
+
+/* interleave the low 32 bits of x with zeros, giving the nested index
+   bits of a face x coordinate (CMBview; replaces the x2pix/y2pix tables) */
+static inline uint64_t heal_spread_bits(uint64_t x)
+{
+#if defined(__BMI2__) && defined(__x86_64__)
+  return _pdep_u64(x, 0x5555555555555555ULL);
+#else
+  x &= 0xFFFFFFFFULL;
+  x = (x | (x << 16)) & 0x0000FFFF0000FFFFULL;
+  x = (x | (x << 8))  & 0x00FF00FF00FF00FFULL;
+  x = (x | (x << 4))  & 0x0F0F0F0F0F0F0F0FULL;
+  x = (x | (x << 2))  & 0x3333333333333333ULL;
+  x = (x | (x << 1))  & 0x5555555555555555ULL;
+  return x;
+#endif
+}
+
 /* --------------------- */
 /* Function Declarations */
 /* --------------------- */
@@ -51,10 +80,13 @@
 
 //Note, I (JP) have modified the name of these 2 routines to avoid
 //a clash with hpic function names
-void heal_ang2pix_nest(const long nside, double theta, double phi, long *ipix);
-void heal_ang2pix_ring(const long nside, double theta, double phi, long *ipix);
+void heal_ang2pix_nest(const hpint64 nside, double theta, double phi, hpint64 *ipix);
+void heal_ang2pix_ring(const hpint64 nside, double theta, double phi, hpint64 *ipix);
 
-void mk_xy2pix(int *x2pix, int *y2pix);
+//as above, but from a direction vector (x,y,z), avoiding the
+//acos/atan2 -> cos round trip (CMBview)
+void heal_vec2pix_nest(const hpint64 nside, const double *vec, hpint64 *ipix);
+void heal_vec2pix_ring(const hpint64 nside, const double *vec, hpint64 *ipix);
 
 /* ------------------ */
 /* end of header file */
@@ -1,67 +0,0 @@
-/* -----------------------------------------------------------------------------
- *
- *  Copyright (C) 1997-2005 Krzysztof M. Gorski, Eric Hivon, 
- *                          Benjamin D. Wandelt, Anthony J. Banday, 
- *                          Matthias Bartelmann, 
- *                          Reza Ansari & Kenneth M. Ganga 
- *
- *
- *  This file is part of HEALPix.
- *
- *  HEALPix is free software; you can redistribute it and/or modify
- *  it under the terms of the GNU General Public License as published by
- *  the Free Software Foundation; either version 2 of the License, or
- *  (at your option) any later version.
- *
- *  HEALPix is distributed in the hope that it will be useful,
- *  but WITHOUT ANY WARRANTY; without even the implied warranty of
- *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
- *  GNU General Public License for more details.
- *
- *  You should have received a copy of the GNU General Public License
- *  along with HEALPix; if not, write to the Free Software
- *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
- *
- *  For more information about HEALPix see http://healpix.jpl.nasa.gov
- *
- *----------------------------------------------------------------------------- */
-/* Standard Includes */
-#include <math.h>
-#include "chealpix.h"
-
-inline void mk_xy2pix(int *x2pix, int *y2pix) {
-  /* =======================================================================
-   * subroutine mk_xy2pix
-   * =======================================================================
-   * sets the array giving the number of the pixel lying in (x,y)
-   * x and y are in {1,128}
-   * the pixel number is in {0,128**2-1}
-   *
-   * if  i-1 = sum_p=0  b_p * 2^p
-   * then ix = sum_p=0  b_p * 4^p
-   * iy = 2*ix
-   * ix + iy in {0, 128**2 -1}
-   * =======================================================================
-   */
-  int i, K,IP,I,J,ID;
-  
-  for(i = 0; i < 127; i++) x2pix[i] = 0;
-  for( I=1;I<=128;I++ ) {
-    J  = I-1;//            !pixel numbers
-    K  = 0;//
-    IP = 1;//
-    truc : if( J==0 ) {
-      x2pix[I-1] = K;
-      y2pix[I-1] = 2*K;
-    }
-    else {
-      ID = (int)fmod(J,2);
-      J  = J/2;
-      K  = IP*ID+K;
-      IP = IP*4;
-      goto truc;
-    }
-  }     
-  
-}
-
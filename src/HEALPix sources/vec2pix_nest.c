@@ -0,0 +1,129 @@
+/* -----------------------------------------------------------------------------
+ *
+ *  Copyright (C) 1997-2005 Krzysztof M. Gorski, Eric Hivon, 
+ *                          Benjamin D. Wandelt, Anthony J. Banday, 
+ *                          Matthias Bartelmann, 
+ *                          Reza Ansari & Kenneth M. Ganga 
+ *
+ *
+ *  This file is part of HEALPix.
+ *
+ *  HEALPix is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  HEALPix is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with HEALPix; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *  For more information about HEALPix see http://healpix.jpl.nasa.gov
+ *
+ *----------------------------------------------------------------------------- */
+/* vec2pix_nest.c
+ *
+ */
+
+/* Standard Includes */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Local Includes */
+#include "chealpix.h"
+
+//Note, I (JP) have named this routine to match heal_ang2pix_nest.
+//It takes the direction as a vector, so the caller does not need
+//acos/atan2 and this routine does not need cos(theta)
+
+inline void heal_vec2pix_nest( const hpint64 nside, const double *vec, hpint64 *ipix) {
+
+  /* =======================================================================
+   * subroutine vec2pix_nest(nside, vec, ipix)
+   * =======================================================================
+   * gives the pixel number ipix (NESTED) corresponding to the direction vec
+   * (need not be normalized)
+   *
+   * as in heal_ang2pix_nest, the computation is made directly at nside,
+   * which gives the same pixels as working at a higher power of 2 and
+   * degrading
+   * =======================================================================
+   */
+
+  double z, za, z0, tt, tp, tmp, dnorm, rxy2, phi;
+  int    face_num, ntt;
+  hpint64 jp, jm, ifp, ifm, ix, iy;
+  double piover2 = 0.5*M_PI, twopi = 2.0*M_PI;
+
+  if( nside<1 || nside>HEAL_NS_MAX || (nside & (nside-1))!=0 ) {
+    fprintf(stderr, "%s (%d): nside out of range: %lld\n", __FILE__, __LINE__, (long long)nside);
+    exit(0);
+  }
+
+  rxy2 = vec[0]*vec[0] + vec[1]*vec[1];
+  dnorm = sqrt( rxy2 + vec[2]*vec[2] );
+  if( dnorm==0. ) {
+    fprintf(stderr, "%s (%d): null vector\n", __FILE__, __LINE__);
+    exit(0);
+  }
+  z  = vec[2] / dnorm;
+  za = fabs(z);
+  z0 = 2./3.;
+
+  phi = 0.;
+  if( vec[0]!=0. || vec[1]!=0. ) phi = atan2(vec[1],vec[0]); /* in ]-pi,pi] */
+  if( phi<0. ) phi = phi + twopi;
+  tt = phi / piover2; /* in [0,4] */
+  if( tt>=4. ) tt = 0.;
+
+  if( za<=z0 ) { /* equatorial region */
+
+    /* (the index of edge lines increase when the longitude=phi goes up) */
+    jp = (hpint64)floor(nside*(0.5 + tt - z*0.75)); /* ascending edge line index */
+    jm = (hpint64)floor(nside*(0.5 + tt + z*0.75)); /* descending edge line index */
+
+    /* finds the face */
+    ifp = jp / nside; /* in {0,4} */
+    ifm = jm / nside;
+
+    if( ifp==ifm ) face_num = (int)(ifp & 3) + 4; /* faces 4 to 7 */
+    else if( ifp<ifm ) face_num = (int)(ifp & 3); /* (half-)faces 0 to 3 */
+    else face_num = (int)(ifm & 3) + 8;           /* (half-)faces 8 to 11 */
+
+    ix = jm & (nside-1);
+    iy = nside - (jp & (nside-1)) - 1;
+  }
+  else { /* polar region, za > 2/3 */
+
+    ntt = (int)floor(tt);
+    if( ntt>=4 ) ntt = 3;
+    tp = tt - ntt;
+    /* 3(1-za) from the vector itself, which keeps its precision at the poles */
+    tmp = sqrt( 3.*rxy2 / (dnorm*(dnorm + fabs(vec[2]))) ); /* in ]0,1] */
+
+    jp = (hpint64)floor( nside * tp          * tmp );
+    jm = (hpint64)floor( nside * (1. - tp) * tmp );
+    jp = (jp < nside-1 ? jp : nside-1);
+    jm = (jm < nside-1 ? jm : nside-1);
+
+    /* finds the face and pixel's (x,y) */
+    if( z>=0 ) {
+      face_num = ntt; /* in {0,3} */
+      ix = nside - jm - 1;
+      iy = nside - jp - 1;
+    }
+    else {
+      face_num = ntt + 8; /* in {8,11} */
+      ix =  jp;
+      iy =  jm;
+    }
+  }
+
+  /* in {0, 12*nside**2 - 1} */
+  *ipix = (hpint64)(heal_spread_bits(ix) + 2*heal_spread_bits(iy)) + face_num*nside*nside;
+}
@@ -0,0 +1,117 @@
+/* -----------------------------------------------------------------------------
+ *
+ *  Copyright (C) 1997-2005 Krzysztof M. Gorski, Eric Hivon, 
+ *                          Benjamin D. Wandelt, Anthony J. Banday, 
+ *                          Matthias Bartelmann, 
+ *                          Reza Ansari & Kenneth M. Ganga 
+ *
+ *
+ *  This file is part of HEALPix.
+ *
+ *  HEALPix is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  HEALPix is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with HEALPix; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *  For more information about HEALPix see http://healpix.jpl.nasa.gov
+ *
+ *----------------------------------------------------------------------------- */
+/* vec2pix_ring.c
+ *
+ */
+
+/* Standard Includes */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Local Includes */
+#include "chealpix.h"
+
+//Note, I (JP) have named this routine to match heal_ang2pix_ring.
+//It takes the direction as a vector, so the caller does not need
+//acos/atan2 and this routine does not need cos(theta)
+
+inline void heal_vec2pix_ring( const hpint64 nside, const double *vec, hpint64 *ipix) {
+  /*
+    c=======================================================================
+    c     gives the pixel number ipix (RING)
+    c     corresponding to the direction vec (need not be normalized)
+    c=======================================================================
+  */
+
+  hpint64 nl4, ncap, npix, jp, jm, ipix1;
+  double  z, za, tt, tp, tmp, dnorm, rxy2, phi;
+  hpint64 ir, ip, kshift;
+
+  double piover2 = 0.5*M_PI;
+  double twopi=2.0*M_PI;
+  double z0=2.0/3.0;
+
+  if( nside<1 || nside>HEAL_NS_MAX ) {
+    fprintf(stderr, "%s (%d): nside out of range: %lld\n", __FILE__, __LINE__, (long long)nside);
+    exit(0);
+  }
+
+  rxy2 = vec[0]*vec[0] + vec[1]*vec[1];
+  dnorm = sqrt( rxy2 + vec[2]*vec[2] );
+  if( dnorm==0. ) {
+    fprintf(stderr, "%s (%d): null vector\n", __FILE__, __LINE__);
+    exit(0);
+  }
+  z = vec[2] / dnorm;
+  za = fabs(z);
+
+  phi = 0.;
+  if( vec[0]!=0. || vec[1]!=0. ) phi = atan2(vec[1],vec[0]); /* in ]-pi,pi] */
+  if( phi<0. ) phi = phi + twopi;
+  tt = phi / piover2;//  ! in [0,4]
+  if( tt>=4. ) tt = 0.;
+
+  nl4 = 4*nside;
+  ncap  = 2*nside*(nside-1);// ! number of pixels in the north polar cap
+  npix  = 12*nside*nside;
+
+  if( za <= z0 ) {
+
+    jp = (hpint64)floor(nside*(0.5 + tt - z*0.75)); /*index of ascending edge line*/
+    jm = (hpint64)floor(nside*(0.5 + tt + z*0.75)); /*index of descending edge line*/
+
+    ir = nside + 1 + jp - jm;// ! in {1,2n+1} (ring number counted from z=2/3)
+    kshift = 1 - (ir & 1);// ! kshift=1 if ir even, 0 otherwise
+
+    ip = ( jp+jm - nside + kshift + 1 ) / 2 + 1;// ! in {1,4n}
+    if( ip>nl4 ) ip = ip - nl4;
+
+    ipix1 = ncap + nl4*(ir-1) + ip ;
+  }
+  else {
+
+    tp = tt - floor(tt);//      !MOD(tt,1.d0)
+    /* 3(1-za) from the vector itself, which keeps its precision at the poles */
+    tmp = sqrt( 3.*rxy2 / (dnorm*(dnorm + fabs(vec[2]))) );
+
+    jp = (hpint64)floor( nside * tp * tmp );// ! increasing edge line index
+    jm = (hpint64)floor( nside * (1. - tp) * tmp );// ! decreasing edge line index
+
+    ir = jp + jm + 1;//        ! ring number counted from the closest pole
+    ip = (hpint64)floor( tt * ir ) + 1;// ! in {1,4*ir}
+    if( ip>4*ir ) ip = ip - 4*ir;
+
+    ipix1 = 2*ir*(ir-1) + ip;
+    if( z<=0. ) {
+      ipix1 = npix - 2*ir*(ir+1) + ip;
+    }
+  }
+  *ipix = ipix1 - 1;// ! in {0, npix-1}
+
+}
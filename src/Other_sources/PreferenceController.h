@@ -16,6 +16,11 @@
 //preference keys
 extern NSString *CMBview_texnumkey;
 extern NSString *CMBview_texinterpolatekey;
+extern NSString *CMBview_pixtablecachekey;
+extern NSString *CMBview_texcachekey;
+extern NSString *CMBview_rendercachekey;
+extern NSString *CMBview_antialiaskey;
+extern NSString *CMBview_vtexkey;
 extern NSString *CMBview_backgrndcolorkey;
 extern NSString *CMBview_fovykey;
 extern NSString *CMBview_orthokey; 
@@ -40,6 +45,7 @@ extern NSString *CMBview_lightphikey;
 extern NSString *CMBview_colormapchoicekey;
 extern NSString *CMBview_colormapreversekey;
 extern NSString *CMBview_stokesgridkey;
+extern NSString *CMBview_stokesequalareakey;
 extern NSString *CMBview_stokespropskey; 
 extern NSString *CMBview_gridspacekey;
 extern NSString *CMBview_gridpropskey;
@@ -55,6 +61,7 @@ extern NSString *CMBview_gridpropskey;
 	IBOutlet NSTextField *mousesensitivityslider_text;
 	IBOutlet NSSlider *exportimagesize;
 	IBOutlet NSTextField *exportimagesize_text;
+	IBOutlet NSMatrix *antialias_matrix;
 	IBOutlet NSColorWell *presentationbackgrndColorWell;
 	IBOutlet NSColorWell *presentationtextColorWell;
 
@@ -98,6 +105,7 @@ extern NSString *CMBview_gridpropskey;
 	IBOutlet NSTextField *stokesopacity_text;
 	IBOutlet NSTextField *stokeslength_text;
 	IBOutlet NSMatrix *stokesconvention_matrix;
+	IBOutlet NSButton *stokesequalarea;
 	
 	//grid panel
 	IBOutlet NSStepper *grid_index;
@@ -123,6 +131,8 @@ extern NSString *CMBview_gridpropskey;
 - (float)MouseSensitivity;
 - (IBAction)changeExportimagesize:(id)sender;
 - (int)exportimagesize;
+- (IBAction)changeAntialias:(id)sender;
+- (int)antialias;
 - (NSColor *)presentationbackgrndColor;
 - (IBAction)changePresentationbackgrndColor:(id)sender;
 - (NSColor *)presentationtextColor;
@@ -183,6 +193,8 @@ extern NSString *CMBview_gridpropskey;
 - (int)stokesNum;
 - (NSMutableArray *)stokesProps;
 - (IBAction)changeStokesNum:(id)sender;
+- (BOOL)stokesEqualArea;
+- (IBAction)changeStokesEqualArea:(id)sender;
 - (IBAction)changeStokesOpacity:(id)sender;
 - (IBAction)changeStokesColor:(id)sender;
 - (IBAction)changeStokesThickness:(id)sender;
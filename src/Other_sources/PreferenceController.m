@@ -18,9 +18,14 @@ NSString *CMBview_mousesensitivitykey = @"mousesensitivity";
 NSString *CMBview_presentationbackgrndcolorkey = @"presentationbackgrndcolor";
 NSString *CMBview_presentationtextcolorkey = @"presentationtextcolor";
 NSString *CMBview_exportimagesizekey = @"exportimagesize";
+NSString *CMBview_antialiaskey = @"antialias";
 //textures panel
 NSString *CMBview_texnumkey = @"Ntexture";
 NSString *CMBview_texinterpolatekey = @"texinterpolate";
+NSString *CMBview_pixtablecachekey = @"pixtablecache";
+NSString *CMBview_texcachekey = @"texturecache";
+NSString *CMBview_rendercachekey = @"rendercache";
+NSString *CMBview_vtexkey = @"virtualtexture";
 //lighting panel
 NSString *CMBview_ambientlightkey = @"ambientlightColor";
 NSString *CMBview_diffuselightkey = @"diffuselightColor";
@@ -41,6 +46,7 @@ NSString *CMBview_colormapchoicekey = @"colormapchoice";
 NSString *CMBview_colormapreversekey = @"colormapreverse";
 //stokes panel
 NSString *CMBview_stokesgridkey = @"stokesgrid"; 
+NSString *CMBview_stokesequalareakey = @"stokesequalarea";
 NSString *CMBview_stokespropskey = @"stokesprops"; 
 //grid panel
 NSString *CMBview_gridspacekey = @"gridspace"; 
@@ -91,6 +97,8 @@ NSString *CMBview_gridpropskey = @"gridprops";
 		exportimagesizeValue];
 	[exportimagesize_text setStringValue:export_text];
 	[export_text release];	
+	
+	[antialias_matrix selectCellWithTag:[self antialias]];
 			
 	//grid panel
 	int gridnum = [self GridSpacing];
@@ -208,6 +216,8 @@ NSString *CMBview_gridpropskey = @"gridprops";
 	[stokesnum_text setStringValue:stokes_text];
 	[stokes_text release];
 	
+	[stokesequalarea setState:[self stokesEqualArea]];
+	
 	NSMutableArray *myMutableArray2 = [self stokesProps];
 	enum stokesproperties sp2; 
 		
@@ -257,6 +267,11 @@ NSString *CMBview_gridpropskey = @"gridprops";
 		
 		[defaults removeObjectForKey:CMBview_texnumkey];
 		[defaults removeObjectForKey:CMBview_texinterpolatekey];
+		[defaults removeObjectForKey:CMBview_pixtablecachekey];
+		[defaults removeObjectForKey:CMBview_texcachekey];
+		[defaults removeObjectForKey:CMBview_rendercachekey];
+		[defaults removeObjectForKey:CMBview_antialiaskey];
+		[defaults removeObjectForKey:CMBview_vtexkey];
 		[defaults removeObjectForKey:CMBview_backgrndcolorkey];
 		[defaults removeObjectForKey:CMBview_fovykey];
 		[defaults removeObjectForKey:CMBview_orthokey ];
@@ -281,6 +296,7 @@ NSString *CMBview_gridpropskey = @"gridprops";
 		[defaults removeObjectForKey:CMBview_colormapchoicekey];
 		[defaults removeObjectForKey:CMBview_colormapreversekey];
 		[defaults removeObjectForKey:CMBview_stokesgridkey];
+		[defaults removeObjectForKey:CMBview_stokesequalareakey];
 		[defaults removeObjectForKey:CMBview_stokespropskey];
 		[defaults removeObjectForKey:CMBview_gridspacekey];
 		[defaults removeObjectForKey:CMBview_gridpropskey];
@@ -411,6 +427,24 @@ NSString *CMBview_gridpropskey = @"gridprops";
 				 forKey:CMBview_exportimagesizekey];	
 }
 
+- (int)antialias
+{
+	NSUserDefaults *defaults;		
+	defaults = [NSUserDefaults standardUserDefaults];
+	return [defaults integerForKey:CMBview_antialiaskey];
+}
+
+//read when the next view is traced or exported, so nothing is notified
+- (IBAction)changeAntialias:(id)sender
+{
+	int antialiasValue = [[sender selectedCell] tag];
+	
+	NSUserDefaults *defaults;		
+	defaults = [NSUserDefaults standardUserDefaults];
+	[defaults setObject:[NSNumber numberWithInt:antialiasValue]
+				 forKey:CMBview_antialiaskey];	
+}
+
 - (NSColor *)presentationbackgrndColor
 {
 	NSUserDefaults *defaults;
@@ -647,6 +681,18 @@ NSString *CMBview_gridpropskey = @"gridprops";
 				 forKey:CMBview_stokesgridkey];	
 }
 
+- (BOOL)stokesEqualArea
+{
+	NSUserDefaults *defaults;		
+	defaults = [NSUserDefaults standardUserDefaults];
+	return [defaults boolForKey:CMBview_stokesequalareakey];
+}
+- (IBAction)changeStokesEqualArea:(id)sender
+{
+	[[NSUserDefaults standardUserDefaults] setBool:[sender state]
+											forKey:CMBview_stokesequalareakey];
+}
+
 - (NSMutableArray *)stokesProps
 {
 	NSUserDefaults *defaults;		
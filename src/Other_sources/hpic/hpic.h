@@ -68,7 +68,11 @@ extern "C" {
 #  ifdef HPIC_NSIDE_MAX
 #    undef HPIC_NSIDE_MAX
 #  endif                        /* max nside value */
-#  define HPIC_NSIDE_MAX 8192
+#  if defined(__LP64__) || defined(_LP64)
+#    define HPIC_NSIDE_MAX ((size_t)1 << 29)
+#  else
+#    define HPIC_NSIDE_MAX ((size_t)8192)
+#  endif
 
 #  ifdef HPIC_STRNL
 #    undef HPIC_STRNL
@@ -132,6 +136,11 @@ extern "C" {
 #  endif                        /* automatically switch memory structure based on map size */
 #  define HPIC_AUTO 2
 
+#  ifdef HPIC_TREE_LEAFSHIFT
+#    undef HPIC_TREE_LEAFSHIFT
+#  endif                        /* tree leaves are 2^this pixels on a side */
+#  define HPIC_TREE_LEAFSHIFT 4
+
 /* vector parameters */
 
 #  ifdef HPIC_VECBUF
@@ -300,33 +309,33 @@ static hpic_error_handler_t * hpic_error_handler = NULL;
   
 /* tree structures */
 
-/* The children are void pointers so that they can EITHER point to other     */
-/* nodes OR point to a pixel value (if they are a leaf node).  Since the     */
-/* trees are only descended, there is no need for a link to the parent node. */
+/* Each of the 12 base pixels is a quad tree in NEST order, whose bottom     */
+/* level is leaves: dense blocks of 4^leafshift NEST pixels, null where     */
+/* nothing was set.  Nodes and leaves come from two pools that grow by      */
+/* doubling and refer to each other by index plus one (0 is an empty        */
+/* child), so a tree is a handful of allocations and its leaves can be      */
+/* walked in one pass over the leaf pool.                                   */
 
   typedef struct {              /* hpic tree node */
-    void *child00;
-    void *child01;
-    void *child10;
-    void *child11;
+    size_t child[4];
   } hpic_node;
 
   typedef struct {              /* hpic tree */
     size_t nside;
-    size_t shiftroot;
+    size_t shiftroot;           /* log2(nside) */
+    size_t leafshift;           /* log2 of the side of a leaf */
+    size_t leafpix;             /* pixels in a leaf */
+    size_t elemsize;
+    double nullval;             /* (room for any element) */
+    size_t root[12];
     size_t nnodes;
-    hpic_node *root00;
-    hpic_node *root01;
-    hpic_node *root02;
-    hpic_node *root03;
-    hpic_node *root04;
-    hpic_node *root05;
-    hpic_node *root06;
-    hpic_node *root07;
-    hpic_node *root08;
-    hpic_node *root09;
-    hpic_node *root10;
-    hpic_node *root11;
+    size_t nodealloc;
+    hpic_node *nodes;
+    size_t nleaves;
+    size_t leafalloc;
+    char *leaves;
+    size_t *leaffirst;          /* first NEST pixel of each leaf */
+    size_t lastleaf;            /* leaf last written, for runs of pixels */
   } hpic_tree;
 
 /* map structures */
@@ -658,6 +667,19 @@ static hpic_error_handler_t * hpic_error_handler = NULL;
   int hpic_setall(hpic * map, double val);
   int hpic_float_setall(hpic_float * map, float val);
   int hpic_int_setall(hpic_int * map, int val);
+  int hpic_setpix(hpic * map, const int *pix, const double *vals, size_t n);
+  int hpic_float_setpix(hpic_float * map, const int *pix, const float *vals, size_t n);
+  int hpic_int_setpix(hpic_int * map, const int *pix, const int *vals, size_t n);
+
+  /* the pixels held, as blocks of n pixels from pixel first: the whole   */
+  /* map as one block, or one block per leaf of a tree map, whose pixels  */
+  /* are numbered in NEST order whatever the order of the map            */
+  size_t hpic_nblocks(hpic * map);
+  double *hpic_block(hpic * map, size_t k, size_t *first, size_t *n);
+  size_t hpic_float_nblocks(hpic_float * map);
+  float *hpic_float_block(hpic_float * map, size_t k, size_t *first, size_t *n);
+  size_t hpic_int_nblocks(hpic_int * map);
+  int *hpic_int_block(hpic_int * map, size_t k, size_t *first, size_t *n);
 
   hpic *hpic_copy(hpic * map);
   hpic_float *hpic_float_copy(hpic_float * map);
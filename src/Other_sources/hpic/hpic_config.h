@@ -50,7 +50,12 @@
 #define HAVE_UNISTD_H 1
 
 /* The size of a `size_t', as computed by sizeof. */
+/* (follows the architecture being built, since the app is built fat) */
+#if defined(__LP64__) || defined(_LP64)
+#define SIZEOF_SIZE_T 8
+#else
 #define SIZEOF_SIZE_T 4
+#endif
 
 /* Define to 1 if you have the ANSI C header files. */
 #define STDC_HEADERS 1
@@ -480,10 +480,18 @@ hpic *hpic_conv_xgrade(hpic * map, size_t newnside)
 hpic_float *hpic_conv_float_xgrade(hpic_float * map, size_t newnside)
 {
   hpic_float *newmap = NULL;
+  hpic_float *sums = NULL;
   hpic_int *hits = NULL;
   int order;
   size_t i;
   size_t temp;
+  size_t shift;
+  size_t b;
+  size_t first;
+  size_t n;
+  float *data;
+  int *counts;
+  int count;
   int err;
 
   if (!map) {
@@ -520,34 +528,105 @@ hpic_float *hpic_conv_float_xgrade(hpic_float * map, size_t newnside)
       }
       hpic_float_set(newmap, i, hpic_float_get(map, temp));
     }
+  } else if (map->curstate == HPIC_TREE) {      /*degrade a tree map */
+    /* the same sums, made leaf by leaf into trees at the new nside, so */
+    /* that memory stays in proportion to the pixels held.  leaves are  */
+    /* in nested order whatever the order of the map.                   */
+    shift = 2 * (hpic_nside2factor(hpic_float_nside_get(map)) -
+                 hpic_nside2factor(newnside));
+    sums =
+      hpic_float_alloc(newnside, HPIC_NEST, hpic_float_coord_get(map), HPIC_TREE);
+    hits =
+      hpic_int_alloc(newnside, HPIC_NEST, hpic_float_coord_get(map), HPIC_TREE);
+    if ((!sums) || (!hits)) {
+      hpic_float_free(sums);
+      hpic_int_free(hits);
+      hpic_float_free(newmap);
+      HPIC_ERROR_VAL(HPIC_ERR_ALLOC, "cannot allocate degrade sums", NULL);
+    }
+    for (b = 0; b < hpic_float_nblocks(map); b++) {
+      data = hpic_float_block(map, b, &first, &n);
+      for (i = 0; i < n; i++) {
+        if (!hpic_is_fnull(data[i])) {
+          temp = (first + i) >> shift;
+          count = hpic_int_get(hits, temp);
+          if (hpic_is_inull(count)) {
+            hpic_float_set(sums, temp, data[i]);
+            hpic_int_set(hits, temp, 1);
+          } else {
+            hpic_float_set(sums, temp, hpic_float_get(sums, temp) + data[i]);
+            hpic_int_set(hits, temp, count + 1);
+          }
+        }
+      }
+    }
+    for (b = 0; b < hpic_int_nblocks(hits); b++) {
+      counts = hpic_int_block(hits, b, &first, &n);
+      for (i = 0; i < n; i++) {
+        if (!hpic_is_inull(counts[i])) {
+          if (order == HPIC_NEST) {
+            temp = first + i;
+          } else {
+            hpic_nest2ring(newnside, first + i, &temp);
+          }
+          hpic_float_set(newmap, temp,
+                         hpic_float_get(sums, first + i) / ((float)counts[i]));
+        }
+      }
+    }
+    hpic_float_free(sums);
+    hpic_int_free(hits);
   } else {                      /*degrade */
+    /* one pass over the old pixels, straight through the data arrays. */
+    /* a new nested pixel is just the old one shifted down, so for ring */
+    /* maps the sums are kept in nested order and only the (few) new    */
+    /* pixels are converted back to ring at the end.  the sums are made */
+    /* in the same order as before, so the results are unchanged.       */
+    shift = 2 * (hpic_nside2factor(hpic_float_nside_get(map)) -
+                 hpic_nside2factor(newnside));
+    sums =
+      hpic_float_alloc(newnside, HPIC_NEST, hpic_float_coord_get(map), map->mem);
     hits =
-      hpic_int_alloc(newnside, order, hpic_float_coord_get(map), map->mem);
-    for (i = 0; i < (hpic_float_npix_get(map)); i++) {
-      if (!hpic_is_fnull(hpic_float_get(map, i))) {
+      hpic_int_alloc(newnside, HPIC_NEST, hpic_float_coord_get(map), map->mem);
+    if ((!sums) || (!hits)) {
+      hpic_float_free(sums);
+      hpic_int_free(hits);
+      hpic_float_free(newmap);
+      HPIC_ERROR_VAL(HPIC_ERR_ALLOC, "cannot allocate degrade sums", NULL);
+    }
+    for (i = 0; i < newmap->npix; i++) {
+      hits->data[i] = 0;
+    }
+    for (i = 0; i < map->npix; i++) {
+      if (!hpic_is_fnull(map->data[i])) {
         if (order == HPIC_NEST) {
-          hpic_degrade_nest(hpic_float_nside_get(map), i, newnside, &temp);
+          temp = i;
         } else {
-          hpic_degrade_ring(hpic_float_nside_get(map), i, newnside, &temp);
+          hpic_ring2nest(map->nside, i, &temp);
         }
-        if (!hpic_is_fnull(hpic_float_get(newmap, temp))) {
-          hpic_float_set(newmap, temp,
-                         hpic_float_get(newmap, temp) + hpic_float_get(map,
-                                                                       i));
-          hpic_int_set(hits, temp, hpic_int_get(hits, temp) + 1);
+        temp >>= shift;
+        if (hits->data[temp]) {
+          sums->data[temp] += map->data[i];
+          hits->data[temp]++;
         } else {
-          hpic_float_set(newmap, temp, hpic_float_get(map, i));
-          hpic_int_set(hits, temp, 1);
+          sums->data[temp] = map->data[i];
+          hits->data[temp] = 1;
         }
       }
     }
-    for (i = 0; i < (hpic_float_npix_get(newmap)); i++) {
-      if (!hpic_is_fnull(hpic_float_get(newmap, i))) {
-        hpic_float_set(newmap, i,
-                       hpic_float_get(newmap,
-                                      i) / ((float)hpic_int_get(hits, i)));
+    for (i = 0; i < newmap->npix; i++) {
+      if (order == HPIC_NEST) {
+        temp = i;
+      } else {
+        hpic_nest2ring(newnside, i, &temp);
+      }
+      if (hits->data[i]) {
+        newmap->data[temp] = sums->data[i] / ((float)hits->data[i]);
+      } else {
+        newmap->data[temp] = HPIC_NULL;
       }
     }
+    hpic_float_free(sums);
     hpic_int_free(hits);
   }
   return newmap;
@@ -53,7 +53,7 @@ int hpic_fits_map_test(char *filename, size_t * nside, int *order, int *coord, i
   long keyfirst;
   long keylast;
   int ischunk = 0;
-  int lastcol;
+  int lastcol = 1;
 
   /* open file */
   if (fits_open_file(&fp, filename, READONLY, &ret)) {
@@ -188,7 +188,7 @@ int hpic_fits_map_test(char *filename, size_t * nside, int *order, int *coord, i
   
   if ((*type) == HPIC_FITS_FULL) {
     (*nmaps) = tfields;
-    if ((nrows != (long)(12*inside*inside))&&(1024*nrows != (long)(12*inside*inside))) {
+    if ((nrows != (12*(long)inside*inside))&&(1024*nrows != (12*(long)inside*inside))) {
       /*is this a chunk file?*/
       if (fits_read_key(fp, TLONG, "FIRSTPIX", &keyfirst, comment, &ret)) {
         /*must at least have FIRSTPIX key*/
@@ -203,14 +203,14 @@ int hpic_fits_map_test(char *filename, size_t * nside, int *order, int *coord, i
             ischunk = 0;
           } else {
             keynpix = keynpix - keyfirst + 1;
-            if ((keyfirst < 0)||(keynpix < 0)||(keynpix+keyfirst > (long)(12*inside*inside))) {
+            if ((keyfirst < 0)||(keynpix < 0)||(keynpix+keyfirst > (12*(long)inside*inside))) {
               ischunk = 0;
             } else {
               ischunk = 1;
             }
           }
         } else {
-          if ((keyfirst < 0)||(keynpix < 0)||(keynpix+keyfirst > (long)(12*inside*inside))) {
+          if ((keyfirst < 0)||(keynpix < 0)||(keynpix+keyfirst > (12*(long)inside*inside))) {
             ischunk = 0;
           } else {
             ischunk = 1;
@@ -219,7 +219,7 @@ int hpic_fits_map_test(char *filename, size_t * nside, int *order, int *coord, i
       }
     } else {
       /*header doesn't matter, since we have entire map*/
-      if (nrows == (long)(12*inside*inside)) {
+      if (nrows == (12*(long)inside*inside)) {
         lastcol = 1;
       } else {
         lastcol = 1024;
@@ -278,7 +278,7 @@ int hpic_fits_map_info(char *filename, size_t * nside, int *order,
   long keyfirst;
   long keylast;
   int ischunk = 0;
-  int lastcol;
+  int lastcol = 1;
 
   /* open file */
   if (fits_open_file(&fp, filename, READONLY, &ret)) {
@@ -421,7 +421,7 @@ int hpic_fits_map_info(char *filename, size_t * nside, int *order,
   
   if ((*type) == HPIC_FITS_FULL) {
     (*nmaps) = tfields;
-    if ((nrows != (long)(12*inside*inside))&&(1024*nrows != (long)(12*inside*inside))) {
+    if ((nrows != (12*(long)inside*inside))&&(1024*nrows != (12*(long)inside*inside))) {
       /*is this a chunk file?*/
       if (fits_read_key(fp, TLONG, "FIRSTPIX", &keyfirst, comment, &ret)) {
         /*must at least have FIRSTPIX key*/
@@ -436,14 +436,14 @@ int hpic_fits_map_info(char *filename, size_t * nside, int *order,
             ischunk = 0;
           } else {
             keynpix = keynpix - keyfirst + 1;
-            if ((keyfirst < 0)||(keynpix < 0)||(keynpix+keyfirst > (long)(12*inside*inside))) {
+            if ((keyfirst < 0)||(keynpix < 0)||(keynpix+keyfirst > (12*(long)inside*inside))) {
               ischunk = 0;
             } else {
               ischunk = 1;
             }
           }
         } else {
-          if ((keyfirst < 0)||(keynpix < 0)||(keynpix+keyfirst > (long)(12*inside*inside))) {
+          if ((keyfirst < 0)||(keynpix < 0)||(keynpix+keyfirst > (12*(long)inside*inside))) {
             ischunk = 0;
           } else {
             ischunk = 1;
@@ -452,7 +452,7 @@ int hpic_fits_map_info(char *filename, size_t * nside, int *order,
       }
     } else {
       /*header doesn't matter, since we have entire map*/
-      if (nrows == (long)(12*inside*inside)) {
+      if (nrows == (12*(long)inside*inside)) {
         lastcol = 1;
       } else {
         lastcol = 1024;
@@ -1132,12 +1132,18 @@ int hpic_fits_full_read(char *filename, char *creator, char *extname,
   char **colnames;
   char **coltypes;
   char **colunits;
-  hpic_vec_float *datavec;
   size_t nmaps = hpic_fltarr_n_get(maps);
   hpic_float *tempmap;
-  int keynpix;
-  int keyfirst;
+  long keynpix;
+  long keyfirst;
   int ischunk;
+  int coltype;
+  long repeat;
+  long width;
+  long rowchunk;
+  long first;
+  long nread;
+  size_t offset;
 
   /* test file to make sure its a full-sphere type */
   if (!hpic_fits_map_test(filename, &nside, &order, &coord, &ttype, &tmaps)) {
@@ -1228,34 +1234,60 @@ int hpic_fits_full_read(char *filename, char *creator, char *extname,
   nullval = HPIC_NULL;
   nnull = 0;
   if (ischunk) {
-    datavec = hpic_vec_float_alloc((size_t)keynpix);
     nelem = (long)keynpix;
+    offset = (size_t)keyfirst;
   } else {
-    datavec = hpic_vec_float_alloc(12*nside*nside);
     nelem = (long)(12*nside*nside);
+    offset = 0;
+  }
+  if ((nelem < 0) || (offset + (size_t)nelem > 12*nside*nside)) {
+    fits_close_file(fp, &ret);
+    HPIC_ERROR(HPIC_ERR_RANGE, "pixel range in file does not fit the map");
   }
   for (i = 0; i < tmaps; i++) {
     tempmap = hpic_fltarr_get(maps, i);
+    if (!(tempmap->data)) {
+      fits_close_file(fp, &ret);
+      HPIC_ERROR(HPIC_ERR_ACCESS, "map has no pixel buffer to read into");
+    }
     hpic_float_name_set(tempmap, colnames[i]);
     hpic_float_units_set(tempmap, colunits[i]);
-    if (fits_read_col
-        (fp, TFLOAT, (int)(i + 1), 1, 1, nelem, &nullval, datavec->data,
-         &nnull, &ret)) {
-      fitserr(ret, "hpic_fits_full_read:  reading data");
-    }
-    hpic_float_setall(tempmap, HPIC_NULL);
     if (ischunk) {
-      for (j = 0; j < (size_t)nelem; j++) {
-        hpic_float_set(tempmap, j+(size_t)keyfirst, hpic_vec_float_get(datavec, j));
-      }
-    } else {
-      for (j = 0; j < (size_t)nelem; j++) {
-        hpic_float_set(tempmap, j, hpic_vec_float_get(datavec, j));
+      hpic_float_setall(tempmap, HPIC_NULL);
+    }
+  }
+
+  /* elements per row (1 or 1024 for healpix files), and the number of */
+  /* rows cfitsio can buffer at once.  the table is streamed in blocks  */
+  /* of that many rows, each column going straight into its map, so    */
+  /* there is no temporary copy of the data and only one pass over it.  */
+  if (fits_get_coltype(fp, 1, &coltype, &repeat, &width, &ret)) {
+    fitserr(ret, "hpic_fits_full_read:  reading column type");
+  }
+  if (repeat < 1) {
+    repeat = 1;
+  }
+  if (fits_get_rowsize(fp, &rowchunk, &ret)) {
+    fitserr(ret, "hpic_fits_full_read:  reading optimal row count");
+  }
+  if (rowchunk < 1) {
+    rowchunk = 1;
+  }
+  for (first = 0; first < nelem; first += rowchunk * repeat) {
+    nread = nelem - first;
+    if (nread > rowchunk * repeat) {
+      nread = rowchunk * repeat;
+    }
+    for (i = 0; i < tmaps; i++) {
+      tempmap = hpic_fltarr_get(maps, i);
+      if (fits_read_col
+          (fp, TFLOAT, (int)(i + 1), first / repeat + 1, 1, nread, &nullval,
+           tempmap->data + offset + (size_t)first, &nnull, &ret)) {
+        fitserr(ret, "hpic_fits_full_read:  reading data");
       }
     }
   }
   
-  hpic_vec_float_free(datavec);
   hpic_strarr_free(colnames, tmaps);
   hpic_strarr_free(coltypes, tmaps);
   hpic_strarr_free(colunits, tmaps);
@@ -1397,10 +1429,11 @@ int hpic_fits_cut_read(char *filename, char *creator, char *extname,
       (fp, TINT, 1, 1, 1, nrows, &nullval, pixvec->data, &nnull, &ret)) {
     fitserr(ret, "hpic_fits_cut_read:  reading pixels");
   }
+  /* the rows go straight into the maps; tree maps only grow leaves */
+  /* where there are rows, and setting them all null just empties them */
   hpic_int_setall(pixels, HPIC_INT_NULL);
-  for (j = 0; j < (size_t) (nrows); j++) {
-    hpic_int_set(pixels, (size_t) hpic_vec_int_get(pixvec, j),
-                 hpic_vec_int_get(pixvec, j));
+  if (hpic_int_setpix(pixels, pixvec->data, pixvec->data, (size_t)nrows)) {
+    HPIC_ERROR(HPIC_ERR_RANGE, "pixel in file is out of range");
   }
 
   for (i = 0; i < tmaps; i++) {
@@ -1413,9 +1446,8 @@ int hpic_fits_cut_read(char *filename, char *creator, char *extname,
          &nnull, &ret)) {
       fitserr(ret, "hpic_fits_cut_read:  reading data");
     }
-    for (j = 0; j < (size_t) (nrows); j++) {
-      hpic_float_set(tempmap, (size_t) hpic_vec_int_get(pixvec, j),
-                     hpic_vec_float_get(datavec, j));
+    if (hpic_float_setpix(tempmap, pixvec->data, datavec->data, (size_t)nrows)) {
+      HPIC_ERROR(HPIC_ERR_RANGE, "pixel in file is out of range");
     }
   }
 
@@ -1427,9 +1459,8 @@ int hpic_fits_cut_read(char *filename, char *creator, char *extname,
     fitserr(ret, "hpic_fits_cut_read:  reading hits");
   }
   hpic_int_setall(hits, HPIC_INT_NULL);
-  for (j = 0; j < (size_t) (nrows); j++) {
-    hpic_int_set(hits, (size_t) hpic_vec_int_get(pixvec, j),
-                 hpic_vec_int_get(hitsvec, j));
+  if (hpic_int_setpix(hits, pixvec->data, hitsvec->data, (size_t)nrows)) {
+    HPIC_ERROR(HPIC_ERR_RANGE, "pixel in file is out of range");
   }
   hpic_float_name_set(errs, colnames[tmaps + 2]);
   hpic_float_units_set(errs, colunits[tmaps + 2]);
@@ -1439,9 +1470,8 @@ int hpic_fits_cut_read(char *filename, char *creator, char *extname,
     fitserr(ret, "hpic_fits_cut_read:  reading errs");
   }
   hpic_float_setall(errs, HPIC_NULL);
-  for (j = 0; j < (size_t) (nrows); j++) {
-    hpic_float_set(errs, (size_t) hpic_vec_int_get(pixvec, j),
-                   hpic_vec_float_get(errsvec, j));
+  if (hpic_float_setpix(errs, pixvec->data, errsvec->data, (size_t)nrows)) {
+    HPIC_ERROR(HPIC_ERR_RANGE, "pixel in file is out of range");
   }
 
   hpic_vec_float_free(datavec);
@@ -1486,8 +1516,8 @@ hpic_float *hpic_fits_read_one(char *filename, size_t mapnum, char *creator, hpi
   char **colunits;
   float nullval;
   int nnull;
-  int keynpix;
-  int keyfirst;
+  long keynpix;
+  long keyfirst;
   int ischunk;
   long nelem;
 
@@ -15,12 +15,25 @@
 #include "hpic.h"
 #include "hpic_tree.h"
 
+/* tree maps are stored in NEST order, whatever the order of the map */
+
+static size_t hpic_treepix(size_t nside, int order, size_t pix)
+{
+  size_t nest;
+  if (order == HPIC_NEST) {
+    return pix;
+  }
+  hpic_ring2nest(nside, pix, &nest);
+  return nest;
+}
+
 /* alloc/free */
 
 hpic *hpic_alloc(size_t nside, int order, int coord, int mem)
 {
   size_t i;
   hpic *map;
+  double nullval;
   int err;
   
   err = hpic_nsidecheck(nside);
@@ -50,14 +63,16 @@ hpic *hpic_alloc(size_t nside, int order, int coord, int mem)
     HPIC_ERROR_VAL(HPIC_ERR_ALLOC,"cannot allocate map->units",NULL);
   }
   
-  /*temporary redirect of HPIC_TREE option (which is not implemented) */
-  if (mem == HPIC_TREE) {
-    mem = HPIC_AUTO;
-  }
-
   map->mem = mem;
   if (((mem == HPIC_TREE)) && (nside != 1)) {
-    map->tree = hpic_tree_alloc(nside);
+    nullval = HPIC_NULL;
+    map->tree = hpic_tree_alloc(nside, sizeof(double), &nullval);
+    if (!(map->tree)) {
+      free(map->name);
+      free(map->units);
+      free(map);
+      HPIC_ERROR_VAL(HPIC_ERR_ALLOC,"cannot allocate map->tree",NULL);
+    }
     map->curstate = HPIC_TREE;
   } else {
     map->data = (double *)calloc(map->npix, sizeof(double));
@@ -97,6 +112,7 @@ hpic_float *hpic_float_alloc(size_t nside, int order, int coord, int mem)
 {
   size_t i;
   hpic_float *map;
+  float nullval;
   int err;
   
   err = hpic_nsidecheck(nside);
@@ -126,14 +142,16 @@ hpic_float *hpic_float_alloc(size_t nside, int order, int coord, int mem)
     HPIC_ERROR_VAL(HPIC_ERR_ALLOC,"cannot allocate map->units",NULL);
   }
   
-  /*temporary redirect of HPIC_TREE option (which is not implemented) */
-  if (mem == HPIC_TREE) {
-    mem = HPIC_AUTO;
-  }
-
   map->mem = mem;
   if (((mem == HPIC_TREE)) && (nside != 1)) {
-    map->tree = hpic_tree_alloc(nside);
+    nullval = HPIC_NULL;
+    map->tree = hpic_tree_alloc(nside, sizeof(float), &nullval);
+    if (!(map->tree)) {
+      free(map->name);
+      free(map->units);
+      free(map);
+      HPIC_ERROR_VAL(HPIC_ERR_ALLOC,"cannot allocate map->tree",NULL);
+    }
     map->curstate = HPIC_TREE;
   } else {
     map->data = (float *)calloc(map->npix, sizeof(float));
@@ -173,6 +191,7 @@ hpic_int *hpic_int_alloc(size_t nside, int order, int coord, int mem)
 {
   size_t i;
   hpic_int *map;
+  int nullval;
   int err;
 
   err = hpic_nsidecheck(nside);
@@ -202,14 +221,16 @@ hpic_int *hpic_int_alloc(size_t nside, int order, int coord, int mem)
     HPIC_ERROR_VAL(HPIC_ERR_ALLOC,"cannot allocate map->units",NULL);
   }
   
-  /*temporary redirect of HPIC_TREE option (which is not implemented) */
-  if (mem == HPIC_TREE) {
-    mem = HPIC_AUTO;
-  }
-
   map->mem = mem;
   if (((mem == HPIC_TREE)) && (nside != 1)) {
-    map->tree = hpic_tree_alloc(nside);
+    nullval = HPIC_INT_NULL;
+    map->tree = hpic_tree_alloc(nside, sizeof(int), &nullval);
+    if (!(map->tree)) {
+      free(map->name);
+      free(map->units);
+      free(map);
+      HPIC_ERROR_VAL(HPIC_ERR_ALLOC,"cannot allocate map->tree",NULL);
+    }
     map->curstate = HPIC_TREE;
   } else {
     map->data = (int *)calloc(map->npix, sizeof(int));
@@ -268,6 +289,7 @@ int hpic_mem_set(hpic * map, int mem)
      exit(1);
      }
    */
+  return 0;
 }
 
 int hpic_float_mem_get(hpic_float * map)
@@ -290,6 +312,7 @@ int hpic_float_mem_set(hpic_float * map, int mem)
      exit(1);
      }
    */
+  return 0;
 }
 
 int hpic_int_mem_get(hpic_int * map)
@@ -312,6 +335,7 @@ int hpic_int_mem_set(hpic_int * map, int mem)
      exit(1);
      }
    */
+  return 0;
 }
 
 /* parameter access */
@@ -544,6 +568,12 @@ int hpic_set(hpic * map, size_t pix, double val)
 {
   if (map) {
     if ((pix < (map->npix)) && (pix >= 0)) {
+      if (map->curstate == HPIC_TREE) {
+        if (hpic_tree_set(map->tree, hpic_treepix(map->nside, map->order, pix), val)) {
+          HPIC_ERROR(HPIC_ERR_ALLOC, "cannot allocate tree leaf");
+        }
+        return 0;
+      }
       map->data[pix] = val;
       return 0;
     } else {
@@ -558,6 +588,9 @@ inline double hpic_get(hpic * map, size_t pix)
 {
   if (map) {
     if ((pix < (map->npix)) && (pix >= 0)) {
+      if (map->curstate == HPIC_TREE) {
+        return hpic_tree_get(map->tree, hpic_treepix(map->nside, map->order, pix));
+      }
       return map->data[pix];
     } else {
       HPIC_ERROR_VAL(HPIC_ERR_RANGE, "pixel value out of range", HPIC_NULL);
@@ -571,6 +604,12 @@ int hpic_float_set(hpic_float * map, size_t pix, float val)
 {
   if (map) {
     if ((pix < (map->npix)) && (pix >= 0)) {
+      if (map->curstate == HPIC_TREE) {
+        if (hpic_tree_float_set(map->tree, hpic_treepix(map->nside, map->order, pix), val)) {
+          HPIC_ERROR(HPIC_ERR_ALLOC, "cannot allocate tree leaf");
+        }
+        return 0;
+      }
       map->data[pix] = val;
       return 0;
     } else {
@@ -585,6 +624,9 @@ inline float hpic_float_get(hpic_float * map, size_t pix)
 {
   if (map) {
     if ((pix < (map->npix)) && (pix >= 0)) {
+      if (map->curstate == HPIC_TREE) {
+        return hpic_tree_float_get(map->tree, hpic_treepix(map->nside, map->order, pix));
+      }
       return map->data[pix];
     } else {
       HPIC_ERROR_VAL(HPIC_ERR_RANGE, "pixel value out of range", HPIC_NULL);
@@ -598,6 +640,12 @@ int hpic_int_set(hpic_int * map, size_t pix, int val)
 {
   if (map) {
     if ((pix < (map->npix)) && (pix >= 0)) {
+      if (map->curstate == HPIC_TREE) {
+        if (hpic_tree_int_set(map->tree, hpic_treepix(map->nside, map->order, pix), val)) {
+          HPIC_ERROR(HPIC_ERR_ALLOC, "cannot allocate tree leaf");
+        }
+        return 0;
+      }
       map->data[pix] = val;
       return 0;
     } else {
@@ -612,6 +660,9 @@ inline int hpic_int_get(hpic_int * map, size_t pix)
 {
   if (map) {
     if ((pix < (map->npix)) && (pix >= 0)) {
+      if (map->curstate == HPIC_TREE) {
+        return hpic_tree_int_get(map->tree, hpic_treepix(map->nside, map->order, pix));
+      }
       return map->data[pix];
     } else {
       HPIC_ERROR_VAL(HPIC_ERR_RANGE, "pixel value out of range", HPIC_INT_NULL);
@@ -624,7 +675,22 @@ inline int hpic_int_get(hpic_int * map, size_t pix)
 int hpic_setall(hpic * map, double val)
 {
   size_t i;
+  double *elem;
   if (map) {
+    if (map->curstate == HPIC_TREE) {
+      /* null empties the tree, anything else fills it, in NEST order */
+      hpic_tree_clear(map->tree);
+      if (hpic_is_dnull(val)) {
+        return 0;
+      }
+      for (i = 0; i < (map->npix); i++) {
+        if (!(elem = (double *)hpic_tree_insert(map->tree, i))) {
+          HPIC_ERROR(HPIC_ERR_ALLOC, "cannot allocate tree leaf");
+        }
+        (*elem) = val;
+      }
+      return 0;
+    }
     for (i = 0; i < (map->npix); i++) {
       hpic_set(map, i, val);
     }
@@ -637,7 +703,22 @@ int hpic_setall(hpic * map, double val)
 int hpic_float_setall(hpic_float * map, float val)
 {
   size_t i;
+  float *elem;
   if (map) {
+    if (map->curstate == HPIC_TREE) {
+      /* null empties the tree, anything else fills it, in NEST order */
+      hpic_tree_clear(map->tree);
+      if (hpic_is_fnull(val)) {
+        return 0;
+      }
+      for (i = 0; i < (map->npix); i++) {
+        if (!(elem = (float *)hpic_tree_insert(map->tree, i))) {
+          HPIC_ERROR(HPIC_ERR_ALLOC, "cannot allocate tree leaf");
+        }
+        (*elem) = val;
+      }
+      return 0;
+    }
     for (i = 0; i < (map->npix); i++) {
       hpic_float_set(map, i, val);
     }
@@ -650,7 +731,22 @@ int hpic_float_setall(hpic_float * map, float val)
 int hpic_int_setall(hpic_int * map, int val)
 {
   size_t i;
+  int *elem;
   if (map) {
+    if (map->curstate == HPIC_TREE) {
+      /* null empties the tree, anything else fills it, in NEST order */
+      hpic_tree_clear(map->tree);
+      if (hpic_is_inull(val)) {
+        return 0;
+      }
+      for (i = 0; i < (map->npix); i++) {
+        if (!(elem = (int *)hpic_tree_insert(map->tree, i))) {
+          HPIC_ERROR(HPIC_ERR_ALLOC, "cannot allocate tree leaf");
+        }
+        (*elem) = val;
+      }
+      return 0;
+    }
     for (i = 0; i < (map->npix); i++) {
       hpic_int_set(map, i, val);
     }
@@ -660,6 +756,158 @@ int hpic_int_setall(hpic_int * map, int val)
   }
 }
 
+/* bulk writes of n pixels pix[j] = vals[j], such as the rows of a cut-sphere */
+/* file; runs of pixels in one tree leaf are written without a descent.     */
+
+int hpic_setpix(hpic * map, const int *pix, const double *vals, size_t n)
+{
+  size_t j;
+  if (map) {
+    for (j = 0; j < n; j++) {
+      if ((pix[j] < 0) || ((size_t)pix[j] >= (map->npix))) {
+        HPIC_ERROR(HPIC_ERR_RANGE, "pixel value out of range");
+      }
+      if (map->curstate == HPIC_TREE) {
+        if (hpic_tree_set(map->tree, hpic_treepix(map->nside, map->order, (size_t)pix[j]), vals[j])) {
+          HPIC_ERROR(HPIC_ERR_ALLOC, "cannot allocate tree leaf");
+        }
+      } else {
+        map->data[pix[j]] = vals[j];
+      }
+    }
+    return 0;
+  } else {
+    HPIC_ERROR(HPIC_ERR_ACCESS, "map pointer is NULL");
+  }
+}
+
+int hpic_float_setpix(hpic_float * map, const int *pix, const float *vals, size_t n)
+{
+  size_t j;
+  if (map) {
+    for (j = 0; j < n; j++) {
+      if ((pix[j] < 0) || ((size_t)pix[j] >= (map->npix))) {
+        HPIC_ERROR(HPIC_ERR_RANGE, "pixel value out of range");
+      }
+      if (map->curstate == HPIC_TREE) {
+        if (hpic_tree_float_set(map->tree, hpic_treepix(map->nside, map->order, (size_t)pix[j]), vals[j])) {
+          HPIC_ERROR(HPIC_ERR_ALLOC, "cannot allocate tree leaf");
+        }
+      } else {
+        map->data[pix[j]] = vals[j];
+      }
+    }
+    return 0;
+  } else {
+    HPIC_ERROR(HPIC_ERR_ACCESS, "map pointer is NULL");
+  }
+}
+
+int hpic_int_setpix(hpic_int * map, const int *pix, const int *vals, size_t n)
+{
+  size_t j;
+  if (map) {
+    for (j = 0; j < n; j++) {
+      if ((pix[j] < 0) || ((size_t)pix[j] >= (map->npix))) {
+        HPIC_ERROR(HPIC_ERR_RANGE, "pixel value out of range");
+      }
+      if (map->curstate == HPIC_TREE) {
+        if (hpic_tree_int_set(map->tree, hpic_treepix(map->nside, map->order, (size_t)pix[j]), vals[j])) {
+          HPIC_ERROR(HPIC_ERR_ALLOC, "cannot allocate tree leaf");
+        }
+      } else {
+        map->data[pix[j]] = vals[j];
+      }
+    }
+    return 0;
+  } else {
+    HPIC_ERROR(HPIC_ERR_ACCESS, "map pointer is NULL");
+  }
+}
+
+/* block iteration */
+
+size_t hpic_nblocks(hpic * map)
+{
+  if (map) {
+    return (map->curstate == HPIC_TREE) ? map->tree->nleaves : 1;
+  } else {
+    HPIC_ERROR_VAL(HPIC_ERR_ACCESS, "map pointer is NULL", 0);
+  }
+}
+
+double *hpic_block(hpic * map, size_t k, size_t *first, size_t *n)
+{
+  if (map) {
+    if ((map->curstate == HPIC_TREE) && (k < map->tree->nleaves)) {
+      (*n) = map->tree->leafpix;
+      return (double *)hpic_tree_leaf(map->tree, k, first);
+    }
+    if ((map->curstate != HPIC_TREE) && (k == 0)) {
+      (*first) = 0;
+      (*n) = map->npix;
+      return map->data;
+    }
+    HPIC_ERROR_VAL(HPIC_ERR_RANGE, "block number out of range", NULL);
+  } else {
+    HPIC_ERROR_VAL(HPIC_ERR_ACCESS, "map pointer is NULL", NULL);
+  }
+}
+
+size_t hpic_float_nblocks(hpic_float * map)
+{
+  if (map) {
+    return (map->curstate == HPIC_TREE) ? map->tree->nleaves : 1;
+  } else {
+    HPIC_ERROR_VAL(HPIC_ERR_ACCESS, "map pointer is NULL", 0);
+  }
+}
+
+float *hpic_float_block(hpic_float * map, size_t k, size_t *first, size_t *n)
+{
+  if (map) {
+    if ((map->curstate == HPIC_TREE) && (k < map->tree->nleaves)) {
+      (*n) = map->tree->leafpix;
+      return (float *)hpic_tree_leaf(map->tree, k, first);
+    }
+    if ((map->curstate != HPIC_TREE) && (k == 0)) {
+      (*first) = 0;
+      (*n) = map->npix;
+      return map->data;
+    }
+    HPIC_ERROR_VAL(HPIC_ERR_RANGE, "block number out of range", NULL);
+  } else {
+    HPIC_ERROR_VAL(HPIC_ERR_ACCESS, "map pointer is NULL", NULL);
+  }
+}
+
+size_t hpic_int_nblocks(hpic_int * map)
+{
+  if (map) {
+    return (map->curstate == HPIC_TREE) ? map->tree->nleaves : 1;
+  } else {
+    HPIC_ERROR_VAL(HPIC_ERR_ACCESS, "map pointer is NULL", 0);
+  }
+}
+
+int *hpic_int_block(hpic_int * map, size_t k, size_t *first, size_t *n)
+{
+  if (map) {
+    if ((map->curstate == HPIC_TREE) && (k < map->tree->nleaves)) {
+      (*n) = map->tree->leafpix;
+      return (int *)hpic_tree_leaf(map->tree, k, first);
+    }
+    if ((map->curstate != HPIC_TREE) && (k == 0)) {
+      (*first) = 0;
+      (*n) = map->npix;
+      return map->data;
+    }
+    HPIC_ERROR_VAL(HPIC_ERR_RANGE, "block number out of range", NULL);
+  } else {
+    HPIC_ERROR_VAL(HPIC_ERR_ACCESS, "map pointer is NULL", NULL);
+  }
+}
+
 hpic *hpic_copy(hpic * map)
 {
   hpic *copy;
@@ -678,6 +926,13 @@ hpic *hpic_copy(hpic * map)
     if (err) {
       HPIC_ERROR_VAL(HPIC_ERR_ACCESS, "cannot set copy units", NULL);
     }
+    if (map->curstate == HPIC_TREE) {
+      hpic_tree_free(copy->tree);
+      if (!(copy->tree = hpic_tree_copy(map->tree))) {
+        HPIC_ERROR_VAL(HPIC_ERR_ALLOC, "cannot allocate copy tree", NULL);
+      }
+      return copy;
+    }
     for (i = 0; i < (map->npix); i++) {
       hpic_set(copy, i, hpic_get(map, i));
     }
@@ -705,6 +960,13 @@ hpic_float *hpic_float_copy(hpic_float * map)
     if (err) {
       HPIC_ERROR_VAL(HPIC_ERR_ACCESS, "cannot set copy units", NULL);
     }
+    if (map->curstate == HPIC_TREE) {
+      hpic_tree_free(copy->tree);
+      if (!(copy->tree = hpic_tree_copy(map->tree))) {
+        HPIC_ERROR_VAL(HPIC_ERR_ALLOC, "cannot allocate copy tree", NULL);
+      }
+      return copy;
+    }
     for (i = 0; i < (map->npix); i++) {
       hpic_float_set(copy, i, hpic_float_get(map, i));
     }
@@ -732,6 +994,13 @@ hpic_int *hpic_int_copy(hpic_int * map)
     if (err) {
       HPIC_ERROR_VAL(HPIC_ERR_ACCESS, "cannot set copy units", NULL);
     }
+    if (map->curstate == HPIC_TREE) {
+      hpic_tree_free(copy->tree);
+      if (!(copy->tree = hpic_tree_copy(map->tree))) {
+        HPIC_ERROR_VAL(HPIC_ERR_ALLOC, "cannot allocate copy tree", NULL);
+      }
+      return copy;
+    }
     for (i = 0; i < (map->npix); i++) {
       hpic_int_set(copy, i, hpic_int_get(map, i));
     }
@@ -750,8 +1019,8 @@ int hpic_info_fprintf(FILE * fp, hpic * map)
     fprintf(fp, "  | Map = \"%s\" Units = \"%s\"\n", map->name, map->units);
     fprintf(fp, "  |   nside = %lu npix = %lu\n", map->nside, map->npix);
     fprintf(fp, "  |   order = %d coord = %d\n", map->order, map->coord);
-    fprintf(fp, "  |   data = %g ... %g\n", map->data[0],
-            map->data[(map->npix) - 1]);
+    fprintf(fp, "  |   data = %g ... %g\n", hpic_get(map, 0),
+            hpic_get(map, (map->npix) - 1));
     fprintf(fp, "  ----------------------------------------\n");
     return 0;
   } else {
@@ -771,8 +1040,8 @@ int hpic_float_info_fprintf(FILE * fp, hpic_float * map)
     fprintf(fp, "  | Map = \"%s\" Units = \"%s\"\n", map->name, map->units);
     fprintf(fp, "  |   nside = %lu npix = %lu\n", map->nside, map->npix);
     fprintf(fp, "  |   order = %d coord = %d\n", map->order, map->coord);
-    fprintf(fp, "  |   data = %g ... %g\n", map->data[0],
-            map->data[(map->npix) - 1]);
+    fprintf(fp, "  |   data = %g ... %g\n", hpic_float_get(map, 0),
+            hpic_float_get(map, (map->npix) - 1));
     fprintf(fp, "  ----------------------------------------\n");
     return 0;
   } else {
@@ -792,8 +1061,8 @@ int hpic_int_info_fprintf(FILE * fp, hpic_int * map)
     fprintf(fp, "  | Map = \"%s\" Units = \"%s\"\n", map->name, map->units);
     fprintf(fp, "  |   nside = %lu npix = %lu\n", map->nside, map->npix);
     fprintf(fp, "  |   order = %d coord = %d\n", map->order, map->coord);
-    fprintf(fp, "  |   data = %d ... %d\n", map->data[0],
-            map->data[(map->npix) - 1]);
+    fprintf(fp, "  |   data = %d ... %d\n", hpic_int_get(map, 0),
+            hpic_int_get(map, (map->npix) - 1));
     fprintf(fp, "  ----------------------------------------\n");
     return 0;
   } else {
@@ -51,19 +51,19 @@ void hpic_init() {
 
 int hpic_xy2pix(size_t x, size_t y, size_t *pix) {
   HPIC_CHK;
-  (*pix) = hpic_utab[x&0xff] | (hpic_utab[(x>>8)&0xff]<<16) | (hpic_utab[(x>>16)&0xff]<<32) | (hpic_utab[(x>>24)&0xff]<<48) | (hpic_utab[y&0xff]<<1) | (hpic_utab[(y>>8)&0xff]<<17) | (hpic_utab[(y>>16)&0xff]<<33) | (hpic_utab[(y>>24)&0xff]<<48);
+  (*pix) = hpic_utab[x&0xff] | (hpic_utab[(x>>8)&0xff]<<16) | (hpic_utab[(x>>16)&0xff]<<32) | (hpic_utab[(x>>24)&0xff]<<48) | (hpic_utab[y&0xff]<<1) | (hpic_utab[(y>>8)&0xff]<<17) | (hpic_utab[(y>>16)&0xff]<<33) | (hpic_utab[(y>>24)&0xff]<<49);
   return HPIC_ERR_NONE;
 }
 
 int hpic_x2pix(size_t x, size_t *pix) {
   HPIC_CHK;
-  (*pix) = hpic_utab[x&0xff] | (hpic_utab[x>>8]<<16) | (hpic_utab[(x>>16)&0xff]<<32) | (hpic_utab[(x>>24)&0xff]<<48);
+  (*pix) = hpic_utab[x&0xff] | (hpic_utab[(x>>8)&0xff]<<16) | (hpic_utab[(x>>16)&0xff]<<32) | (hpic_utab[(x>>24)&0xff]<<48);
   return HPIC_ERR_NONE;
 }
 
 int hpic_y2pix(size_t y, size_t *pix) {
   HPIC_CHK;
-  (*pix) = (hpic_utab[y&0xff]<<1) | (hpic_utab[y>>8]<<17) | (hpic_utab[(y>>16)&0xff]<<33) | (hpic_utab[(y>>24)&0xff]<<48);
+  (*pix) = (hpic_utab[y&0xff]<<1) | (hpic_utab[(y>>8)&0xff]<<17) | (hpic_utab[(y>>16)&0xff]<<33) | (hpic_utab[(y>>24)&0xff]<<49);
   return HPIC_ERR_NONE;
 }
 
@@ -275,7 +275,6 @@ int hpic_nest2ring (size_t nside, size_t pnest, size_t *pring) {
   /*
   printf(" xyf2ring:  x = %lu  y = %lu  face = %lu  %lu\n", x, y, face_num, (*pring));
   */
-  fflush(stdout);
   return err;
 }
 
@@ -293,7 +292,6 @@ int hpic_ring2nest(size_t nside, size_t pring, size_t *pnest) {
   /*
   printf("ring2xyf:  %lu  x = %lu  y = %lu  face = %lu\n", pring, x, y, face_num);
   */
-  fflush(stdout);
   if (err) {
     return err;
   }
@@ -301,7 +299,6 @@ int hpic_ring2nest(size_t nside, size_t pring, size_t *pnest) {
   /*
   printf(" xyf2nest:  x = %lu  y = %lu  face = %lu  %lu\n", x, y, face_num, (*pnest));
   */
-  fflush(stdout);
   return err;
 }
 
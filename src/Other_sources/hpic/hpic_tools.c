@@ -124,12 +124,18 @@ size_t hpic_nside2factor(size_t nside)
 {
   int err;
   size_t factor = 0;
+  size_t shift;
   err = hpic_nsidecheck(nside);
   if (err) {
     HPIC_ERROR_VAL(err,"nside value is not valid",0);
   }
-  while (nside != (1ul<<factor)) {
-    factor++;
+  /* binary search for the set bit: this is called for every pixel in */
+  /* the ring <-> nest conversions, so a bit-by-bit loop adds up       */
+  for (shift = 16; shift > 0; shift >>= 1) {
+    if (nside >> shift) {
+      factor += shift;
+      nside >>= shift;
+    }
   }
   return factor;
 }
@@ -0,0 +1,111 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+*****************************************************************************/
+
+/*****************************************************************************
+*                                                                            *
+* Slot and budget keeping for the texture and render caches. Each use of a   *
+* cache ticks its clock, and a slot records the tick it was last used at;    *
+* the least recently used entries are evicted once the bytes held exceed     *
+* the budget, or when every slot is taken.                                   *
+*                                                                            *
+*****************************************************************************/
+
+#include "lrucache.h"
+
+//least recently used slot, or -1 if the cache is empty
+static int oldest(const lrucache *c)
+{
+	int i, k = -1;
+
+	for (i=0; i<c->nslots; i++)
+	{
+		if (c->slot[i].valid && (k<0 || c->slot[i].used<c->slot[k].used)) k = i;
+	}
+	return k;
+}
+
+void lru_evict(lrucache *c, int slot)
+{
+	c->release(slot);
+	c->held -= c->slot[slot].bytes;
+	c->slot[slot].valid = 0;
+}
+
+void lru_set_budget(lrucache *c, size_t bytes)
+{
+	int k;
+
+	c->budget = bytes;
+	while (c->held>c->budget && (k = oldest(c))>=0 && c->slot[k].used!=c->clock)
+	{
+		lru_evict(c,k);
+	}
+}
+
+int lru_lookup(lrucache *c, lru_match match, const void *key)
+{
+	int i;
+
+	c->clock++;
+	for (i=0; i<c->nslots; i++)
+	{
+		if (c->slot[i].valid && match(i,key))
+		{
+			c->slot[i].used = c->clock;
+			return i;
+		}
+	}
+	return -1;
+}
+
+int lru_add(lrucache *c, size_t bytes)
+{
+	int i, k;
+
+	while (c->held+bytes>c->budget && (k = oldest(c))>=0)
+	{
+		lru_evict(c,k);
+	}
+
+	for (i=0; i<c->nslots && c->slot[i].valid; i++);
+	if (i==c->nslots)
+	{
+		i = oldest(c);
+		lru_evict(c,i);
+	}
+
+	c->slot[i].bytes = bytes;
+	c->slot[i].used = c->clock;
+	c->slot[i].valid = 1;
+	c->held += bytes;
+	return i;
+}
+
+void lru_flush(lrucache *c)
+{
+	int i;
+
+	for (i=0; i<c->nslots; i++)
+	{
+		if (c->slot[i].valid) lru_evict(c,i);
+	}
+}
@@ -0,0 +1,71 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+*****************************************************************************/
+
+#ifndef CMBVIEW_LRUCACHE_H
+#define CMBVIEW_LRUCACHE_H
+
+#include <stddef.h>
+
+//most slots a cache can have
+#define LRU_MAXSLOTS 16
+
+//frees whatever the user of a cache keeps for one of its slots
+typedef void (*lru_release)(int slot);
+
+//does the key kept for slot match key?
+typedef int (*lru_match)(int slot, const void *key);
+
+typedef struct
+{
+	size_t bytes;
+	unsigned long used;
+	int valid;
+} lruslot;
+
+//the bookkeeping of a least recently used cache of up to nslots entries,
+//whose keys and contents are kept by its user in arrays indexed by slot.
+//Initialize the first three members and leave the rest zero.
+typedef struct
+{
+	int nslots;
+	size_t budget;
+	lru_release release;
+	size_t held;
+	unsigned long clock;
+	lruslot slot[LRU_MAXSLOTS];
+} lrucache;
+
+//sets the budget for the bytes held, evicting to meet it. The entry most
+//recently looked up or added is always kept, even if it alone exceeds it
+void lru_set_budget(lrucache *c, size_t bytes);
+
+//the slot whose key matches, marked as used, or -1 if there is none
+int lru_lookup(lrucache *c, lru_match match, const void *key);
+
+//evicts as needed to fit an entry of the given size, and returns the slot
+//for it, which the caller then fills; for after a lookup that failed
+int lru_add(lrucache *c, size_t bytes);
+
+void lru_evict(lrucache *c, int slot);
+void lru_flush(lrucache *c);
+
+#endif
@@ -22,6 +22,7 @@
 *                                                                            *    
 *****************************************************************************/
 
+#include <sys/mman.h>
 #include "memory.h"
 
 void memerror(char errortxt[])
@@ -30,10 +31,34 @@ void memerror(char errortxt[])
 	exit(EXIT_FAILURE);
 }
 
+//(posix_memalign is missing from the 10.4 SDK, so blocks are aligned by
+//hand, with the pointer malloc returned kept just below the block)
+void *memblock(size_t bytes)
+{
+	char *raw, *p;
+	size_t align = bytes>=MEM_HUGEPAGE_MIN ? MEM_HUGEPAGE : MEM_ALIGN;
+
+	raw = (char *)malloc(bytes+align+sizeof(void *));
+	if (!raw) return NULL;
+	p = raw+sizeof(void *);
+	p += (align - (size_t)p%align) % align;
+	((void **)p)[-1] = raw;
+#ifdef MADV_HUGEPAGE
+	//(only a hint, so failure does not matter)
+	if (bytes>=MEM_HUGEPAGE_MIN) madvise(p,bytes-bytes%MEM_HUGEPAGE,MADV_HUGEPAGE);
+#endif
+	return p;
+}
+
+void free_memblock(void *p)
+{
+	if (p) free(((void **)p)[-1]);
+}
+
 float *vector(long nlow, long nhigh)
 {
 	float *v;
-	v=(float *)malloc( (size_t) (nhigh-nlow+1)*sizeof(float) );
+	v=(float *)memblock( (size_t) (nhigh-nlow+1)*sizeof(float) );
 	if (!v) memerror("failure in vector()");
 	return v-nlow;
 }
@@ -41,7 +66,7 @@ float *vector(long nlow, long nhigh)
 int *ivector(long nlow, long nhigh)
 {
 	int *v;
-	v=(int *)malloc( (size_t) (nhigh-nlow+1)*sizeof(int) );
+	v=(int *)memblock( (size_t) (nhigh-nlow+1)*sizeof(int) );
 	if (!v) memerror("failure in ivector()");
 	return v-nlow;
 }
@@ -49,7 +74,7 @@ int *ivector(long nlow, long nhigh)
 unsigned char *cvector(long nlow, long nhigh)
 {
 	unsigned char *v;
-	v=(unsigned char *)malloc( (size_t)(nhigh-nlow+1)*sizeof(unsigned char) );
+	v=(unsigned char *)memblock( (size_t)(nhigh-nlow+1)*sizeof(unsigned char) );
 	if (!v) memerror("failure in cvector()");
 	return v-nlow;
 }
@@ -58,7 +83,7 @@ unsigned long *lvector(long nlow, long nhigh)
 {
 	unsigned long *v;
 	
-	v=(unsigned long *)malloc( (size_t)(nhigh-nlow+1)*sizeof(long) );
+	v=(unsigned long *)memblock( (size_t)(nhigh-nlow+1)*sizeof(long) );
 	if (!v) memerror("failure in lvector()");
 	return v-nlow;
 }
@@ -66,7 +91,7 @@ unsigned long *lvector(long nlow, long nhigh)
 double *dvector(long nlow, long nhigh)
 {
 	double *v;
-	v=(double *)malloc( (size_t)(nhigh-nlow+1)*sizeof(double) );
+	v=(double *)memblock( (size_t)(nhigh-nlow+1)*sizeof(double) );
 	if (!v) memerror("failure in dvector()");
 	return v-nlow;
 }
@@ -79,7 +104,7 @@ float **matrix(long ilr, long ihr, long ilc, long ihc)
 	m=(float **) malloc( (size_t)(Nr)*sizeof(float*) );
 	if (!m) memerror("failure A in matrix()");
 	m -= ilr;
-	m[ilr]=(float *) malloc( (size_t)(Nr*Nc)*sizeof(float) );
+	m[ilr]=(float *) memblock( (size_t)(Nr*Nc)*sizeof(float) );
 	if (!m[ilr]) memerror("failure B in matrix()");
 	m[ilr] -= ilc;
 	
@@ -95,7 +120,7 @@ double **dmatrix(long ilr, long ihr, long ilc, long ihc)
 	m=(double **) malloc( (size_t)(Nr)*sizeof(double*) );
 	if (!m) memerror("failure A in dmatrix()");
 	m -= ilr;
-	m[ilr]=(double *) malloc( (size_t)(Nr*Nc)*sizeof(double) );
+	m[ilr]=(double *) memblock( (size_t)(Nr*Nc)*sizeof(double) );
 	if (!m[ilr]) memerror("failure B in dmatrix()");
 	m[ilr] -= ilc;
 	
@@ -111,7 +136,7 @@ int **imatrix(long ilr, long ihr, long ilc, long ihc)
 	m=(int **) malloc( (size_t)(Nr)*sizeof(int*) );
 	if (!m) memerror("failure A in imatrix()");
 	m -= ilr;
-	m[ilr]=(int *) malloc( (size_t)(Nr*Nc)*sizeof(int) );
+	m[ilr]=(int *) memblock( (size_t)(Nr*Nc)*sizeof(int) );
 	if (!m[ilr]) memerror("failure B in imatrix()");
 	m[ilr] -= ilc;
 	
@@ -130,7 +155,7 @@ float ***f3matrix(long ilr, long ihr, long ilc, long ihc, long ild, long ihd)
 	t[ilr]=(float **) malloc( (size_t)Nr*Nc*sizeof(float*) );
 	if (!t[ilr]) memerror("failure B in f3matrix()");
 	t[ilr] -= ilc;
-	t[ilr][ilc]=(float *) malloc( (size_t)Nr*Nc*Nd*sizeof(float) );
+	t[ilr][ilc]=(float *) memblock( (size_t)Nr*Nc*Nd*sizeof(float) );
 	if (!t[ilr][ilc]) memerror("failure C in f3matrix()");
 	t[ilr][ilc] -= ild;
 	for(j=ilc+1;j<=ihc;j++) t[ilr][j]=t[ilr][j-1]+Nd;
@@ -142,18 +167,18 @@ float ***f3matrix(long ilr, long ihr, long ilc, long ihc, long ild, long ihd)
 	return t;
 }
 
-GLubyte ***glu3matrix(long ilr, long ihr, long ilc, long ihc, long ild, long ihd)
+unsigned char ***glu3matrix(long ilr, long ihr, long ilc, long ihc, long ild, long ihd)
 {
 	long i,j,Nr=ihr-ilr+1,Nc=ihc-ilc+1,Nd=ihd-ild+1;
-	GLubyte ***t;
+	unsigned char ***t;
 
-	t=(GLubyte ***) malloc( (size_t)Nr*sizeof(GLubyte**) );
+	t=(unsigned char ***) malloc( (size_t)Nr*sizeof(unsigned char**) );
 	if (!t) memerror("failure A in glu3matrix()");
 	t -= ilr;
-	t[ilr]=(GLubyte **) malloc( (size_t)Nr*Nc*sizeof(GLubyte*) );
+	t[ilr]=(unsigned char **) malloc( (size_t)Nr*Nc*sizeof(unsigned char*) );
 	if (!t[ilr]) memerror("failure B in glu3matrix()");
 	t[ilr] -= ilc;
-	t[ilr][ilc]=(GLubyte *) malloc( (size_t)Nr*Nc*Nd*sizeof(GLubyte) );
+	t[ilr][ilc]=(unsigned char *) memblock( (size_t)Nr*Nc*Nd*sizeof(unsigned char) );
 	if (!t[ilr][ilc]) memerror("failure C in glu3matrix()");
 	t[ilr][ilc] -= ild;
 	for(j=ilc+1;j<=ihc;j++) t[ilr][j]=t[ilr][j-1]+Nd;
@@ -167,52 +192,190 @@ GLubyte ***glu3matrix(long ilr, long ihr, long ilc, long ihc, long ild, long ihd
 
 void free_vector(float *v, long nlow, long nhigh)
 {
-	free((char*) (v+nlow));
+	free_memblock(v+nlow);
 }
 void free_ivector(int *v, long nlow, long nhigh)
 {
-	free((char*) (v+nlow));
+	free_memblock(v+nlow);
 }
 void free_cvector(unsigned char *v, long nlow, long nhigh)
 {
-	free((char*) (v+nlow));
+	free_memblock(v+nlow);
 }
 void free_lvector(unsigned long *v, long nlow, long nhigh)
 {
-	free((char*) (v+nlow));
+	free_memblock(v+nlow);
 }
 void free_dvector(double *v, long nlow, long nhigh)
 {
-	free((char*) (v+nlow));
+	free_memblock(v+nlow);
 }
 void free_matrix(float **m, long ilr, long ihr, long ilc, long ihc)
 {
-	free((char*) (m[ilr]+ilc));
+	free_memblock(m[ilr]+ilc);
 	free((char*) (m+ilr));
 }
 void free_dmatrix(double **m, long ilr, long ihr, long ilc, long ihc)
 {
-	free((char*) (m[ilr]+ilc));
+	free_memblock(m[ilr]+ilc);
 	free((char*) (m+ilr));
 }
 void free_imatrix(int **m, long ilr, long ihr, long ilc, long ihc)
 {
-	free((char*) (m[ilr]+ilc));
+	free_memblock(m[ilr]+ilc);
 	free((char*) (m+ilr));
 }
 void free_f3matrix(float ***t, long ilr, long ihr, long ilc, long ihc,
 				   long ild, long ihd)
 {
-	free((char*) (t[ilr][ilc]+ild));
+	free_memblock(t[ilr][ilc]+ild);
 	free((char*) (t[ilr]+ilc));
 	free((char*) (t+ilr));
 }
-void free_glu3matrix(GLubyte ***t, long ilr, long ihr, long ilc, long ihc,
+void free_glu3matrix(unsigned char ***t, long ilr, long ihr, long ilc, long ihc,
 				   long ild, long ihd)
 {
-	free((char*) (t[ilr][ilc]+ild));
+	free_memblock(t[ilr][ilc]+ild);
 	free((char*) (t[ilr]+ilc));
 	free((char*) (t+ilr));
 }
 
 
+/**********************************************************************/
+/*                             arenas                                 */
+/**********************************************************************/
+
+//smallest chunk an arena allocates
+#define MEM_ARENA_CHUNK (1L<<20)
+
+struct memchunk
+{
+	memchunk *next;
+	char *base;
+	size_t size, used;
+};
+
+static memchunk *new_chunk(size_t size)
+{
+	memchunk *c;
+
+	c = (memchunk *)malloc(sizeof(memchunk));
+	if (!c) return NULL;
+	c->base = (char *)memblock(size);
+	if (!c->base)
+	{
+		free(c);
+		return NULL;
+	}
+	c->size = size;
+	c->used = 0;
+	c->next = NULL;
+	return c;
+}
+
+void arena_init(memarena *a)
+{
+	a->chunks = NULL;
+}
+
+//bytes from the newest chunk, or from a new one if it is full
+void *arena_alloc(memarena *a, size_t bytes)
+{
+	memchunk *c = a->chunks;
+	size_t size;
+	void *p;
+
+	bytes = (bytes+MEM_ALIGN-1) / MEM_ALIGN * MEM_ALIGN;
+	if (!c || c->used+bytes>c->size)
+	{
+		size = bytes>MEM_ARENA_CHUNK ? bytes : MEM_ARENA_CHUNK;
+		c = new_chunk(size);
+		if (!c) return NULL;
+		c->next = a->chunks;
+		a->chunks = c;
+	}
+	p = c->base+c->used;
+	c->used += bytes;
+	return p;
+}
+
+//frees everything allocated; the memory is kept, in one chunk big enough
+//for all of it, so allocating the same again needs no malloc
+void arena_reset(memarena *a)
+{
+	memchunk *c;
+	size_t total = 0;
+
+	if (a->chunks && a->chunks->next)
+	{
+		for (c=a->chunks; c; c=c->next) total += c->size;
+		arena_release(a);
+		a->chunks = new_chunk(total);
+	}
+	else if (a->chunks)
+	{
+		a->chunks->used = 0;
+	}
+}
+
+//frees everything allocated, and the memory
+void arena_release(memarena *a)
+{
+	memchunk *c, *next;
+
+	for (c=a->chunks; c; c=next)
+	{
+		next = c->next;
+		free_memblock(c->base);
+		free(c);
+	}
+	a->chunks = NULL;
+}
+
+float **arena_matrix(memarena *a, long nr, long nc)
+{
+	float **m;
+	long i;
+
+	m = (float **)arena_alloc(a,(size_t)nr*sizeof(float*));
+	if (!m) return NULL;
+	m[0] = (float *)arena_alloc(a,(size_t)nr*nc*sizeof(float));
+	if (!m[0]) return NULL;
+	for (i=1; i<nr; i++) m[i] = m[i-1]+nc;
+	return m;
+}
+
+int **arena_imatrix(memarena *a, long nr, long nc)
+{
+	int **m;
+	long i;
+
+	m = (int **)arena_alloc(a,(size_t)nr*sizeof(int*));
+	if (!m) return NULL;
+	m[0] = (int *)arena_alloc(a,(size_t)nr*nc*sizeof(int));
+	if (!m[0]) return NULL;
+	for (i=1; i<nr; i++) m[i] = m[i-1]+nc;
+	return m;
+}
+
+unsigned char ***arena_glu3matrix(memarena *a, long nr, long nc, long nd)
+{
+	unsigned char ***t;
+	long i, j;
+
+	t = (unsigned char ***)arena_alloc(a,(size_t)nr*sizeof(unsigned char**));
+	if (!t) return NULL;
+	t[0] = (unsigned char **)arena_alloc(a,(size_t)nr*nc*sizeof(unsigned char*));
+	if (!t[0]) return NULL;
+	t[0][0] = (unsigned char *)arena_alloc(a,(size_t)nr*nc*nd);
+	if (!t[0][0]) return NULL;
+	for (i=0; i<nr; i++)
+	{
+		if (i>0) t[i] = t[i-1]+nc;
+		for (j=0; j<nc; j++)
+		{
+			t[i][j] = t[0][0]+(i*nc+j)*nd;
+		}
+	}
+	return t;
+}
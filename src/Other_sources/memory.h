@@ -20,10 +20,21 @@
 *                                                                            *
 *****************************************************************************/
 
-#import "CMBview.h"
+#import <stdio.h>
+#import <stdlib.h>
 
 void memerror(char errortxt[]);
 
+//aligned blocks: every array below keeps its elements in one of these.
+//Blocks of MEM_HUGEPAGE_MIN bytes or more are aligned to MEM_HUGEPAGE and
+//advised for huge pages where the system has them. Returns NULL on
+//failure; release with free_memblock()
+#define MEM_ALIGN 64
+#define MEM_HUGEPAGE (2L<<20)
+#define MEM_HUGEPAGE_MIN (8L<<20)
+void *memblock(size_t bytes);
+void free_memblock(void *p);
+
 //1d arrays
 float *vector(long nlow, long nhigh);
 int *ivector(long nlow, long nhigh);
@@ -44,12 +55,27 @@ void free_matrix(float **m, long ilr, long ihr, long ilc, long ihc);
 void free_dmatrix(double **m, long ilr, long ihr, long ilc, long ihc);
 void free_imatrix(int **m, long ilr, long ihr, long ilc, long ihc);
 
-//3d arrays
+//3d arrays (glu3matrix holds GLubyte texels, kept as unsigned char so
+//this file does not need the OpenGL headers)
 float ***f3matrix(long ilr, long ihr, long ilc, long ihc, long ild, long ihd);
-GLubyte ***glu3matrix(long ilr, long ihr, long ilc, long ihc, long ild, long ihd);
+unsigned char ***glu3matrix(long ilr, long ihr, long ilc, long ihc, long ild, long ihd);
 void free_f3matrix(float ***t, long ilr, long ihr, long ilc, long ihc, long ild, long ihd);
-void free_glu3matrix(GLubyte ***t, long ilr, long ihr, long ilc, long ihc, long ild, long ihd);
-
-
+void free_glu3matrix(unsigned char ***t, long ilr, long ihr, long ilc, long ihc, long ild, long ihd);
 
+//arenas: allocations carved from large reusable chunks, released all at
+//once by arena_reset(), which keeps the memory for next time (merged into
+//a single chunk). Arrays are 0-based with unpadded rows, so their elements
+//are contiguous like those above; they return NULL on failure
+typedef struct memchunk memchunk;
+typedef struct
+{
+	memchunk *chunks;
+} memarena;
 
+void arena_init(memarena *a);
+void *arena_alloc(memarena *a, size_t bytes);
+void arena_reset(memarena *a);
+void arena_release(memarena *a);
+float **arena_matrix(memarena *a, long nr, long nc);
+int **arena_imatrix(memarena *a, long nr, long nc);
+unsigned char ***arena_glu3matrix(memarena *a, long nr, long nc, long nd);
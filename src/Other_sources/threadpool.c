@@ -0,0 +1,254 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+* A small work-stealing thread pool. Each worker is dealt a contiguous range *
+* of task indices, which it consumes from the front. A worker whose range    *
+* is exhausted steals the back half of another worker's remaining range.    *
+*                                                                            *
+*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include "threadpool.h"
+
+//how often (in ms) the calling thread wakes up to report progress
+#define MONITOR_INTERVAL 50
+
+//per-worker queue of task indices [head,tail), padded onto its own cache line
+typedef struct
+{
+	pthread_mutex_t lock;
+	long head, tail;
+	volatile long ndone;
+	char pad[64];
+} taskqueue;
+
+static struct
+{
+	int nworkers;
+	taskqueue queues[THREADPOOL_MAXWORKERS];
+
+	pthread_mutex_t lock;
+	pthread_cond_t start, finished;
+	unsigned long generation;
+	int nbusy;
+
+	threadpool_fn fn;
+	void *arg;
+} pool;
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t run_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/**********************************************************************/
+/*                         worker threads                             */
+/**********************************************************************/
+
+static int take_task(int w, long *task)
+{
+	taskqueue *q = &pool.queues[w], *victim;
+	long head, tail, mid;
+	int i;
+
+	//work through our own range first
+	pthread_mutex_lock(&q->lock);
+	if (q->head < q->tail)
+	{
+		*task = q->head++;
+		pthread_mutex_unlock(&q->lock);
+		return 1;
+	}
+	pthread_mutex_unlock(&q->lock);
+
+	//otherwise steal the back half of somebody else's
+	for (i=1; i<pool.nworkers; i++)
+	{
+		victim = &pool.queues[(w+i) % pool.nworkers];
+		pthread_mutex_lock(&victim->lock);
+		head = victim->head;
+		tail = victim->tail;
+		if (head >= tail)
+		{
+			pthread_mutex_unlock(&victim->lock);
+			continue;
+		}
+		mid = head + (tail-head)/2;
+		victim->tail = mid;
+		pthread_mutex_unlock(&victim->lock);
+
+		//run task mid now and keep the rest of the stolen range for ourselves
+		pthread_mutex_lock(&q->lock);
+		q->head = mid+1;
+		q->tail = tail;
+		pthread_mutex_unlock(&q->lock);
+		*task = mid;
+		return 1;
+	}
+
+	return 0;
+}
+
+static void *worker_main(void *p)
+{
+	int w = (int)(long)p;
+	unsigned long seen = 0;
+	threadpool_fn fn;
+	void *arg;
+	long task;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&pool.lock);
+		while (pool.generation == seen)
+			pthread_cond_wait(&pool.start,&pool.lock);
+		seen = pool.generation;
+		fn = pool.fn;
+		arg = pool.arg;
+		pthread_mutex_unlock(&pool.lock);
+
+		while (take_task(w,&task))
+		{
+			fn(arg,task,w);
+			pool.queues[w].ndone++;
+		}
+
+		pthread_mutex_lock(&pool.lock);
+		if (--pool.nbusy == 0) pthread_cond_signal(&pool.finished);
+		pthread_mutex_unlock(&pool.lock);
+	}
+
+	return NULL;
+}
+
+static void pool_init(void)
+{
+	pthread_t thread;
+	long n;
+	int w;
+
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n < 1) n = 1;
+	if (n > THREADPOOL_MAXWORKERS) n = THREADPOOL_MAXWORKERS;
+	pool.nworkers = (int)n;
+
+	pthread_mutex_init(&pool.lock,NULL);
+	pthread_cond_init(&pool.start,NULL);
+	pthread_cond_init(&pool.finished,NULL);
+	pool.generation = 0;
+	pool.nbusy = 0;
+
+	for (w=0; w<pool.nworkers; w++)
+	{
+		pthread_mutex_init(&pool.queues[w].lock,NULL);
+		pool.queues[w].head = pool.queues[w].tail = 0;
+		pool.queues[w].ndone = 0;
+	}
+
+	for (w=0; w<pool.nworkers; w++)
+	{
+		if (pthread_create(&thread,NULL,worker_main,(void *)(long)w) != 0)
+		{
+			fprintf(stderr,"ERROR: failed to start worker thread %d\n",w);
+			exit(EXIT_FAILURE);
+		}
+		pthread_detach(thread);
+	}
+}
+
+
+/**********************************************************************/
+/*                            interface                               */
+/**********************************************************************/
+
+int threadpool_nworkers(void)
+{
+	pthread_once(&pool_once,pool_init);
+	return pool.nworkers;
+}
+
+/*
+   run fn over task indices [0,ntasks) on the pool and wait for them all to finish.
+   Must not be called from inside a task function.
+*/
+void threadpool_run(threadpool_fn fn, void *arg, long ntasks,
+					threadpool_monitor monitor, void *monitor_arg)
+{
+	struct timeval now;
+	struct timespec timeout;
+	long done;
+	int w, rc;
+
+	if (ntasks <= 0) return;
+	pthread_once(&pool_once,pool_init);
+	pthread_mutex_lock(&run_lock);
+
+	//deal out the tasks in contiguous ranges, so neighbouring tiles stay together
+	for (w=0; w<pool.nworkers; w++)
+	{
+		pthread_mutex_lock(&pool.queues[w].lock);
+		pool.queues[w].head = (ntasks*w) / pool.nworkers;
+		pool.queues[w].tail = (ntasks*(w+1)) / pool.nworkers;
+		pool.queues[w].ndone = 0;
+		pthread_mutex_unlock(&pool.queues[w].lock);
+	}
+
+	pthread_mutex_lock(&pool.lock);
+	pool.fn = fn;
+	pool.arg = arg;
+	pool.nbusy = pool.nworkers;
+	pool.generation++;
+	pthread_cond_broadcast(&pool.start);
+
+	while (pool.nbusy > 0)
+	{
+		if (!monitor)
+		{
+			pthread_cond_wait(&pool.finished,&pool.lock);
+			continue;
+		}
+
+		gettimeofday(&now,NULL);
+		timeout.tv_sec = now.tv_sec;
+		timeout.tv_nsec = (now.tv_usec + 1000*MONITOR_INTERVAL) * 1000;
+		if (timeout.tv_nsec >= 1000000000)
+		{
+			timeout.tv_sec++;
+			timeout.tv_nsec -= 1000000000;
+		}
+
+		rc = pthread_cond_timedwait(&pool.finished,&pool.lock,&timeout);
+		if (rc == ETIMEDOUT && pool.nbusy > 0)
+		{
+			pthread_mutex_unlock(&pool.lock);
+			for (done=0, w=0; w<pool.nworkers; w++) done += pool.queues[w].ndone;
+			monitor(monitor_arg,done,ntasks);
+			pthread_mutex_lock(&pool.lock);
+		}
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	if (monitor) monitor(monitor_arg,ntasks,ntasks);
+	pthread_mutex_unlock(&run_lock);
+}
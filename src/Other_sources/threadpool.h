@@ -0,0 +1,41 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+*****************************************************************************/
+
+#ifndef CMBVIEW_THREADPOOL_H
+#define CMBVIEW_THREADPOOL_H
+
+//hard limit on the number of worker threads
+#define THREADPOOL_MAXWORKERS 64
+
+//a task function is called once for each task index in [0,ntasks), on one of
+//the worker threads. worker is the index of that thread, in [0,nworkers)
+typedef void (*threadpool_fn)(void *arg, long task, int worker);
+
+//called periodically on the calling thread while a job runs, with the number
+//of tasks completed so far
+typedef void (*threadpool_monitor)(void *arg, long done, long ntasks);
+
+int threadpool_nworkers(void);
+void threadpool_run(threadpool_fn fn, void *arg, long ntasks,
+					threadpool_monitor monitor, void *monitor_arg);
+
+#endif
@@ -0,0 +1,545 @@
+/*****************************************************************************
+* Copyright 2026 CMBview contributors                                        *
+*                                                                            *
+* This file is part of CMBview, a program for viewing HEALPix-format         *
+* CMB data on an OpenGL-rendered 3d sphere.                                  *
+*                                                                            *
+* CMBview is free software; you can redistribute it and/or modify            *
+* it under the terms of the GNU General Public License as published by       *
+* the Free Software Foundation; either version 2 of the License, or          *
+* (at your option) any later version.                                        *
+*                                                                            *
+* CMBview is distributed in the hope that it will be useful,                 *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+* GNU General Public License for more details.                               *
+*                                                                            *
+* You should have received a copy of the GNU General Public License          *
+* along with CMBview; if not, write to the Free Software                     *
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+*                                                                            *
+*                                                                            *
+* cmbview-render: headless version of the render mode export. Ray traces a   *
+* HEALPix FITS map through the same observer as the application and writes  *
+* the image as PNG or PPM, with no OpenGL or AppKit needed.                  *
+*                                                                            *
+*****************************************************************************/
+
+#import <string.h>
+#import <stdint.h>
+#import "CMBproject.h"
+#import "CMBcolormap.h"
+#import "CMBfitsmap.h"
+#import "CMBrender.h"
+#import "CMBpyramid.h"
+#import "memory.h"
+
+//observer constants, as set in OpenGLview
+#define AXISSPACE 2.0e-3
+#define MINAPPROACH 0.01
+
+typedef struct
+{
+	char *infile, *outfile;
+	float theta, phi, zoom, fovy;
+	int ortho, width, height, aa;
+	int maptype, colormap_flag, colormap, reverse;
+	int userange;
+	float min, max;
+} options;
+
+static const char *colormap_names[] = {"hsv","jet","hot","cool","copper","neg","bone","winter"};
+
+
+/**********************************************************************/
+/*                         command line                               */
+/**********************************************************************/
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: cmbview-render [options] map.fits image.png|image.ppm\n"
+		"  -theta deg      view colatitude (45)\n"
+		"  -phi deg        view longitude (135)\n"
+		"  -zoom z         zoom as on the slider, 0 to 5 (2)\n"
+		"  -fovy deg       perspective field of view (45)\n"
+		"  -ortho          orthographic projection (default)\n"
+		"  -perspective    perspective projection\n"
+		"  -size WxH       image size in pixels (1024x1024)\n"
+		"  -aa n           adaptive antialiasing, 0 (off) to 3 levels (0)\n"
+		"  -map T|Q|U|P    map to render (T)\n"
+		"  -colormap name  hsv, jet, hot, cool, copper, neg, bone or winter (hsv)\n"
+		"  -grey           greyscale instead of a colormap\n"
+		"  -reverse        reverse the colormap\n"
+		"  -range min max  color range (default: range of the visible pixels)\n");
+	exit(EXIT_FAILURE);
+}
+
+static float float_arg(int argc, char **argv, int i)
+{
+	char *end;
+	float f;
+	if (i>=argc) usage();
+	f = (float)strtod(argv[i],&end);
+	if (end==argv[i] || *end)
+	{
+		fprintf(stderr,"ERROR: %s needs a number, not \"%s\"\n",argv[i-1],argv[i]);
+		exit(EXIT_FAILURE);
+	}
+	return f;
+}
+
+static void parse_options(int argc, char **argv, options *opt)
+{
+	int i, c, nfiles = 0;
+	char *arg;
+
+	opt->theta = 45.0;
+	opt->phi = 135.0;
+	opt->zoom = 2.0;
+	opt->fovy = 45.0;
+	opt->ortho = 1;
+	opt->width = 1024;
+	opt->height = 1024;
+	opt->aa = 0;
+	opt->maptype = 1;
+	opt->colormap_flag = 1;
+	opt->colormap = hsv;
+	opt->reverse = 0;
+	opt->userange = 0;
+
+	for (i=1; i<argc; i++)
+	{
+		arg = argv[i];
+		if (arg[0]!='-')
+		{
+			if (nfiles==0) opt->infile = arg;
+			else if (nfiles==1) opt->outfile = arg;
+			else usage();
+			nfiles++;
+		}
+		else if (!strcmp(arg,"-theta")) opt->theta = float_arg(argc,argv,++i);
+		else if (!strcmp(arg,"-phi")) opt->phi = float_arg(argc,argv,++i);
+		else if (!strcmp(arg,"-zoom")) opt->zoom = float_arg(argc,argv,++i);
+		else if (!strcmp(arg,"-fovy")) opt->fovy = float_arg(argc,argv,++i);
+		else if (!strcmp(arg,"-ortho")) opt->ortho = 1;
+		else if (!strcmp(arg,"-perspective")) opt->ortho = 0;
+		else if (!strcmp(arg,"-grey")) opt->colormap_flag = 0;
+		else if (!strcmp(arg,"-reverse")) opt->reverse = 1;
+		else if (!strcmp(arg,"-size"))
+		{
+			if (++i>=argc) usage();
+			if (sscanf(argv[i],"%dx%d",&opt->width,&opt->height)!=2 ||
+				opt->width<1 || opt->height<1)
+			{
+				fprintf(stderr,"ERROR: bad image size \"%s\"\n",argv[i]);
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (!strcmp(arg,"-map"))
+		{
+			if (++i>=argc) usage();
+			opt->maptype = 0;
+			if (!strcmp(argv[i],"T")) opt->maptype = 1;
+			if (!strcmp(argv[i],"Q")) opt->maptype = 2;
+			if (!strcmp(argv[i],"U")) opt->maptype = 3;
+			if (!strcmp(argv[i],"P")) opt->maptype = 4;
+			if (!opt->maptype)
+			{
+				fprintf(stderr,"ERROR: unknown map \"%s\"\n",argv[i]);
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (!strcmp(arg,"-colormap"))
+		{
+			if (++i>=argc) usage();
+			opt->colormap = -1;
+			for (c=hsv; c<=winter; c++)
+			{
+				if (!strcmp(argv[i],colormap_names[c])) opt->colormap = c;
+			}
+			if (opt->colormap<0)
+			{
+				fprintf(stderr,"ERROR: unknown colormap \"%s\"\n",argv[i]);
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (!strcmp(arg,"-aa"))
+		{
+			opt->aa = (int)float_arg(argc,argv,++i);
+			if (opt->aa<0 || opt->aa>RENDER_AA_MAXLEVEL)
+			{
+				fprintf(stderr,"ERROR: -aa must lie between 0 and %d\n",RENDER_AA_MAXLEVEL);
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (!strcmp(arg,"-range"))
+		{
+			opt->min = float_arg(argc,argv,++i);
+			opt->max = float_arg(argc,argv,++i);
+			opt->userange = 1;
+		}
+		else usage();
+	}
+	if (nfiles!=2) usage();
+	if (opt->zoom<0.0 || opt->zoom>5.0)
+	{
+		fprintf(stderr,"ERROR: zoom must lie between 0 and 5\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+
+/**********************************************************************/
+/*                           map reading                              */
+/**********************************************************************/
+
+//read the maps as the application does; the returned array holds T, Q, U.
+//For a cut sky file the maps only carry the nside and ordering, and the
+//pixels are read into cut (whose nside stays 0 for a full sky file)
+static hpic_fltarr *read_maps(char *filename, int maptype, sparsemap *cut)
+{
+	char creator[200], extname[200];
+	int order, coord, type;
+	size_t nside, nmaps, nread, i;
+	hpic_fltarr *maps;
+	hpic_keys *keys;
+
+	if (!hpic_fits_map_test(filename,&nside,&order,&coord,&type,&nmaps))
+	{
+		fprintf(stderr,"ERROR: %s does not seem to be a valid HEALPix FITS file\n",filename);
+		exit(EXIT_FAILURE);
+	}
+	if (nmaps<1 || nmaps>4)
+	{
+		fprintf(stderr,"ERROR: %s contains %d maps, only 1 to 4 are supported\n",
+				filename,(int)nmaps);
+		exit(EXIT_FAILURE);
+	}
+	if (maptype>1 && nmaps<3)
+	{
+		fprintf(stderr,"ERROR: %s has no polarization maps\n",filename);
+		exit(EXIT_FAILURE);
+	}
+
+	//(the N map of a 2-map file is read but never used)
+	nread = nmaps;
+	maps = hpic_fltarr_alloc(nread);
+	for (i=0; i<nread; i++)
+	{
+		hpic_fltarr_set(maps,i,hpic_float_alloc(nside,order,coord,
+											   type == HPIC_FITS_FULL ? HPIC_STND : HPIC_TREE));
+	}
+	memset(cut,0,sizeof(sparsemap));
+
+	keys = hpic_keys_alloc();
+	if (type == HPIC_FITS_FULL)
+	{
+		if (!fitsmap_read(filename,maps))
+		{
+			hpic_fits_full_read(filename,creator,extname,maps,keys);
+		}
+	}
+	else
+	{
+		if (!sparse_read(cut,filename,nside,order,nread<3 ? (int)nread : 3))
+		{
+			fprintf(stderr,"ERROR: failed to read the cut sky map %s\n",filename);
+			exit(EXIT_FAILURE);
+		}
+	}
+	hpic_keys_free(keys);
+	return maps;
+}
+
+
+/**********************************************************************/
+/*                            rendering                               */
+/**********************************************************************/
+
+//set src to map degraded to nside through p, or to map itself if it is no
+//finer; map is column col of cut for a cut sky file. Returns src, or NULL
+//if there is no map
+static const mapsource *degraded(mappyramid *p, hpic_float *map, const sparsemap *cut,
+								 int col, int nside, mapsource *src)
+{
+	pyramid_build(p,NULL,NULL,NULL);
+	if (!map) return NULL;
+	if (nside >= (int)map->nside)
+	{
+		if (cut) sparse_source(cut,col,src);
+		else map_source(map,src);
+		return src;
+	}
+	if (cut) pyramid_build_sparse(p,map,cut,col,NULL,NULL);
+	else pyramid_build(p,map,NULL,NULL);
+	pyramid_source(p,nside,src);
+	return src;
+}
+
+//trace the view, in the layout of the application's render textures:
+//data[x][y] with y counted up from the bottom of the view. As in the
+//application, the maps are degraded to match the spacing of the rays
+static long trace(const options *opt, hpic_fltarr *maps, const sparsemap *cut,
+				  float **data, int **mask, valuestats *stats)
+{
+	Observer obs;
+	mappyramid pyr[3];
+	mapsource src[3];
+	hpic_float *T, *Q, *U;
+	long hits;
+	int nside;
+
+	memset(&obs,0,sizeof(obs));
+	obs.view_width = opt->width;
+	obs.view_height = opt->height;
+	obs.aspect_ratio = obs.view_width/obs.view_height;
+	obs.axisspace = AXISSPACE;
+	obs.near = MINAPPROACH-obs.axisspace;
+	observer_setup(&obs,opt->theta,opt->phi,opt->zoom/5.0,opt->fovy,opt->ortho,MINAPPROACH,NULL);
+	observer_frustum(&obs,opt->fovy,opt->ortho);
+
+	//only the maps the trace reads are degraded
+	T = hpic_fltarr_get(maps,0);
+	nside = pyramid_nside(render_spacing(&obs,opt->ortho,opt->width,opt->height),(int)T->nside);
+	Q = hpic_fltarr_n_get(maps)>2 && (opt->maptype==2 || opt->maptype==4) ? hpic_fltarr_get(maps,1) : NULL;
+	U = hpic_fltarr_n_get(maps)>2 && (opt->maptype==3 || opt->maptype==4) ? hpic_fltarr_get(maps,2) : NULL;
+	if (!cut->nside) cut = NULL;
+
+	hits = render_trace(&obs,opt->ortho,opt->width,opt->height,opt->aa,opt->maptype,
+						degraded(&pyr[0],opt->maptype==1 ? T : NULL,cut,0,nside,&src[0]),
+						degraded(&pyr[1],Q,cut,1,nside,&src[1]),
+						degraded(&pyr[2],U,cut,2,nside,&src[2]),
+						data,mask,stats,NULL,NULL,NULL);
+
+	pyramid_free(&pyr[0]);
+	pyramid_free(&pyr[1]);
+	pyramid_free(&pyr[2]);
+	return hits;
+}
+
+//color the traced values exactly as the render mode export does. Image rows
+//run from the top of the view down, so it comes out the way it looks on screen
+static void colorize(const options *opt, float **data, int **mask, unsigned char *rgb)
+{
+	colorlut lut;
+	unsigned char *cols, *p, *q;
+	long n = (long)opt->width*opt->height;
+	int r, c, y;
+
+	//color the traced data as it lies, column by column, then flip it into
+	//top-down image rows
+	cols = cvector(0,3*n-1);
+	colorlut_build(&lut,&mycolormaps[opt->colormap],opt->colormap_flag,opt->reverse);
+	colorlut_apply(&lut,data[0],mask[0],(size_t)n,opt->min,opt->max,cols);
+
+	p = rgb;
+	for (r=0; r<opt->height; r++)
+	{
+		y = opt->height-1-r;
+		q = cols + 3*(long)y;
+		for (c=0; c<opt->width; c++, p+=3, q+=3*(long)opt->height)
+		{
+			p[0] = q[0]; p[1] = q[1]; p[2] = q[2];
+		}
+	}
+	free_cvector(cols,0,3*n-1);
+}
+
+
+/**********************************************************************/
+/*                          image output                              */
+/**********************************************************************/
+
+static void write_ppm(FILE *fp, int width, int height, const unsigned char *rgb)
+{
+	fprintf(fp,"P6\n%d %d\n255\n",width,height);
+	fwrite(rgb,3,(size_t)width*height,fp);
+}
+
+static uint32_t crc_table[256];
+
+static uint32_t png_crc(uint32_t crc, const unsigned char *buf, size_t len)
+{
+	uint32_t c;
+	size_t n;
+	int k;
+
+	if (!crc_table[1])
+	{
+		for (n=0; n<256; n++)
+		{
+			c = (uint32_t)n;
+			for (k=0; k<8; k++) c = (c&1) ? 0xedb88320u^(c>>1) : c>>1;
+			crc_table[n] = c;
+		}
+	}
+	for (n=0; n<len; n++) crc = crc_table[(crc^buf[n])&0xff]^(crc>>8);
+	return crc;
+}
+
+static void put32(unsigned char *p, uint32_t v)
+{
+	p[0] = (unsigned char)(v>>24); p[1] = (unsigned char)(v>>16);
+	p[2] = (unsigned char)(v>>8);  p[3] = (unsigned char)v;
+}
+
+static void png_chunk(FILE *fp, const char *type, const unsigned char *data, size_t len)
+{
+	unsigned char b[4];
+	uint32_t crc;
+
+	put32(b,(uint32_t)len);
+	fwrite(b,1,4,fp);
+	fwrite(type,1,4,fp);
+	if (len) fwrite(data,1,len,fp);
+	crc = png_crc(0xffffffffu,(const unsigned char *)type,4);
+	crc = png_crc(crc,data,len)^0xffffffffu;
+	put32(b,crc);
+	fwrite(b,1,4,fp);
+}
+
+/*
+   PNG with the image data in stored (uncompressed) deflate blocks, so no
+   zlib is needed. The files are bigger than they could be, but any PNG
+   reader will take them.
+*/
+static void write_png(FILE *fp, int width, int height, const unsigned char *rgb)
+{
+	static const unsigned char signature[8] = {137,'P','N','G','\r','\n',26,'\n'};
+	unsigned char ihdr[13], *raw, *z, *p;
+	size_t rowbytes, rawlen, zlen, left, block, r;
+	uint32_t s1 = 1, s2 = 0;
+
+	//filter type 0 in front of every row
+	rowbytes = 3*(size_t)width;
+	rawlen = (rowbytes+1)*height;
+	raw = (unsigned char *)malloc(rawlen);
+	zlen = 2 + rawlen + 5*(rawlen/65535+1) + 4;
+	z = (unsigned char *)malloc(zlen);
+	if (!raw || !z)
+	{
+		fprintf(stderr,"ERROR: failed to allocate PNG buffers\n");
+		exit(EXIT_FAILURE);
+	}
+	for (r=0; r<(size_t)height; r++)
+	{
+		raw[r*(rowbytes+1)] = 0;
+		memcpy(raw + r*(rowbytes+1) + 1, rgb + r*rowbytes, rowbytes);
+	}
+
+	p = z;
+	*p++ = 0x78; *p++ = 0x01;
+	for (left=rawlen, r=0; left>0; left-=block, r+=block)
+	{
+		block = left<65535 ? left : 65535;
+		*p++ = (left==block);
+		*p++ = (unsigned char)block; *p++ = (unsigned char)(block>>8);
+		*p++ = (unsigned char)~block; *p++ = (unsigned char)(~block>>8);
+		memcpy(p,raw+r,block);
+		p += block;
+	}
+	for (r=0; r<rawlen; r++)
+	{
+		s1 = (s1+raw[r]) % 65521;
+		s2 = (s2+s1) % 65521;
+	}
+	put32(p,(s2<<16)|s1);
+	p += 4;
+
+	put32(ihdr,(uint32_t)width);
+	put32(ihdr+4,(uint32_t)height);
+	ihdr[8] = 8;    //bit depth
+	ihdr[9] = 2;    //truecolor
+	ihdr[10] = ihdr[11] = ihdr[12] = 0;
+
+	fwrite(signature,1,8,fp);
+	png_chunk(fp,"IHDR",ihdr,13);
+	png_chunk(fp,"IDAT",z,(size_t)(p-z));
+	png_chunk(fp,"IEND",NULL,0);
+
+	free(raw);
+	free(z);
+}
+
+static void write_image(const char *filename, int width, int height, const unsigned char *rgb)
+{
+	const char *ext = strrchr(filename,'.');
+	FILE *fp;
+
+	fp = fopen(filename,"wb");
+	if (!fp)
+	{
+		fprintf(stderr,"ERROR: could not open %s for writing\n",filename);
+		exit(EXIT_FAILURE);
+	}
+	if (ext && (!strcmp(ext,".ppm") || !strcmp(ext,".PPM")))
+	{
+		write_ppm(fp,width,height,rgb);
+	}
+	else
+	{
+		write_png(fp,width,height,rgb);
+	}
+	if (fclose(fp)!=0)
+	{
+		fprintf(stderr,"ERROR: failed to write %s\n",filename);
+		exit(EXIT_FAILURE);
+	}
+}
+
+
+int main(int argc, char **argv)
+{
+	options opt;
+	hpic_fltarr *maps;
+	sparsemap cut;
+	float **data;
+	int **mask;
+	valuestats stats;
+	unsigned char *rgb;
+	long hits;
+	size_t i;
+
+	memset(&opt,0,sizeof(opt));
+	parse_options(argc,argv,&opt);
+
+	maps = read_maps(opt.infile,opt.maptype,&cut);
+	define_colormaps();
+
+	data = matrix(0,opt.width-1,0,opt.height-1);
+	mask = imatrix(0,opt.width-1,0,opt.height-1);
+	rgb = cvector(0,3*(long)opt.width*opt.height-1);
+
+	hits = trace(&opt,maps,&cut,data,mask,&stats);
+	if (hits<0)
+	{
+		fprintf(stderr,"ERROR: not enough memory to trace the view\n");
+		exit(EXIT_FAILURE);
+	}
+	if (!hits)
+	{
+		fprintf(stderr,"warning: the sphere is not in view\n");
+	}
+
+	//like render mode, the default color range spans the visible pixels
+	if (!opt.userange)
+	{
+		opt.min = stats.min;
+		opt.max = stats.max;
+	}
+
+	colorize(&opt,data,mask,rgb);
+	write_image(opt.outfile,opt.width,opt.height,rgb);
+
+	free_matrix(data,0,opt.width-1,0,opt.height-1);
+	free_imatrix(mask,0,opt.width-1,0,opt.height-1);
+	free_cvector(rgb,0,3*(long)opt.width*opt.height-1);
+	for (i=0; i<hpic_fltarr_n_get(maps); i++)
+	{
+		hpic_float_free(hpic_fltarr_get(maps,i));
+	}
+	hpic_fltarr_free(maps);
+	sparse_free(&cut);
+	return EXIT_SUCCESS;
+}